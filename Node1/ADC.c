@@ -1,22 +1,165 @@
 /** @file ADC.c
  *  @brief C-file for the Analog to Digital Converter. Switches the channels by writing wanted channels to ADC external memory and returning the channels output.
+ *  Channels 4-7 are scanned round-robin in the background from the TIMER0 compare interrupt, filtered, and published in a double-buffered snapshot.
  *  @authors: Anastasia Lindbäck and Marie Skatvedt
  */
 
 #include "ADC.h"
 
-/** Function for returning output of selected channel of the ADC.
- *  @param channel - Hexadecimal representation of binary number corresponding to channels on ADC.
- *  @return address[0] - Voltage output of selected ADC-channel
+// Double-buffered samples. The ISR fills the back buffer, and flips it to the front when a scan is complete.
+static volatile uint8_t ADC_buffer[2][ADC_NUM_CHANNELS];
+static volatile uint8_t ADC_front = 0;
+
+// Channel index (0 - ADC_NUM_CHANNELS-1) currently being converted
+static volatile uint8_t ADC_scan_index = 0;
+
+// Number of completed scans, incremented each time the buffers are flipped
+static volatile uint16_t ADC_scans = 0;
+
+// Input filter of each channel, fed with every sample from the ISR
+static filter ADC_filters[ADC_NUM_CHANNELS];
+
+// Longest time spent from compare match to the end of the ISR, in TIMER0 ticks
+static volatile uint8_t ADC_isr_max_ticks = 0;
+
+/** Function for starting the background scan of channels 4-7, using TIMER0 in CTC mode.
+ *  External memory must be enabled before calling this function.
+ */
+void ADC_init(void){
+    ADC_scan_index = 0;
+    ADC_front = 0;
+
+    for (uint8_t i = 0; i < ADC_NUM_CHANNELS; i++){
+        filter_init(&ADC_filters[i], ADC_DEFAULT_FILTER);
+    }
+
+    // Start conversion of the first channel, the result is read at the first compare match
+    *adc_addr = ADC_FIRST_CHANNEL;
+
+    // CTC mode, prescaler 64
+    set_bit(TCCR0, WGM01);
+    set_bit(TCCR0, CS01);
+    set_bit(TCCR0, CS00);
+
+    OCR0 = ADC_CHANNEL_PERIOD_TICKS - 1;
+
+    // Enable compare match interrupt
+    set_bit(TIMSK, OCIE0);
+}
+
+/** Function for stopping the background scan, so that the ADC can be read directly. The last snapshot stays valid.
+ */
+void ADC_scan_stop(void){
+    clear_bit(TIMSK, OCIE0);
+}
+
+/** Function for starting the background scan again after ADC_scan_stop. The channel of the interrupted step is converted again, so no sample of another channel is taken for it.
+ */
+void ADC_scan_start(void){
+    *adc_addr = ADC_FIRST_CHANNEL + ADC_scan_index;
+
+    // A full conversion time before the next compare match. Writing a one clears only this flag
+    TCNT0 = 0;
+    TIFR = (1 << OCF0);
+    set_bit(TIMSK, OCIE0);
+}
+
+/** Function for changing the input filter of one of the scanned channels. The filter state is cleared.
+ *  @param int channel - ADC channel (4-7).
+ *  @param filter_settings settings - New settings of the channel's filter.
+ */
+void ADC_set_filter(int channel, filter_settings settings){
+    // Keep the ISR from using the filter while it is changed
+    clear_bit(TIMSK, OCIE0);
+    filter_init(&ADC_filters[channel - ADC_FIRST_CHANNEL], settings);
+    set_bit(TIMSK, OCIE0);
+}
+
+/** Function for reading the scan counter, which is two bytes and updated by the ISR.
+ *  @return uint16_t - Number of completed scans.
+ */
+static uint16_t ADC_scan_count(void){
+    uint8_t sreg = SREG;
+    cli();
+    uint16_t scans = ADC_scans;
+    SREG = sreg;
+
+    return scans;
+}
+
+/** Function for returning the most recently completed scan of channels 4-7.
+ *  The samples in the snapshot are all from the same scan.
+ *  @return ADC_snapshot snapshot - Samples of all channels, index with (channel - ADC_FIRST_CHANNEL).
+ */
+ADC_snapshot ADC_read_snapshot(void){
+    ADC_snapshot snapshot;
+
+    // Copy again if the buffers were flipped during copying
+    do {
+        snapshot.scan = ADC_scan_count();
+        uint8_t front = ADC_front;
+
+        for (uint8_t i = 0; i < ADC_NUM_CHANNELS; i++){
+            snapshot.channel[i] = ADC_buffer[front][i];
+        }
+    } while (snapshot.scan != ADC_scan_count());
+
+    return snapshot;
+}
+
+/** Function for waiting until the next scan is completed, so that the snapshot contains fresh samples.
+ */
+void ADC_wait_for_scan(void){
+    uint16_t scan = ADC_scan_count();
+
+    while (scan == ADC_scan_count()){};
+}
+
+/** Test function for measuring the scan rate and the CPU time spent in the scan interrupt.
+ */
+void test_ADC_scan_rate(void){
+    ADC_isr_max_ticks = 0;
+
+    uint16_t start = ADC_scan_count();
+    _delay_ms(1000);
+    uint16_t scans = ADC_scan_count() - start;
+
+    printf("Scans per second: %u\n\r", scans);
+    printf("Samples per second: %u\n\r", scans * ADC_NUM_CHANNELS);
+    printf("Max ISR cycles: %u\n\r", ADC_isr_max_ticks * ADC_TIMER_PRESCALER);
+    printf("Max cycles per scan: %u of %u\n\r", ADC_isr_max_ticks * ADC_TIMER_PRESCALER * ADC_NUM_CHANNELS, ADC_CHANNEL_PERIOD_TICKS * ADC_TIMER_PRESCALER * ADC_NUM_CHANNELS);
+}
+
+/** Function for running one step of the background scan: reading and filtering the finished conversion, publishing the scan when all channels are converted, and starting the next conversion.
+ *  Called by the TIMER0 compare interrupt, and directly by the host test in tests/.
  */
-uint8_t selected_channel_output(int channel){
-    // Write to the channel wanted on the ADC
-    volatile char *address = adc_addr;
-    address[0] = channel;
+void ADC_scan_step(void){
+    uint8_t back = ADC_front ^ 1;
 
-    // Delaying time t_c, waiting for writetoggle to be registered
-    _delay_us(500);
+    // Filter the conversion started at the previous step
+    filter_sample(&ADC_filters[ADC_scan_index], *adc_addr);
+    ADC_buffer[back][ADC_scan_index] = filter_output(&ADC_filters[ADC_scan_index]);
+
+    ADC_scan_index++;
+
+    // Publish the scan when all channels are converted
+    if (ADC_scan_index >= ADC_NUM_CHANNELS) {
+        ADC_scan_index = 0;
+        ADC_front = back;
+        ADC_scans++;
+    }
+
+    // Start conversion of the next channel
+    *adc_addr = ADC_FIRST_CHANNEL + ADC_scan_index;
+}
+
+/** Interrupt service routine executed every ADC_CHANNEL_PERIOD_TICKS, reading the finished conversion and starting the next.
+ */
+ISR(TIMER0_COMP_vect){
+    ADC_scan_step();
 
-    // Returning 8 bit digital signal from ADC, converted from channel specified in input
-    return address[0];
+    uint8_t ticks = TCNT0;
+    if (ticks > ADC_isr_max_ticks) {
+        ADC_isr_max_ticks = ticks;
+    }
 }
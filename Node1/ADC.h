@@ -10,9 +10,11 @@
 #include <stdio.h>
 #include <string.h>
 #include <avr/io.h>
+#include <avr/interrupt.h>
 #include <util/delay.h>
 
 #include "addresses.h"
+#include "filter.h"
 
 #define F_CPU 4915200
 
@@ -20,11 +22,61 @@
 #define set_bit( reg, bit ) (reg |= (1 << bit))
 #define clear_bit( reg, bit ) (reg &= ~(1 << bit))
 
-/** Function for returning output of selected channel of the ADC.
- *  @param channel - Hexadecimal representation of binary number corresponding to channels on ADC.
- *  @return address[0] - Voltage output of selected ADC-channel
+// Channels scanned in the background: 4 (joystick y), 5 (joystick x), 6 (left slider) and 7 (right slider)
+#define ADC_FIRST_CHANNEL 4
+#define ADC_NUM_CHANNELS 4
+
+// TIMER0 prescaler and compare period. F_CPU/64 = 76800 Hz, 38 ticks ~ 500 us conversion time per channel
+#define ADC_TIMER_PRESCALER 64
+#define ADC_CHANNEL_PERIOD_TICKS 38
+
+// Filter used on all channels until changed with ADC_set_filter: median only
+#define ADC_DEFAULT_FILTER ((filter_settings){0, 0, true})
+
+/** Struct ADC_snapshot holding one complete scan of the background channels.
+ */
+typedef struct {
+    uint8_t channel[ADC_NUM_CHANNELS];
+    uint16_t scan;
+} ADC_snapshot;
+
+/** Function for starting the background scan of channels 4-7, using TIMER0 in CTC mode.
+ *  External memory must be enabled before calling this function.
+ */
+void ADC_init(void);
+
+/** Function for stopping the background scan, so that the ADC can be read directly. The last snapshot stays valid.
+ */
+void ADC_scan_stop(void);
+
+/** Function for starting the background scan again after ADC_scan_stop. The channel of the interrupted step is converted again, so no sample of another channel is taken for it.
+ */
+void ADC_scan_start(void);
+
+/** Function for changing the input filter of one of the scanned channels. The filter state is cleared.
+ *  @param int channel - ADC channel (4-7).
+ *  @param filter_settings settings - New settings of the channel's filter.
+ */
+void ADC_set_filter(int channel, filter_settings settings);
+
+/** Function for returning the most recently completed scan of channels 4-7.
+ *  The samples in the snapshot are all from the same scan.
+ *  @return ADC_snapshot snapshot - Samples of all channels, index with (channel - ADC_FIRST_CHANNEL).
+ */
+ADC_snapshot ADC_read_snapshot(void);
+
+/** Function for waiting until the next scan is completed, so that the snapshot contains fresh samples.
+ */
+void ADC_wait_for_scan(void);
+
+/** Function for running one step of the background scan: reading and filtering the finished conversion, publishing the scan when all channels are converted, and starting the next conversion.
+ *  Called by the TIMER0 compare interrupt, and directly by the host test in tests/.
+ */
+void ADC_scan_step(void);
+
+/** Test function for measuring the scan rate and the CPU time spent in the scan interrupt.
  */
-uint8_t selected_channel_output(int channel);
+void test_ADC_scan_rate(void);
 
 
 #endif
@@ -35,6 +35,8 @@ uint8_t MCP_init(void){
 uint8_t MCP_read(uint8_t address){
     uint8_t result;
 
+    SPI_bus_acquire();
+
     // Select CAN-controller with chip select
     clear_bit(PORTB, CAN_CS);
 
@@ -50,6 +52,8 @@ uint8_t MCP_read(uint8_t address){
     // Deselect CAN-controller with chip select
     set_bit(PORTB, CAN_CS);
 
+    SPI_bus_release();
+
     return result;
 }
 
@@ -58,6 +62,8 @@ uint8_t MCP_read(uint8_t address){
  * @param uint8_t address
  */
 void MCP_write(uint8_t address, char data){
+    SPI_bus_acquire();
+
     // Select CAN-controller with chip select
     clear_bit(PORTB, CAN_CS);
 
@@ -72,29 +78,39 @@ void MCP_write(uint8_t address, char data){
 
     // Deselect CAN-controller with chip select
     set_bit(PORTB, CAN_CS);
+
+    SPI_bus_release();
 }
 
-/** Function for initiating message transmission for one or more of the transmit buffers.
- * @param uint8_t bit - Bit (0-3) which chooses which transmit buffers are enabled to send.
+/** Function for initiating message transmission for one of the transmit buffers.
+ * @param uint8_t buffer - Transmit buffer (0-2). Any other value requests transmission on all buffers.
  */
-void MCP_request_to_send(uint8_t bit){
+void MCP_request_to_send(uint8_t buffer){
+    SPI_bus_acquire();
+
     // Select CAN-controller with chip select
     clear_bit(PORTB, CAN_CS);
 
     // Send RTS command byte. The last 3 bits of it indicate which transmit buffers are enabled to send.
-    switch (bit) {
+    switch (buffer) {
         case 0:
             SPI_read_write(MCP_RTS_TX0);
+            break;
         case 1:
             SPI_read_write(MCP_RTS_TX1);
+            break;
         case 2:
             SPI_read_write(MCP_RTS_TX2);
+            break;
         default:
             SPI_read_write(MCP_RTS_ALL);
+            break;
     }
 
     // Deselect CAN-controller with chip select
     set_bit(PORTB, CAN_CS);
+
+    SPI_bus_release();
 }
 
 /** Function for allowing single instruction access to some of the often used status bits for message reception and transmission.
@@ -103,6 +119,8 @@ void MCP_request_to_send(uint8_t bit){
 uint8_t MCP_read_status(void){
     uint8_t status;
 
+    SPI_bus_acquire();
+
     // Select CAN-controller with chip select
     clear_bit(PORTB, CAN_CS);
 
@@ -115,15 +133,311 @@ uint8_t MCP_read_status(void){
     // Deselect CAN-controller with chip select
     set_bit(PORTB, CAN_CS);
 
+    SPI_bus_release();
+
     return status;
 }
 
+/** Function for reading the receive status, telling which receive buffers hold a message.
+ * @return uint8_t status - MCP_RX_STATUS_RXB0 and MCP_RX_STATUS_RXB1 are set for full buffers.
+ */
+uint8_t MCP_rx_status(void){
+    uint8_t status;
+
+    SPI_bus_acquire();
+
+    // Select CAN-controller with chip select
+    clear_bit(PORTB, CAN_CS);
+
+    // Sending RX status command byte
+    SPI_read_write(MCP_RX_STATUS);
+
+    // Reading status, the repeated byte is ignored
+    status = SPI_read_write(0x00);
+
+    // Deselect CAN-controller with chip select
+    set_bit(PORTB, CAN_CS);
+
+    SPI_bus_release();
+
+    return status;
+}
+
+/** Function for reading a received frame in one transaction with the READ RX BUFFER instruction. Only the data bytes given by DLC are read.
+ *  The receive flag of the buffer is cleared by the MCP2515 when the transaction ends.
+ * @param uint8_t buffer - Receive buffer (0-1).
+ * @param uint8_t* frame - Filled with SIDH, SIDL, EID8, EID0, DLC and the data bytes, at least MCP_FRAME_MAX_LENGTH bytes.
+ * @return uint8_t length - Number of data bytes read (0-8).
+ */
+uint8_t MCP_read_rx_buffer(uint8_t buffer, uint8_t* frame){
+    SPI_bus_acquire();
+
+    // Select CAN-controller with chip select
+    clear_bit(PORTB, CAN_CS);
+
+    // Send read RX buffer instruction, starting at RXBnSIDH
+    SPI_read_write(buffer ? MCP_READ_RX1 : MCP_READ_RX0);
+
+    for (uint8_t i = 0; i < MCP_FRAME_HEADER_LENGTH; i++){
+        frame[i] = SPI_read_write(0x00);
+    }
+
+    uint8_t length = frame[MCP_FRAME_DLC] & MCP_DLC_MASK;
+    if (length > MCP_FRAME_MAX_DATA) {
+        length = MCP_FRAME_MAX_DATA;
+    }
+
+    for (uint8_t i = 0; i < length; i++){
+        frame[MCP_FRAME_HEADER_LENGTH + i] = SPI_read_write(0x00);
+    }
+
+    // Deselect CAN-controller with chip select, clearing the receive flag
+    set_bit(PORTB, CAN_CS);
+
+    SPI_bus_release();
+
+    return length;
+}
+
+/** Function for writing a frame to a transmit buffer in one transaction with the LOAD TX BUFFER instruction.
+ * @param uint8_t buffer - Transmit buffer (0-2).
+ * @param const uint8_t* frame - SIDH, SIDL, EID8, EID0, DLC followed by the data bytes.
+ * @param uint8_t length - Number of data bytes (0-8).
+ */
+void MCP_load_tx_buffer(uint8_t buffer, const uint8_t* frame, uint8_t length){
+    SPI_bus_acquire();
+
+    // Select CAN-controller with chip select
+    clear_bit(PORTB, CAN_CS);
+
+    // Send load TX buffer instruction, starting at TXBnSIDH
+    SPI_read_write(MCP_LOAD_TX0 + 2*buffer);
+
+    for (uint8_t i = 0; i < MCP_FRAME_HEADER_LENGTH + length; i++){
+        SPI_read_write(frame[i]);
+    }
+
+    // Deselect CAN-controller with chip select
+    set_bit(PORTB, CAN_CS);
+
+    SPI_bus_release();
+}
+
+/** Function for changing operation mode, and waiting until the MCP2515 reports the new mode.
+ * @param uint8_t mode - MODE_NORMAL, MODE_LOOPBACK, MODE_CONFIG etc.
+ * @return uint8_t - 0 when the mode is entered, 1 if the MCP2515 did not enter it.
+ */
+uint8_t MCP_set_mode(uint8_t mode){
+    MCP_bit_modify(MCP_CANCTRL, MODE_MASK, mode);
+
+    // Configuration mode is entered when a frame being sent is finished
+    for (uint8_t i = 0; i < MCP_MODE_POLLS; i++){
+        if ((MCP_read(MCP_CANSTAT) & MODE_MASK) == mode) {
+            return 0;
+        }
+        _delay_us(100);
+    }
+    return 1;
+}
+
+/** Function for encoding an identifier into the SIDH, SIDL, EID8 and EID0 register layout.
+ * @param uint32_t id - 11 bit standard or 29 bit extended identifier.
+ * @param bool extended - true for an extended identifier.
+ * @param uint8_t* bytes - Filled with SIDH, SIDL, EID8 and EID0.
+ */
+void MCP_encode_id(uint32_t id, bool extended, uint8_t* bytes){
+    if (extended) {
+        // The top 11 bits are the standard identifier, followed by 18 extended bits
+        uint16_t sid = (id >> 18) & MCP_STANDARD_ID_MAX;
+
+        bytes[0] = sid >> 3;
+        bytes[1] = ((sid & 0x07) << 5) | MCP_SIDL_IDE | ((id >> 16) & 0x03);
+        bytes[2] = (id >> 8) & 0xFF;
+        bytes[3] = id & 0xFF;
+    }
+    else {
+        id &= MCP_STANDARD_ID_MAX;
+
+        bytes[0] = id >> 3;
+        bytes[1] = (id & 0x07) << 5;
+        bytes[2] = 0;
+        bytes[3] = 0;
+    }
+}
+
+/** Function for decoding an identifier from the SIDH, SIDL, EID8 and EID0 register layout of a received frame.
+ * @param const uint8_t* bytes - SIDH, SIDL, EID8 and EID0.
+ * @param bool* extended - Set to true for an extended identifier.
+ * @return uint32_t id - 11 bit standard or 29 bit extended identifier.
+ */
+uint32_t MCP_decode_id(const uint8_t* bytes, bool* extended){
+    uint32_t sid = ((uint16_t)bytes[0] << 3) | (bytes[1] >> 5);
+
+    *extended = (bytes[1] & MCP_SIDL_IDE) != 0;
+
+    if (!*extended) {
+        return sid;
+    }
+    return (sid << 18) | ((uint32_t)(bytes[1] & 0x03) << 16) | ((uint16_t)bytes[2] << 8) | bytes[3];
+}
+
+/** Function for writing an identifier to four consecutive SIDH, SIDL, EID8 and EID0 registers.
+ * @param uint8_t address - Address of the SIDH register.
+ * @param const uint8_t* bytes - SIDH, SIDL, EID8 and EID0.
+ */
+static void MCP_write_id(uint8_t address, const uint8_t* bytes){
+    for (uint8_t i = 0; i < 4; i++){
+        MCP_write(address + i, bytes[i]);
+    }
+}
+
+/** Function for setting one of the acceptance filters. The MCP2515 must be in configuration mode.
+ *  Filters 0-1 belong to RXB0 and mask 0, filters 2-5 to RXB1 and mask 1.
+ * @param uint8_t filter - Filter (0-5).
+ * @param uint32_t id - Identifier accepted by the filter.
+ * @param bool extended - true to accept extended frames only, false for standard frames only.
+ */
+void MCP_set_filter(uint8_t filter, uint32_t id, bool extended){
+    uint8_t bytes[4];
+
+    MCP_encode_id(id, extended, bytes);
+    MCP_write_id(MCP_RXF_SIDH(filter), bytes);
+}
+
+/** Function for setting one of the acceptance masks. The MCP2515 must be in configuration mode.
+ *  A set bit compares that identifier bit with the filters. For standard frames the EID8 and EID0 bits are compared with data byte 0 and 1, so they must be cleared to filter on the identifier only.
+ * @param uint8_t mask - Mask (0-1).
+ * @param uint32_t bits - Identifier bits to compare, in the layout of an extended identifier if extended is set.
+ * @param bool extended - true to also compare the 18 extended identifier bits.
+ */
+void MCP_set_mask(uint8_t mask, uint32_t bits, bool extended){
+    uint8_t bytes[4];
+
+    MCP_encode_id(bits, extended, bytes);
+
+    // Masks have no EXIDE bit
+    bytes[1] &= ~MCP_SIDL_IDE;
+
+    MCP_write_id(MCP_RXM_SIDH(mask), bytes);
+}
+
+/** Function for choosing whether a receive buffer uses the acceptance filters or receives every message.
+ * @param uint8_t buffer - Receive buffer (0-1).
+ * @param uint8_t mode - MCP_RXM_FILTER or MCP_RXM_ANY.
+ */
+void MCP_set_receive_mode(uint8_t buffer, uint8_t mode){
+    MCP_bit_modify(MCP_RXB_CTRL(buffer), MCP_RXM_MASK, mode);
+}
+
+/** Function for finding the length of phase segment 2, after the sample point. At least the information processing time.
+ * @param uint8_t quanta - Time quanta per bit.
+ * @return uint8_t - Phase segment 2 in time quanta.
+ */
+static uint8_t MCP_phase_seg2(uint8_t quanta){
+    uint8_t ps2 = (quanta * (1000 - MCP_SAMPLE_POINT_PERMILLE) + 500) / 1000;
+
+    return (ps2 < MCP_MIN_PS2) ? MCP_MIN_PS2 : ps2;
+}
+
+/** Function for finding the bit timing closest to a bit rate, with the sample point near MCP_SAMPLE_POINT_PERMILLE.
+ * The most time quanta per bit are used among the settings with the smallest rate error.
+ * @param uint32_t oscillator - Oscillator frequency of the MCP2515 in Hz.
+ * @param uint32_t bitrate - Wanted bit rate in bit/s.
+ * @param MCP_bit_timing* timing - Filled with the segments, the resulting bit rate and sample point, and the CNF register values.
+ * @return uint8_t - 0 on success, 1 if no setting is within MCP_MAX_RATE_ERROR_PERMILLE of the bit rate.
+ */
+uint8_t MCP_calculate_bit_timing(uint32_t oscillator, uint32_t bitrate, MCP_bit_timing* timing){
+    uint32_t best_error = UINT32_MAX;
+
+    if (bitrate == 0) {
+        return 1;
+    }
+
+    // Time quanta per bit and baud rate prescaler with the smallest rate error
+    for (uint8_t quanta = MCP_MAX_QUANTA; quanta >= MCP_MIN_QUANTA; quanta--){
+        // Skip bit lengths where the segments before the sample point would be too long for the sample point
+        if (quanta - 1 - MCP_phase_seg2(quanta) > 2*MCP_MAX_SEGMENT) {
+            continue;
+        }
+
+        uint32_t divider = 2 * bitrate * quanta;
+        uint32_t brp = (oscillator + divider/2) / divider;
+
+        if ((brp == 0) || (brp > MCP_MAX_BRP + 1)) {
+            continue;
+        }
+
+        uint32_t actual = oscillator / (2 * brp * quanta);
+        uint32_t error = (actual > bitrate) ? (actual - bitrate) : (bitrate - actual);
+
+        if (error < best_error) {
+            best_error = error;
+            timing->brp = brp - 1;
+            timing->quanta = quanta;
+            timing->bitrate = actual;
+        }
+    }
+
+    if ((best_error == UINT32_MAX) || ((best_error * 1000) / bitrate > MCP_MAX_RATE_ERROR_PERMILLE)) {
+        return 1;
+    }
+
+    // The rest after the sync segment is split between propagation and phase segment 1, phase segment 1 taking the odd quantum
+    uint8_t quanta = timing->quanta;
+    uint8_t ps2 = MCP_phase_seg2(quanta);
+    uint8_t before = quanta - 1 - ps2;
+    uint8_t prop = before / 2;
+    uint8_t ps1 = before - prop;
+
+    // SJW shorter than phase segment 2
+    uint8_t sjw = ps2 - 1;
+    if (sjw > MCP_MAX_SJW) {
+        sjw = MCP_MAX_SJW;
+    }
+
+    timing->prop_seg = prop;
+    timing->phase_seg1 = ps1;
+    timing->phase_seg2 = ps2;
+    timing->sjw = sjw;
+    timing->sample_point_permille = ((uint16_t)(1 + prop + ps1) * 1000) / quanta;
+
+    timing->cnf1 = ((sjw - 1) << 6) | timing->brp;
+    timing->cnf2 = BTLMODE | SAMPLE_1X | ((ps1 - 1) << 3) | (prop - 1);
+    timing->cnf3 = ps2 - 1;
+
+    return 0;
+}
+
+/** Function for setting the bit rate. The MCP2515 must be in configuration mode.
+ * @param uint32_t bitrate - Wanted bit rate in bit/s.
+ * @param MCP_bit_timing* timing - Filled with the timing used, may be NULL.
+ * @return uint8_t - 0 on success, 1 if the bit rate can not be made from MCP_OSCILLATOR_HZ. The CNF registers are then unchanged.
+ */
+uint8_t MCP_set_bit_timing(uint32_t bitrate, MCP_bit_timing* timing){
+    MCP_bit_timing calculated;
+
+    if (MCP_calculate_bit_timing(MCP_OSCILLATOR_HZ, bitrate, &calculated)) {
+        return 1;
+    }
+
+    MCP_write(MCP_CNF1, calculated.cnf1);
+    MCP_write(MCP_CNF2, calculated.cnf2);
+    MCP_write(MCP_CNF3, calculated.cnf3);
+
+    if (timing != NULL) {
+        *timing = calculated;
+    }
+    return 0;
+}
+
 /** Function for setting or clearing individual bits in specific status and control registers.
  * @param uint8_t address - The address of the register you want to modify.
  * @param uint8_t mask - Mask determines which bit in register will be allowed to change.
  * @param uint8_t data - Data byte determines what value the modified bits in the register will be changed to.
  */
 void MCP_bit_modify(uint8_t address, uint8_t mask, uint8_t data){
+    SPI_bus_acquire();
+
     // Select CAN-controller with chip select
     clear_bit(PORTB, CAN_CS);
 
@@ -141,11 +455,15 @@ void MCP_bit_modify(uint8_t address, uint8_t mask, uint8_t data){
 
     // Deselect CAN-controller with chip select
     set_bit(PORTB, CAN_CS);
+
+    SPI_bus_release();
 }
 
 /** Function for resetting the internal registers of MCP2515, and setting configuration mode.
  */
 void MCP_reset(void){
+    SPI_bus_acquire();
+
     // Select CAN-controller with chip select
     clear_bit(PORTB, CAN_CS);
 
@@ -154,4 +472,6 @@ void MCP_reset(void){
 
     // Deselect CAN-controller with chip select
     set_bit(PORTB, CAN_CS);
+
+    SPI_bus_release();
 }
@@ -1,13 +1,73 @@
 /** @file oled.c
- *  @brief OLED C-file for displaying on OLED-screen of multiboard.
+ *  @brief OLED C-file for displaying on OLED-screen of multiboard. Drawing functions write to a framebuffer in the external SRAM.
+ *  OLED_update hands the changed parts to the flush engine, which sends a bounded number of bytes to the display every scheduler tick.
  *  @authors: Anastasia Lindbäck and Marie Skatvedt
  */
 
 #include "OLED.h"
+#include "fonts.h"
 
 static FILE OLED_stream = FDEV_SETUP_STREAM(OLED_write, NULL, _FDEV_SETUP_WRITE);
 static FILE OLED_stream_highlight = FDEV_SETUP_STREAM(OLED_highlight, NULL, _FDEV_SETUP_WRITE);
 
+// Column the cursor wraps back to at the end of a line, set by OLED_go_to_column like the column window of the display
+static uint8_t OLED_window_column = 0;
+
+// Dirty column range of each page, clean when start > end
+static uint8_t OLED_dirty_start[OLED_LINES];
+static uint8_t OLED_dirty_end[OLED_LINES];
+
+// Set while the framebuffer is being drawn, the flush engine waits until OLED_update so that half drawn frames are not sent
+static volatile bool OLED_drawing = false;
+
+// Column range of each page handed to the flush engine and not yet sent, clean when start > end
+static volatile uint8_t OLED_send_start[OLED_LINES];
+static volatile uint8_t OLED_send_end[OLED_LINES];
+
+// Set while the flush engine has data to send
+static volatile bool OLED_pending = false;
+
+// Page whose column window is set on the display, OLED_LINES when the window must be set again
+static volatile uint8_t OLED_window_line = OLED_LINES;
+
+// Bytes (commands and data) the flush engine may send per tick
+static volatile uint8_t OLED_flush_budget = OLED_FLUSH_BUDGET;
+
+// Data bytes sent to the display since init
+static volatile uint32_t OLED_total_bytes = 0;
+
+// Frames completed during the current second, and during the last second
+static volatile uint16_t OLED_frames = 0;
+static volatile uint16_t OLED_fps = 0;
+static uint16_t OLED_fps_start = 0;
+
+/** Function for writing one byte to the framebuffer at the cursor, marking it dirty and advancing the cursor like the display does.
+ * @param uint8_t data - Byte to write, one column of 8 pixels.
+ */
+static void OLED_put(uint8_t data) {
+    volatile uint8_t* byte = &oled_framebuffer_addr[current_line * OLED_COLS + current_column];
+
+    OLED_drawing = true;
+
+    if (*byte != data) {
+        *byte = data;
+
+        if (current_column < OLED_dirty_start[current_line]) {
+            OLED_dirty_start[current_line] = current_column;
+        }
+        if (current_column > OLED_dirty_end[current_line]) {
+            OLED_dirty_end[current_line] = current_column;
+        }
+    }
+
+    // Horizontal addressing mode, wrap to the start of the column window on the next page
+    current_column++;
+    if (current_column >= OLED_COLS) {
+        current_column = OLED_window_column;
+        current_line = (current_line + 1) % OLED_LINES;
+    }
+}
+
 /** Initialization routine, setting up OLED display
  */
 void OLED_init(void){
@@ -46,8 +106,18 @@ void OLED_init(void){
     *address = (0xa6); //Set normal display
     *address = (0xaf); //Display on
 
+    // The display RAM is unknown after power up, so every page is sent at the first flush
+    OLED_window_line = OLED_LINES;
+    for (int line = 0; line < OLED_LINES; line++) {
+        OLED_dirty_start[line] = 0;
+        OLED_dirty_end[line] = OLED_COLS - 1;
+        OLED_send_start[line] = OLED_COLS;
+        OLED_send_end[line] = 0;
+    }
+
     OLED_reset();
     OLED_home();
+    OLED_flush();
 }
 
 /**Function for writing data to OLED.
@@ -55,7 +125,7 @@ void OLED_init(void){
  */
 void OLED_write(unsigned char character) {
     for (int line = 0; line < FONT_SIZE; line++) {
-        *data_oled_addr = pgm_read_byte(&font8[character-FONT_OFFSET][line]);
+        OLED_put(pgm_read_byte(&font8[character-FONT_OFFSET][line]));
     }
 }
 
@@ -64,7 +134,7 @@ void OLED_write(unsigned char character) {
  */
 void OLED_highlight(unsigned char character) {
     for (int line = 0; line < FONT_SIZE; line++) {
-        *data_oled_addr = ~pgm_read_byte(&font8[character-FONT_OFFSET][line]);
+        OLED_put(~pgm_read_byte(&font8[character-FONT_OFFSET][line]));
     }
 }
 
@@ -99,10 +169,6 @@ void OLED_command(uint8_t cmnd) {
  * @param uint8_t line - Which line in OLED-matrix to go to.
  */
 void OLED_go_to_line(uint8_t line) {
-    OLED_command(oled_set_page_addr); // Set page address
-    OLED_command(oled_page_start_addr + line); // Set start address
-    OLED_command(oled_page_end_addr); // Set end address
-
     OLED_go_to_column(current_column);
 
     current_line = line;
@@ -112,9 +178,7 @@ void OLED_go_to_line(uint8_t line) {
  * @param uint8_t column - Which column in OLED-matrix to go to.
  */
 void OLED_go_to_column(uint8_t column) {
-    OLED_command(oled_set_col_addr); // Set column address
-    OLED_command(oled_col_start_addr + column); // Set start address
-    OLED_command(oled_col_end_addr); // Set end address
+    OLED_window_column = column;
 
     current_column = column;
 }
@@ -133,7 +197,7 @@ void OLED_clear_line(uint8_t line) {
     OLED_position(line, 0);
 
     for (int col = 0; col < OLED_COLS; col++) {
-        *data_oled_addr = 0b00000000;
+        OLED_put(0b00000000);
     }
 }
 
@@ -150,3 +214,189 @@ void OLED_reset(void) {
 void OLED_home(void) {
     OLED_position(0,0);
 }
+
+/**Function for marking the framebuffer as updated, handing the dirty parts to the flush engine. Does not block.
+ * Only the dirty column range of each page is handed over.
+ * @return uint16_t bytes - Number of data bytes handed to the flush engine.
+ */
+uint16_t OLED_update(void) {
+    uint16_t bytes = 0;
+
+    for (uint8_t line = 0; line < OLED_LINES; line++) {
+        uint8_t start = OLED_dirty_start[line];
+        uint8_t end = OLED_dirty_end[line];
+
+        if (start > end) {
+            continue;
+        }
+
+        OLED_dirty_start[line] = OLED_COLS;
+        OLED_dirty_end[line] = 0;
+
+        bytes += end - start + 1;
+
+        // Merge with the range the flush engine has not sent yet
+        uint8_t sreg = SREG;
+        cli();
+
+        if (OLED_send_start[line] < start) {
+            start = OLED_send_start[line];
+        }
+        if ((OLED_send_start[line] <= OLED_send_end[line]) && (OLED_send_end[line] > end)) {
+            end = OLED_send_end[line];
+        }
+
+        OLED_send_start[line] = start;
+        OLED_send_end[line] = end;
+        OLED_pending = true;
+
+        // The window on the display no longer matches the range
+        if (OLED_window_line == line) {
+            OLED_window_line = OLED_LINES;
+        }
+
+        SREG = sreg;
+    }
+
+    OLED_drawing = false;
+
+    return bytes;
+}
+
+/**Function for marking the framebuffer as updated, and running the flush engine until everything is sent to the display.
+ * @return uint16_t bytes - Number of data bytes handed to the flush engine.
+ */
+uint16_t OLED_flush(void) {
+    uint16_t bytes = OLED_update();
+
+    while (OLED_pending) {
+        OLED_flush_tick();
+    }
+
+    return bytes;
+}
+
+/**Function for sending at most the flush budget of bytes to the display, continuing where the last tick stopped. Run as a scheduler task every millisecond.
+ */
+void OLED_flush_tick(void) {
+    // Frames per second
+    if (timer_elapsed_ms(OLED_fps_start) >= 1000) {
+        OLED_fps = OLED_frames;
+        OLED_frames = 0;
+        OLED_fps_start = timer_ms();
+    }
+
+    if (OLED_drawing || !OLED_pending) {
+        return;
+    }
+
+    uint8_t budget = OLED_flush_budget;
+
+    while (budget > 0) {
+        uint8_t line = OLED_window_line;
+
+        // Set the window to the next page with data, the display advances through it as data is written
+        if ((line >= OLED_LINES) || (OLED_send_start[line] > OLED_send_end[line])) {
+            line = 0;
+            while ((line < OLED_LINES) && (OLED_send_start[line] > OLED_send_end[line])) {
+                line++;
+            }
+
+            if (line >= OLED_LINES) {
+                OLED_pending = false;
+                OLED_window_line = OLED_LINES;
+                OLED_frames++;
+                return;
+            }
+
+            OLED_command(oled_set_col_addr);
+            OLED_command(oled_col_start_addr + OLED_send_start[line]);
+            OLED_command(oled_col_start_addr + OLED_send_end[line]);
+
+            OLED_command(oled_set_page_addr);
+            OLED_command(oled_page_start_addr + line);
+            OLED_command(oled_page_start_addr + line);
+
+            OLED_window_line = line;
+            budget = (budget > OLED_WINDOW_COMMAND_BYTES) ? budget - OLED_WINDOW_COMMAND_BYTES : 0;
+        }
+
+        uint8_t col = OLED_send_start[line];
+        uint8_t end = OLED_send_end[line];
+        volatile uint8_t* page = &oled_framebuffer_addr[line * OLED_COLS];
+
+        while ((budget > 0) && (col <= end)) {
+            *data_oled_addr = page[col];
+            col++;
+            budget--;
+            OLED_total_bytes++;
+        }
+
+        if (col > end) {
+            OLED_send_start[line] = OLED_COLS;
+            OLED_send_end[line] = 0;
+        }
+        else {
+            OLED_send_start[line] = col;
+        }
+    }
+}
+
+/**Function for setting the number of bytes the flush engine may send per tick.
+ * @param uint8_t bytes - Bytes per tick, commands included. At least 1.
+ */
+void OLED_set_flush_budget(uint8_t bytes) {
+    OLED_flush_budget = (bytes > 0) ? bytes : 1;
+}
+
+/**Function for returning the number of frames the flush engine completed during the last second.
+ * @return uint16_t - Frames per second.
+ */
+uint16_t OLED_frames_per_second(void) {
+    uint8_t sreg = SREG;
+    cli();
+    uint16_t fps = OLED_fps;
+    SREG = sreg;
+
+    return fps;
+}
+
+/**Function for returning the number of data bytes sent to the display since init.
+ * @return uint32_t - Number of bytes.
+ */
+uint32_t OLED_bytes_written(void) {
+    uint8_t sreg = SREG;
+    cli();
+    uint32_t bytes = OLED_total_bytes;
+    SREG = sreg;
+
+    return bytes;
+}
+
+/**Test function comparing the bytes sent by a full redraw with the bytes sent when only one line is changed.
+ */
+void test_OLED_flush_bytes(void) {
+    OLED_reset();
+    OLED_home();
+    OLED_print("   MAIN MENU");
+    OLED_position(2, 0);
+    OLED_print_highlight("o PLAY GAME");
+    OLED_position(3, 0);
+    OLED_print("  GAME SETTINGS");
+    uint16_t first = OLED_flush();
+
+    // Same screen with the highlight moved one line down
+    OLED_reset();
+    OLED_home();
+    OLED_print("   MAIN MENU");
+    OLED_position(2, 0);
+    OLED_print("  PLAY GAME");
+    OLED_position(3, 0);
+    OLED_print_highlight("o GAME SETTINGS");
+    uint16_t second = OLED_flush();
+
+    printf("Direct writes per redraw: %u bytes\n\r", OLED_LINES * OLED_COLS);
+    printf("First flush: %u bytes\n\r", first);
+    printf("Highlight change flush: %u bytes\n\r", second);
+    printf("Frames per second: %u\n\r", OLED_frames_per_second());
+}
@@ -1,5 +1,6 @@
 /** @file oled.c
- *  @brief OLED H-file for displaying on OLED-screen of multiboard.
+ *  @brief OLED H-file for displaying on OLED-screen of multiboard. Drawing functions write to a framebuffer in the external SRAM.
+ *  OLED_update hands the changed parts to the flush engine, which sends a bounded number of bytes to the display every scheduler tick.
  *  @authors: Anastasia Lindbäck and Marie Skatvedt
  */
 
@@ -13,15 +14,21 @@
 
 #define FONT_SIZE 8
 
+// Bytes the flush engine sends per tick by default, and the command bytes needed to set the column and page window
+#define OLED_FLUSH_BUDGET 32
+#define OLED_WINDOW_COMMAND_BYTES 6
 
+
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdarg.h>
 #include <util/delay.h>
+#include <avr/interrupt.h>
 #include <avr/pgmspace.h>
 
 #include "addresses.h"
-#include "fonts.h"
+#include "timer.h"
 
 // Global unsigned ints for keeping track of current line and column
 uint8_t current_line;
@@ -85,4 +92,38 @@ void OLED_reset(void);
  */
 void OLED_home(void);
 
+/**Function for marking the framebuffer as updated, handing the dirty parts to the flush engine. Does not block.
+ * Only the dirty column range of each page is handed over.
+ * @return uint16_t bytes - Number of data bytes handed to the flush engine.
+ */
+uint16_t OLED_update(void);
+
+/**Function for marking the framebuffer as updated, and running the flush engine until everything is sent to the display.
+ * @return uint16_t bytes - Number of data bytes handed to the flush engine.
+ */
+uint16_t OLED_flush(void);
+
+/**Function for sending at most the flush budget of bytes to the display, continuing where the last tick stopped. Run as a scheduler task every millisecond.
+ */
+void OLED_flush_tick(void);
+
+/**Function for setting the number of bytes the flush engine may send per tick.
+ * @param uint8_t bytes - Bytes per tick, commands included. At least 1.
+ */
+void OLED_set_flush_budget(uint8_t bytes);
+
+/**Function for returning the number of frames the flush engine completed during the last second.
+ * @return uint16_t - Frames per second.
+ */
+uint16_t OLED_frames_per_second(void);
+
+/**Function for returning the number of data bytes sent to the display since init.
+ * @return uint32_t - Number of bytes.
+ */
+uint32_t OLED_bytes_written(void);
+
+/**Test function comparing the bytes sent by a full redraw with the bytes sent when only one line is changed.
+ */
+void test_OLED_flush_bytes(void);
+
 #endif
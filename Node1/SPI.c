@@ -1,9 +1,34 @@
 /** @file SPI.c
  *  @brief c-file for the SPI communication driver.
+ *  Bytes are either transferred one at a time with busy waiting, or as queued transactions advanced by the SPI interrupt.
  *  @authors: Anastasia Lindbäck and Marie Skatvedt
  */
 
 #include "SPI.h"
+#include "timer.h"
+
+// Number of bytes transferred since start
+static volatile uint32_t SPI_bytes = 0;
+
+// Queued transactions, the one at the head is in progress while SPI_active is set
+static SPI_transaction* volatile SPI_queue[SPI_QUEUE_LENGTH];
+static volatile uint8_t SPI_queue_head = 0;
+static volatile uint8_t SPI_queue_tail = 0;
+static volatile bool SPI_active = false;
+
+// Index of the byte being transferred in the active transaction
+static volatile uint8_t SPI_index = 0;
+
+// Owners of the bus, counting nested acquisitions
+static volatile uint8_t SPI_bus_owners = 0;
+
+// Work waiting for the bus, and when it was requested
+static volatile SPI_deferred SPI_bus_deferred = NULL;
+static volatile uint16_t SPI_bus_deferred_time = 0;
+
+static volatile SPI_bus_statistics SPI_bus_stats;
+static volatile uint16_t SPI_bus_latency_max_ticks = 0;
+static volatile uint32_t SPI_bus_latency_total_ticks = 0;
 
 /**Function for initializing communication over SPI.
  */
@@ -20,18 +45,241 @@ void SPI_init(void) {
     // Enable Master
     set_bit(SPCR, MSTR);
 
-    // Set clock rate fck/16
-    set_bit(SPCR, SPR0);
+    SPI_set_clock(SPI_CLOCK_DEFAULT);
 
     // Enable SPI
     set_bit(SPCR, SPE);
 }
 
+/**Function for changing the SPI clock. Waits for queued transactions first.
+ * @param SPI_clock clock - Division of the CPU clock.
+ */
+void SPI_set_clock(SPI_clock clock) {
+    SPI_wait();
+
+    SPCR = (SPCR & ~((1 << SPR1) | (1 << SPR0))) | (clock & 0x03);
+
+    if (clock & 0x04) {
+        set_bit(SPSR, SPI2X);
+    }
+    else {
+        clear_bit(SPSR, SPI2X);
+    }
+}
+
+/**Function for running the deferred work while the bus is free. Called with interrupts disabled, and returns with them disabled.
+ * @param uint8_t sreg - Status register of the caller, restored while the work runs.
+ */
+static void SPI_bus_run_deferred(uint8_t sreg) {
+    while ((SPI_bus_owners == 0) && !SPI_active && (SPI_bus_deferred != NULL)) {
+        SPI_deferred work = SPI_bus_deferred;
+        SPI_bus_deferred = NULL;
+
+        uint16_t ticks = timer_ticks() - SPI_bus_deferred_time;
+        SPI_bus_latency_total_ticks += ticks;
+        if (ticks > SPI_bus_latency_max_ticks) {
+            SPI_bus_latency_max_ticks = ticks;
+        }
+
+        SPI_bus_owners = 1;
+        SREG = sreg;
+
+        work();
+
+        cli();
+        SPI_bus_owners = 0;
+    }
+}
+
+/**Function for starting the transaction at the head of the queue, or disabling the SPI interrupt if the queue is empty.
+ */
+static void SPI_start_next(void) {
+    if (SPI_queue_head == SPI_queue_tail) {
+        SPI_active = false;
+        clear_bit(SPCR, SPIE);
+
+        // Work deferred while the transactions had the bus
+        SPI_bus_run_deferred(SREG);
+        return;
+    }
+
+    SPI_transaction* transaction = SPI_queue[SPI_queue_head % SPI_QUEUE_LENGTH];
+    SPI_index = 0;
+    SPI_active = true;
+
+    if (transaction->cs_port != NULL) {
+        *transaction->cs_port &= ~transaction->cs_mask;
+    }
+
+    set_bit(SPCR, SPIE);
+    SPDR = (transaction->tx != NULL) ? transaction->tx[0] : 0x00;
+}
+
+/**Function for taking the received byte of the active transaction, and sending the next byte or completing the transaction. Called when SPIF is set.
+ */
+static void SPI_advance(void) {
+    SPI_transaction* transaction = SPI_queue[SPI_queue_head % SPI_QUEUE_LENGTH];
+    uint8_t index = SPI_index;
+    uint8_t data = SPDR;
+
+    if (transaction->rx != NULL) {
+        transaction->rx[index] = data;
+    }
+
+    SPI_bytes++;
+    index++;
+    SPI_index = index;
+
+    if (index < transaction->length) {
+        SPDR = (transaction->tx != NULL) ? transaction->tx[index] : 0x00;
+        return;
+    }
+
+    if (transaction->cs_port != NULL) {
+        *transaction->cs_port |= transaction->cs_mask;
+    }
+
+    SPI_queue_head++;
+    transaction->complete = true;
+
+    if (transaction->done != NULL) {
+        transaction->done(transaction);
+    }
+
+    SPI_start_next();
+}
+
+/**Function for queuing a transaction. It is started at once if the bus is idle, and advanced by the SPI interrupt.
+ * @param SPI_transaction* transaction - The transaction, with at least one byte.
+ * @return bool - false if the queue is full or the transaction is empty.
+ */
+bool SPI_submit(SPI_transaction* transaction) {
+    if (transaction->length == 0) {
+        return false;
+    }
+
+    uint8_t sreg = SREG;
+    cli();
+
+    if ((uint8_t)(SPI_queue_tail - SPI_queue_head) >= SPI_QUEUE_LENGTH) {
+        SREG = sreg;
+        return false;
+    }
+
+    transaction->complete = false;
+    SPI_queue[SPI_queue_tail % SPI_QUEUE_LENGTH] = transaction;
+    SPI_queue_tail++;
+
+    if (!SPI_active) {
+        SPI_start_next();
+    }
+
+    SREG = sreg;
+    return true;
+}
+
+/**Function returning whether a transaction is in progress.
+ * @return bool - true while the bus is busy.
+ */
+bool SPI_busy(void) {
+    return SPI_active;
+}
+
+/**Function for waiting until every queued transaction is complete. With interrupts disabled, the transactions are advanced by polling.
+ */
+void SPI_wait(void) {
+    while (SPI_active) {
+        if (!test_bit(SREG, SREG_I) && test_bit(SPSR, SPIF)) {
+            SPI_advance();
+        }
+    }
+}
+
+/**Function for taking the bus for a chip select transaction, or a sequence of them that must not be interleaved with deferred work. Can be nested.
+ * Waits until the queued transactions are complete, so that the bus is idle when it returns.
+ */
+void SPI_bus_acquire(void) {
+    uint8_t sreg = SREG;
+    cli();
+    SPI_bus_owners++;
+    SREG = sreg;
+
+    // Deferred work does not start while the bus is owned, but queued transactions may still be in progress
+    SPI_wait();
+}
+
+/**Function for giving the bus back after SPI_bus_acquire. Deferred work is run when the last owner releases the bus.
+ */
+void SPI_bus_release(void) {
+    uint8_t sreg = SREG;
+    cli();
+
+    if (SPI_bus_owners > 0) {
+        SPI_bus_owners--;
+    }
+    SPI_bus_run_deferred(sreg);
+
+    SREG = sreg;
+}
+
+/**Function for running work that needs the bus, from an interrupt. The work runs at once if the bus is free, and when it is released otherwise.
+ * One work can wait at a time, a request while it waits is merged with it.
+ * Work deferred while queued transactions had the bus runs inside the SPI interrupt when the queue is empty, with interrupts disabled, so it must be short.
+ * @param SPI_deferred work - The work.
+ * @return bool - true if the work ran at once.
+ */
+bool SPI_bus_run(SPI_deferred work) {
+    uint8_t sreg = SREG;
+    cli();
+
+    SPI_bus_stats.requests++;
+
+    if ((SPI_bus_owners == 0) && !SPI_active) {
+        SPI_bus_owners = 1;
+        SREG = sreg;
+
+        work();
+
+        SPI_bus_release();
+        return true;
+    }
+
+    SPI_bus_stats.contentions++;
+
+    if (SPI_bus_deferred == NULL) {
+        SPI_bus_deferred_time = timer_ticks();
+    }
+    SPI_bus_deferred = work;
+
+    SREG = sreg;
+    return false;
+}
+
+/**Function for returning the bus arbitration counters.
+ * @return SPI_bus_statistics - Requests, contentions and deferral latency.
+ */
+SPI_bus_statistics SPI_read_bus_statistics(void) {
+    uint8_t sreg = SREG;
+    cli();
+    SPI_bus_statistics statistics = SPI_bus_stats;
+    uint16_t max_ticks = SPI_bus_latency_max_ticks;
+    uint32_t total_ticks = SPI_bus_latency_total_ticks;
+    SREG = sreg;
+
+    statistics.latency_max_us = TIMER_TICKS_TO_US(max_ticks);
+    statistics.latency_total_us = TIMER_TICKS_TO_US(total_ticks);
+
+    return statistics;
+}
+
 /**Function for transmitting and receiving data over SPI.
+ * Queued transactions are finished first.
  * @param char data - Data to send.
  * @return uint8_t SPDR - The contents of the SPDR.
  */
 uint8_t SPI_read_write(uint8_t data) {
+    SPI_wait();
+
     /* Transmission of data */
     // Start transmission
     SPDR = data;
@@ -39,9 +287,23 @@ uint8_t SPI_read_write(uint8_t data) {
     // Wait for transmission to complete
     loop_until_bit_is_set(SPSR, SPIF);
 
+    SPI_bytes++;
+
     return SPDR;
 }
 
+/**Function for returning the number of bytes transferred over SPI since start, for measuring the cost of bus operations.
+ * @return uint32_t - Number of bytes.
+ */
+uint32_t SPI_bytes_transferred(void) {
+    uint8_t sreg = SREG;
+    cli();
+    uint32_t bytes = SPI_bytes;
+    SREG = sreg;
+
+    return bytes;
+}
+
 /**Function for testing SPI driver.
  * @param char data - Data to send.
  */
@@ -53,3 +315,84 @@ void SPI_test(char data){
 
     }
 }
+
+/**Function for counting iterations of an empty loop for a number of timer ticks, the reference for the CPU time left during a transaction.
+ * @param uint16_t ticks - Timer ticks to count for.
+ * @return uint32_t - Iterations.
+ */
+static uint32_t SPI_idle_iterations(uint16_t ticks) {
+    volatile uint32_t count = 0;
+    uint16_t start = timer_ticks();
+
+    while ((uint16_t)(timer_ticks() - start) < ticks) {
+        count++;
+    }
+    return count;
+}
+
+/**Test function measuring the throughput at each clock setting, with busy waiting and with an interrupt driven transaction. For the transaction, the share of CPU time left to the main loop is also measured.
+ * Runs without chip select, so no device is addressed.
+ */
+void test_SPI_throughput(void) {
+    const SPI_clock clocks[] = {SPI_CLOCK_DIV2, SPI_CLOCK_DIV4, SPI_CLOCK_DIV8, SPI_CLOCK_DIV16, SPI_CLOCK_DIV32, SPI_CLOCK_DIV64, SPI_CLOCK_DIV128};
+    const uint8_t divisions[] = {2, 4, 8, 16, 32, 64, 128};
+
+    static uint8_t buffer[SPI_BENCHMARK_BYTES];
+
+    for (uint8_t i = 0; i < sizeof(clocks)/sizeof(clocks[0]); i++) {
+        SPI_set_clock(clocks[i]);
+
+        // Busy waiting
+        uint16_t start = timer_ticks();
+        for (uint8_t n = 0; n < SPI_BENCHMARK_BYTES; n++) {
+            buffer[n] = SPI_read_write(n);
+        }
+        uint32_t polled_us = TIMER_TICKS_TO_US((uint16_t)(timer_ticks() - start));
+
+        // Interrupt driven, counting the main loop iterations meanwhile
+        SPI_transaction transaction = {NULL, 0, buffer, buffer, SPI_BENCHMARK_BYTES, NULL, false};
+        volatile uint32_t count = 0;
+
+        start = timer_ticks();
+        SPI_submit(&transaction);
+        while (!transaction.complete) {
+            count++;
+        }
+        uint16_t ticks = timer_ticks() - start;
+
+        uint32_t idle = SPI_idle_iterations(ticks);
+        uint32_t queued_us = TIMER_TICKS_TO_US(ticks);
+
+        printf("fck/%u:\n\r", divisions[i]);
+        if (polled_us > 0) {
+            printf("    Busy waiting: %lu bytes/s\n\r", (SPI_BENCHMARK_BYTES * 1000000UL) / polled_us);
+        }
+        if (queued_us > 0) {
+            printf("    Interrupt: %lu bytes/s", (SPI_BENCHMARK_BYTES * 1000000UL) / queued_us);
+        }
+        if (idle > 0) {
+            printf(", %lu %% CPU left", (count * 100) / idle);
+        }
+        printf("\n\r");
+    }
+
+    SPI_set_clock(SPI_CLOCK_DEFAULT);
+}
+
+/**Test function for printing the bus arbitration counters.
+ */
+void test_SPI_bus_statistics(void) {
+    SPI_bus_statistics statistics = SPI_read_bus_statistics();
+
+    printf("Bus requests: %u\n\r", statistics.requests);
+    printf("Deferred: %u\n\r", statistics.contentions);
+    if (statistics.contentions > 0) {
+        printf("Deferral latency: %lu us average, %u us max\n\r", statistics.latency_total_us / statistics.contentions, statistics.latency_max_us);
+    }
+}
+
+/**Interrupt service routine executed when a byte of the active transaction is transferred.
+ */
+ISR(SPI_STC_vect) {
+    SPI_advance();
+}
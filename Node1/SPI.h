@@ -1,13 +1,18 @@
 /** @file SPI.h
  *  @brief Header-file for the SPI communication driver.
+ *  Bytes are either transferred one at a time with busy waiting, or as queued transactions advanced by the SPI interrupt.
  *  @authors: Anastasia Lindbäck and Marie Skatvedt
  */
 
 #ifndef SPI_H
 #define SPI_H
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <avr/io.h>
+#include <avr/interrupt.h>
 
 #include "bit_operations.h"
 
@@ -17,19 +22,138 @@
 #define PIN_MISO PB6
 #define PIN_SCK PB7
 
+// Transactions waiting for the bus, a power of two
+#define SPI_QUEUE_LENGTH 4
+
+// Bytes transferred at each clock setting in the throughput benchmark
+#define SPI_BENCHMARK_BYTES 128
+
+/** Enum SPI_clock representing the SPI clock as a division of the CPU clock, encoded as SPI2X in bit 2 and SPR1:0 in bits 1-0.
+ */
+typedef enum {
+    SPI_CLOCK_DIV2 = 0x04,
+    SPI_CLOCK_DIV4 = 0x00,
+    SPI_CLOCK_DIV8 = 0x05,
+    SPI_CLOCK_DIV16 = 0x01,
+    SPI_CLOCK_DIV32 = 0x06,
+    SPI_CLOCK_DIV64 = 0x02,
+    SPI_CLOCK_DIV128 = 0x03
+} SPI_clock;
+
+// Clock set by SPI_init. fck/2 is 2.46 MHz, well below the 10 MHz limit of the MCP2515
+#define SPI_CLOCK_DEFAULT SPI_CLOCK_DIV2
+
+struct SPI_transaction;
+
+/** Function pointer type for the completion callback of a transaction. Called from the SPI interrupt.
+ */
+typedef void (*SPI_callback)(struct SPI_transaction* transaction);
+
+/** Struct SPI_transaction representing a chip select transaction. Owned by the caller, and must stay valid until it is complete.
+ */
+typedef struct SPI_transaction {
+    // Chip select pins, low during the transaction. NULL for no chip select
+    volatile uint8_t* cs_port;
+    uint8_t cs_mask;
+
+    // Bytes to send, NULL to send zeros. Received bytes, NULL to discard them
+    const uint8_t* tx;
+    uint8_t* rx;
+    uint8_t length;
+
+    // Called when the transaction is complete, may be NULL
+    SPI_callback done;
+
+    // Set when the last byte is transferred and the chip select is released
+    volatile bool complete;
+} SPI_transaction;
+
+/** Function pointer type for work that needs the bus, run at once if it is free and deferred until it is released otherwise.
+ */
+typedef void (*SPI_deferred)(void);
+
+/** Struct SPI_bus_statistics representing the counters of the bus arbitration.
+ */
+typedef struct {
+    // Work requested with SPI_bus_run, and requests that found the bus owned and were deferred
+    uint16_t requests;
+    uint16_t contentions;
+
+    // Time from a deferred request until the work ran
+    uint16_t latency_max_us;
+    uint32_t latency_total_us;
+} SPI_bus_statistics;
+
 /**Function for initializing communication over SPI.
  */
 void SPI_init(void);
 
+/**Function for changing the SPI clock. Waits for queued transactions first.
+ * @param SPI_clock clock - Division of the CPU clock.
+ */
+void SPI_set_clock(SPI_clock clock);
+
 /**Function for transmitting and receiving data over SPI.
+ * Queued transactions are finished first.
  * @param char data - Data to send.
  * @return uint8_t SPDR - The contents of the SPDR.
  */
 uint8_t SPI_read_write(uint8_t data);
 
+/**Function for queuing a transaction. It is started at once if the bus is idle, and advanced by the SPI interrupt.
+ * @param SPI_transaction* transaction - The transaction, with at least one byte.
+ * @return bool - false if the queue is full or the transaction is empty.
+ */
+bool SPI_submit(SPI_transaction* transaction);
+
+/**Function returning whether a transaction is in progress.
+ * @return bool - true while the bus is busy.
+ */
+bool SPI_busy(void);
+
+/**Function for waiting until every queued transaction is complete. With interrupts disabled, the transactions are advanced by polling.
+ */
+void SPI_wait(void);
+
+/**Function for taking the bus for a chip select transaction, or a sequence of them that must not be interleaved with deferred work. Can be nested.
+ * Waits until the queued transactions are complete, so that the bus is idle when it returns.
+ */
+void SPI_bus_acquire(void);
+
+/**Function for giving the bus back after SPI_bus_acquire. Deferred work is run when the last owner releases the bus.
+ */
+void SPI_bus_release(void);
+
+/**Function for running work that needs the bus, from an interrupt. The work runs at once if the bus is free, and when it is released otherwise.
+ * One work can wait at a time, a request while it waits is merged with it.
+ * Work deferred while queued transactions had the bus runs inside the SPI interrupt when the queue is empty, with interrupts disabled, so it must be short.
+ * @param SPI_deferred work - The work.
+ * @return bool - true if the work ran at once.
+ */
+bool SPI_bus_run(SPI_deferred work);
+
+/**Function for returning the bus arbitration counters.
+ * @return SPI_bus_statistics - Requests, contentions and deferral latency.
+ */
+SPI_bus_statistics SPI_read_bus_statistics(void);
+
+/**Function for returning the number of bytes transferred over SPI since start, for measuring the cost of bus operations.
+ * @return uint32_t - Number of bytes.
+ */
+uint32_t SPI_bytes_transferred(void);
+
 /**Function for testing SPI driver.
  * @param char data - Data to send.
  */
 void SPI_test(char data);
 
+/**Test function measuring the throughput at each clock setting, with busy waiting and with an interrupt driven transaction. For the transaction, the share of CPU time left to the main loop is also measured.
+ * Runs without chip select, so no device is addressed.
+ */
+void test_SPI_throughput(void);
+
+/**Test function for printing the bus arbitration counters.
+ */
+void test_SPI_bus_statistics(void);
+
 #endif
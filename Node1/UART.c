@@ -1,41 +1,233 @@
 /** @file UART.c
  *  @brief c-file for the UART driver - to initialize, recieve and transfer data.
+ *  Bytes are sent and received through ring buffers, emptied and filled by the UART interrupts.
  *  @authors: Anastasia Lindbäck and Marie Skatvedt
  */
 
 #include "UART.h"
 
+// Rings between the main loop and the UART interrupts. The indices run freely, the slot is the index modulo the length
+static volatile uint8_t UART_tx_ring[UART_TX_BUFFER_LENGTH];
+static volatile uint8_t UART_tx_head = 0;
+static volatile uint8_t UART_tx_tail = 0;
 
-/** Function for initializing UART.
- *  @param unsigned int ubrr - UBRR register, User Baud Rate Register
+static volatile uint8_t UART_rx_ring[UART_RX_BUFFER_LENGTH];
+static volatile uint8_t UART_rx_head = 0;
+static volatile uint8_t UART_rx_tail = 0;
+
+static volatile UART_tx_mode UART_mode = UART_TX_BLOCK;
+static volatile UART_statistics UART_stats;
+
+// Set when a byte has been sent, so that UART_flush can wait for the transmit complete flag
+static volatile bool UART_tx_started = false;
+
+static bool UART_stream_open = false;
+
+/** Function for moving the next byte of the transmit ring to the UART, or disabling the data register empty interrupt if the ring is empty.
  */
-void UART_init (unsigned int ubrr) {
-    int bd = 0.15*((long)FOSC/((long)(16*ubrr))-1);
+static void UART_tx_next(void) {
+    if (UART_tx_head == UART_tx_tail) {
+        clear_bit(UCSR0B, UDRIE0);
+        return;
+    }
 
-    UBRR0H = (unsigned char) (bd>>8);
-    UBRR0L = (unsigned char) bd;
+    // Transmit complete is cleared by writing a one, the error flags must be written zero
+    UCSR0A = (UCSR0A & (1 << U2X0)) | (1 << TXC0);
+    UART_tx_started = true;
+
+    UDR0 = UART_tx_ring[UART_tx_tail % UART_TX_BUFFER_LENGTH];
+    UART_tx_tail++;
+}
+
+/** Function for moving a received byte to the receive ring. A byte is lost if the ring is full.
+ */
+static void UART_rx_next(void) {
+    // The overrun flag must be read before UDR0
+    bool overrun = test_bit(UCSR0A, DOR0);
+    uint8_t data = UDR0;
 
-    UCSR0B = (1<<RXEN0) | (1<<TXEN0);
+    if (overrun) {
+        UART_stats.rx_overflows++;
+    }
+
+    if ((uint8_t)(UART_rx_head - UART_rx_tail) >= UART_RX_BUFFER_LENGTH) {
+        UART_stats.rx_overflows++;
+        return;
+    }
+
+    UART_rx_ring[UART_rx_head % UART_RX_BUFFER_LENGTH] = data;
+    UART_rx_head++;
+}
+
+/** Function for initializing UART. Bytes still in the transmit ring are sent first.
+ *  The baud rate is set with normal or double speed, whichever comes closest.
+ *  @param uint32_t baud - Baud rate, up to FOSC/8.
+ *  @return uint8_t - 0 on success, 1 if the baud rate is off by more than UART_BAUD_TOLERANCE_PERMILLE.
+ */
+uint8_t UART_init (uint32_t baud) {
+    if (test_bit(UCSR0B, TXEN0)) {
+        UART_flush();
+    }
+
+    // Normal speed samples each bit 16 times and double speed 8 times. Normal speed is kept when both are as close
+    uint16_t ubrr = 0;
+    bool double_speed = false;
+    uint32_t best_error = UINT32_MAX;
+
+    for (uint8_t samples = 16; samples >= 8; samples /= 2) {
+        uint32_t divisor = (FOSC + (samples * baud) / 2) / (samples * baud);
+
+        if (divisor < 1) {
+            divisor = 1;
+        }
+        if (divisor > 4096) {
+            divisor = 4096;
+        }
+
+        uint32_t actual = FOSC / (samples * divisor);
+        uint32_t error = (((actual > baud) ? (actual - baud) : (baud - actual)) * 1000) / baud;
+
+        if (error < best_error) {
+            best_error = error;
+            ubrr = divisor - 1;
+            double_speed = (samples == 8);
+            UART_stats.baud = actual;
+        }
+    }
+
+    UART_stats.baud_error_permille = best_error;
+
+    UBRR0H = (unsigned char) (ubrr>>8);
+    UBRR0L = (unsigned char) ubrr;
+
+    if (double_speed) {
+        set_bit(UCSR0A, U2X0);
+    }
+    else {
+        clear_bit(UCSR0A, U2X0);
+    }
+
+    UCSR0B = (1<<RXEN0) | (1<<TXEN0) | (1<<RXCIE0);
     UCSR0C = (1<<USBS0) | (1<<URSEL0) | (0<<UCSZ10) | (3<<UCSZ00);
 
-    fdevopen(UART_trans, UART_recv);
+    if (!UART_stream_open) {
+        fdevopen(UART_trans, UART_recv);
+        UART_stream_open = true;
+    }
+
+    return (best_error > UART_BAUD_TOLERANCE_PERMILLE) ? 1 : 0;
 }
 
 /** Function for recieving data from UART.
- *  @return UDR0 - Empty Handler, if register RXC0 (RX complete) is not set.
+ *  @return unsigned char - The oldest received byte, 0 if the receive ring is empty.
  */
 unsigned char UART_recv (void) {
-     if(!(UCSR0A & (1<<RXC0))){
+    // With interrupts disabled the receive ring is filled by polling
+    if (!test_bit(SREG, SREG_I) && test_bit(UCSR0A, RXC0)) {
+        UART_rx_next();
+    }
+
+    if (UART_rx_head == UART_rx_tail) {
         return 0;
     }
-    return UDR0;
+
+    uint8_t data = UART_rx_ring[UART_rx_tail % UART_RX_BUFFER_LENGTH];
+    UART_rx_tail++;
+
+    return data;
 }
 
-/** Function for transferring data from UART.
+/** Function for transferring data from UART. The byte is put in the transmit ring, and sent by the UART interrupt.
+ *  When the ring is full it waits for room, or drops the byte in UART_TX_DROP mode.
  *  @param unsigned char letter - Letter to be transferred.
  */
 void UART_trans (unsigned char letter) {
-    while (!(UCSR0A & (1 << UDRE0))){};
+    uint8_t sreg = SREG;
+    cli();
+
+    while ((uint8_t)(UART_tx_head - UART_tx_tail) >= UART_TX_BUFFER_LENGTH) {
+        if (UART_mode == UART_TX_DROP) {
+            UART_stats.tx_dropped++;
+            SREG = sreg;
+            return;
+        }
+
+        // Let the interrupt make room, or make room by polling if the caller has interrupts disabled
+        SREG = sreg;
+        if (!test_bit(SREG, SREG_I) && test_bit(UCSR0A, UDRE0)) {
+            UART_tx_next();
+        }
+        cli();
+    }
+
+    UART_tx_ring[UART_tx_head % UART_TX_BUFFER_LENGTH] = letter;
+    UART_tx_head++;
+
+    uint8_t depth = UART_tx_head - UART_tx_tail;
+    if (depth > UART_stats.tx_high_water) {
+        UART_stats.tx_high_water = depth;
+    }
+
+    set_bit(UCSR0B, UDRIE0);
+    SREG = sreg;
+}
+
+/** Function for choosing what UART_trans does when the transmit ring is full.
+ *  @param UART_tx_mode mode - UART_TX_BLOCK or UART_TX_DROP.
+ *  @return UART_tx_mode - The previous mode, to be restored after the timing critical code.
+ */
+UART_tx_mode UART_set_tx_mode (UART_tx_mode mode) {
+    UART_tx_mode previous = UART_mode;
+    UART_mode = mode;
+
+    return previous;
+}
+
+/** Function for waiting until every byte in the transmit ring is sent.
+ */
+void UART_flush (void) {
+    while (UART_tx_head != UART_tx_tail) {
+        if (!test_bit(SREG, SREG_I) && test_bit(UCSR0A, UDRE0)) {
+            UART_tx_next();
+        }
+    }
+
+    // Wait for the last byte to leave the shift register
+    if (UART_tx_started) {
+        loop_until_bit_is_set(UCSR0A, TXC0);
+    }
+}
+
+/** Function for returning the baud rate and the counters of the rings.
+ *  @return UART_statistics - Actual baud rate and error, dropped and lost bytes, and the largest transmit ring depth.
+ */
+UART_statistics UART_read_statistics (void) {
+    uint8_t sreg = SREG;
+    cli();
+    UART_statistics statistics = UART_stats;
+    SREG = sreg;
+
+    return statistics;
+}
 
-    UDR0 = letter;
+/** Test function for printing the baud rate and the counters of the rings.
+ */
+void test_UART_statistics (void) {
+    UART_statistics statistics = UART_read_statistics();
+
+    printf("Baud rate: %lu, error %u.%u %%\n\r", statistics.baud, statistics.baud_error_permille / 10, statistics.baud_error_permille % 10);
+    printf("Transmit: high water mark %u of %u, dropped %u\n\r", statistics.tx_high_water, UART_TX_BUFFER_LENGTH, statistics.tx_dropped);
+    printf("Receive: lost %u\n\r", statistics.rx_overflows);
+}
+
+/** Interrupt service routine executed when the UART data register is empty, sending the next byte of the transmit ring.
+ */
+ISR(USART0_UDRE_vect) {
+    UART_tx_next();
+}
+
+/** Interrupt service routine executed when a byte is received, moving it to the receive ring.
+ */
+ISR(USART0_RXC_vect) {
+    UART_rx_next();
 }
@@ -1,30 +1,86 @@
 /** @file UART.h
  *  @brief Header-file for the UART driver - to initialize, recieve and transfer data.
+ *  Bytes are sent and received through ring buffers, emptied and filled by the UART interrupts.
  *  @author: Anastasia Lindbäck and Marie Skatvedt
  */
 #ifndef UART_H
 #define UART_H
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <avr/io.h>
 #include <avr/interrupt.h>
 #include <stdio.h>
 
-#define FOSC 4915200 
+#include "bit_operations.h"
 
-/** Function for initializing UART.
- *  @param unsigned int ubrr - UBRR register, User Baud Rate Register
+#define FOSC 4915200
+
+// Bytes the transmit and receive rings hold, powers of two
+#define UART_TX_BUFFER_LENGTH 128
+#define UART_RX_BUFFER_LENGTH 16
+
+// Largest difference between the requested and the actual baud rate accepted by UART_init, in permille
+#define UART_BAUD_TOLERANCE_PERMILLE 20
+
+/** Enum UART_tx_mode representing what UART_trans does when the transmit ring is full.
+ */
+typedef enum {
+    // Wait for room in the ring
+    UART_TX_BLOCK,
+    // Drop the byte and count it, for timing critical code
+    UART_TX_DROP
+} UART_tx_mode;
+
+/** Struct UART_statistics representing the baud rate and the counters of the rings.
+ */
+typedef struct {
+    uint32_t baud;
+    uint16_t baud_error_permille;
+
+    // Bytes dropped in UART_TX_DROP mode, and received bytes lost because the receive ring was full or the hardware overran
+    uint16_t tx_dropped;
+    uint16_t rx_overflows;
+
+    // Largest number of bytes waiting in the transmit ring
+    uint8_t tx_high_water;
+} UART_statistics;
+
+/** Function for initializing UART. Bytes still in the transmit ring are sent first.
+ *  The baud rate is set with normal or double speed, whichever comes closest.
+ *  @param uint32_t baud - Baud rate, up to FOSC/8.
+ *  @return uint8_t - 0 on success, 1 if the baud rate is off by more than UART_BAUD_TOLERANCE_PERMILLE.
  */
-void UART_init (unsigned int ubrr);
+uint8_t UART_init (uint32_t baud);
 
 /** Function for recieving data from UART.
- *  @return UDR0 - Empty Handler, if register RXC0 (RX complete) is not set.
+ *  @return unsigned char - The oldest received byte, 0 if the receive ring is empty.
  */
 unsigned char UART_recv (void);
 
-/** Function for transferring data from UART.
+/** Function for transferring data from UART. The byte is put in the transmit ring, and sent by the UART interrupt.
+ *  When the ring is full it waits for room, or drops the byte in UART_TX_DROP mode.
  *  @param unsigned char letter - Letter to be transferred.
  */
 void UART_trans (unsigned char letter);
 
+/** Function for choosing what UART_trans does when the transmit ring is full.
+ *  @param UART_tx_mode mode - UART_TX_BLOCK or UART_TX_DROP.
+ *  @return UART_tx_mode - The previous mode, to be restored after the timing critical code.
+ */
+UART_tx_mode UART_set_tx_mode (UART_tx_mode mode);
+
+/** Function for waiting until every byte in the transmit ring is sent.
+ */
+void UART_flush (void);
+
+/** Function for returning the baud rate and the counters of the rings.
+ *  @return UART_statistics - Actual baud rate and error, dropped and lost bytes, and the largest transmit ring depth.
+ */
+UART_statistics UART_read_statistics (void);
+
+/** Test function for printing the baud rate and the counters of the rings.
+ */
+void test_UART_statistics (void);
+
 #endif
@@ -6,8 +6,10 @@
 #ifndef ADDRESSES_H
 #define ADDRESSES_H
 
-// ADC
+// ADC. The host test in tests/ gives its own address on the command line
+#ifndef adc_addr
 #define adc_addr ((volatile char*) 0x1400)
+#endif
 
 
 //OLED
@@ -31,4 +33,11 @@
 // SRAM
 #define sram_addr ((volatile char*) 0x1800)
 
+// OLED framebuffer, 8 pages of 128 columns in the lower half of the SRAM
+#define oled_framebuffer_addr ((volatile uint8_t*) 0x1800)
+
+// Joystick lookup tables, two tables of JOYSTICK_TABLE_SIZE bytes in the upper half of the SRAM
+#define joystick_table_addr ((volatile int8_t*) 0x1c00)
+#define JOYSTICK_TABLE_SIZE 256
+
 #endif
@@ -0,0 +1,75 @@
+/** @file animation.c
+ *  @brief C-file for time based OLED animations. An animation is a sequence of frames drawn into the OLED framebuffer, advanced by animation_update from the main loop without blocking.
+ *  @authors: Anastasia Lindbäck and Marie Skatvedt
+ */
+
+#include "animation.h"
+
+// Running animation, NULL when stopped
+static const animation* animation_current = NULL;
+
+static uint8_t animation_frame = 0;
+static uint8_t animation_repeat = 0;
+static uint16_t animation_frame_start = 0;
+
+/** Function for drawing the current frame and handing it to the OLED flush engine.
+ */
+static void animation_draw(void) {
+    animation_current->draw(animation_frame);
+    OLED_update();
+
+    animation_frame_start = timer_ms();
+}
+
+/** Function for starting an animation, drawing its first frame. A running animation is replaced.
+ *  @param const animation* a - The animation, must stay valid while it is running.
+ */
+void animation_start(const animation* a) {
+    animation_current = a;
+    animation_frame = 0;
+    animation_repeat = 0;
+
+    animation_draw();
+}
+
+/** Function for advancing the running animation when the time of the current frame has passed. Does not block.
+ *  @return bool - true if the animation is still running.
+ */
+bool animation_update(void) {
+    if (animation_current == NULL) {
+        return false;
+    }
+
+    if (timer_elapsed_ms(animation_frame_start) < animation_current->durations[animation_frame]) {
+        return true;
+    }
+
+    animation_frame++;
+
+    if (animation_frame >= animation_current->frames) {
+        animation_frame = 0;
+        animation_repeat++;
+
+        if (animation_repeat >= animation_current->repeats) {
+            animation_current = NULL;
+            return false;
+        }
+    }
+
+    animation_draw();
+
+    return true;
+}
+
+/** Function for stopping the running animation. The last drawn frame stays on the display.
+ */
+void animation_stop(void) {
+    animation_current = NULL;
+}
+
+/** Function for checking whether an animation is running.
+ *  @return bool - true if an animation is running.
+ */
+bool animation_running(void) {
+    return animation_current != NULL;
+}
@@ -0,0 +1,50 @@
+/** @file animation.h
+ *  @brief Header-file for time based OLED animations. An animation is a sequence of frames drawn into the OLED framebuffer, advanced by animation_update from the main loop without blocking.
+ *  @authors: Anastasia Lindbäck and Marie Skatvedt
+ */
+
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "OLED.h"
+#include "timer.h"
+
+/** Struct animation describing the frames of an animation.
+ */
+typedef struct {
+    // Draws a frame (0 - frames-1) into the OLED framebuffer
+    void (*draw)(uint8_t frame);
+
+    // Number of frames in one cycle
+    uint8_t frames;
+
+    // Time each frame is shown, in milliseconds
+    const uint16_t* durations;
+
+    // Number of times the cycle is played
+    uint8_t repeats;
+} animation;
+
+/** Function for starting an animation, drawing its first frame. A running animation is replaced.
+ *  @param const animation* a - The animation, must stay valid while it is running.
+ */
+void animation_start(const animation* a);
+
+/** Function for advancing the running animation when the time of the current frame has passed. Does not block.
+ *  @return bool - true if the animation is still running.
+ */
+bool animation_update(void);
+
+/** Function for stopping the running animation. The last drawn frame stays on the display.
+ */
+void animation_stop(void);
+
+/** Function for checking whether an animation is running.
+ *  @return bool - true if an animation is running.
+ */
+bool animation_running(void);
+
+#endif
@@ -0,0 +1,113 @@
+/** @file buttons.c
+ *  @brief C-file for the buttons on the USB multiboard. PB0-PB2 are sampled every millisecond from the system tick, debounced, and press and release events are queued for each button.
+ *  @authors: Anastasia Lindbäck and Marie Skatvedt
+ */
+
+#include "buttons.h"
+
+// Pins that are low when pressed, the joystick button
+#define ACTIVE_LOW_MASK (1 << JOYSTICK_BUTTON)
+
+// Debounced state of each button, bit set when pressed
+static volatile uint8_t buttons_state = 0;
+
+// Consecutive samples that differ from the debounced state
+static uint8_t buttons_count[NUM_BUTTONS];
+
+// Event queue of each button, written by the ISR and read by the main loop
+static volatile button_event buttons_queue[NUM_BUTTONS][BUTTONS_QUEUE_SIZE];
+static volatile uint8_t buttons_head[NUM_BUTTONS];
+static volatile uint8_t buttons_tail[NUM_BUTTONS];
+
+static volatile uint16_t buttons_dropped = 0;
+
+/** Function for initializing the buttons as inputs and clearing the event queues.
+ */
+void buttons_init(void) {
+    clear_bit(DDRB, PB0);
+    clear_bit(DDRB, PB1);
+    clear_bit(DDRB, PB2);
+
+    // Start from the current state, so that a button held at boot does not give a press event
+    buttons_state = (PINB ^ ACTIVE_LOW_MASK) & ((1 << NUM_BUTTONS) - 1);
+
+    for (uint8_t b = 0; b < NUM_BUTTONS; b++) {
+        buttons_count[b] = 0;
+        buttons_head[b] = 0;
+        buttons_tail[b] = 0;
+    }
+}
+
+/** Function for sampling and debouncing all buttons, queueing an event for each accepted change. Called from the system tick every millisecond.
+ *  @param uint16_t time - Current time in milliseconds, stored in the events.
+ */
+void buttons_sample(uint16_t time) {
+    uint8_t pressed = PINB ^ ACTIVE_LOW_MASK;
+
+    for (uint8_t b = 0; b < NUM_BUTTONS; b++) {
+        uint8_t mask = (1 << b);
+
+        if ((pressed & mask) == (buttons_state & mask)) {
+            buttons_count[b] = 0;
+            continue;
+        }
+
+        if (++buttons_count[b] < BUTTONS_DEBOUNCE_MS) {
+            continue;
+        }
+
+        // New state accepted
+        buttons_count[b] = 0;
+        buttons_state ^= mask;
+
+        uint8_t next = (buttons_head[b] + 1) & (BUTTONS_QUEUE_SIZE - 1);
+        if (next == buttons_tail[b]) {
+            buttons_dropped++;
+            continue;
+        }
+
+        buttons_queue[b][buttons_head[b]].pressed = (buttons_state & mask) != 0;
+        buttons_queue[b][buttons_head[b]].time = time;
+        buttons_head[b] = next;
+    }
+}
+
+/** Function for taking the oldest event of a button from its queue, without blocking.
+ *  @param button b - The button.
+ *  @param button_event* event - The event is written here if there is one.
+ *  @return bool - true if an event was taken, false if the queue was empty.
+ */
+bool buttons_get_event(button b, button_event* event) {
+    uint8_t tail = buttons_tail[b];
+
+    if (tail == buttons_head[b]) {
+        return false;
+    }
+
+    event->pressed = buttons_queue[b][tail].pressed;
+    event->time = buttons_queue[b][tail].time;
+
+    buttons_tail[b] = (tail + 1) & (BUTTONS_QUEUE_SIZE - 1);
+
+    return true;
+}
+
+/** Function for returning the debounced state of a button.
+ *  @param button b - The button.
+ *  @return bool - true if the button is pressed.
+ */
+bool buttons_is_pressed(button b) {
+    return (buttons_state & (1 << b)) != 0;
+}
+
+/** Function for returning the number of events lost because a queue was full.
+ *  @return uint16_t - Number of lost events.
+ */
+uint16_t buttons_dropped_events(void) {
+    uint8_t sreg = SREG;
+    cli();
+    uint16_t dropped = buttons_dropped;
+    SREG = sreg;
+
+    return dropped;
+}
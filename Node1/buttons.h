@@ -0,0 +1,60 @@
+/** @file buttons.h
+ *  @brief Header-file for the buttons on the USB multiboard. PB0-PB2 are sampled every millisecond from the system tick, debounced, and press and release events are queued for each button.
+ *  @authors: Anastasia Lindbäck and Marie Skatvedt
+ */
+
+#ifndef BUTTONS_H
+#define BUTTONS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "bit_operations.h"
+
+// Number of consecutive equal samples (ms) before a new button state is accepted
+#define BUTTONS_DEBOUNCE_MS 5
+
+// Events queued per button, must be a power of two
+#define BUTTONS_QUEUE_SIZE 4
+
+/** Enum button representing the buttons, with the value of their pin on PORTB.
+ */
+typedef enum {TOUCH_BUTTON_0 = PINB0, TOUCH_BUTTON_1 = PINB1, JOYSTICK_BUTTON = PINB2, NUM_BUTTONS} button;
+
+/** Struct button_event representing a debounced press or release of a button.
+ */
+typedef struct {
+    bool pressed;
+    uint16_t time;
+} button_event;
+
+/** Function for initializing the buttons as inputs and clearing the event queues.
+ */
+void buttons_init(void);
+
+/** Function for sampling and debouncing all buttons, queueing an event for each accepted change. Called from the system tick every millisecond.
+ *  @param uint16_t time - Current time in milliseconds, stored in the events.
+ */
+void buttons_sample(uint16_t time);
+
+/** Function for taking the oldest event of a button from its queue, without blocking.
+ *  @param button b - The button.
+ *  @param button_event* event - The event is written here if there is one.
+ *  @return bool - true if an event was taken, false if the queue was empty.
+ */
+bool buttons_get_event(button b, button_event* event);
+
+/** Function for returning the debounced state of a button.
+ *  @param button b - The button.
+ *  @return bool - true if the button is pressed.
+ */
+bool buttons_is_pressed(button b);
+
+/** Function for returning the number of events lost because a queue was full.
+ *  @return uint16_t - Number of lost events.
+ */
+uint16_t buttons_dropped_events(void);
+
+#endif
@@ -0,0 +1,169 @@
+/** @file filter.c
+ *  @brief C-file for the fixed-point input filters used on the ADC channels. Each filter is an optional 3-tap median, followed by oversampling with decimation and a first-order IIR.
+ *  @authors: Anastasia Lindbäck and Marie Skatvedt
+ */
+
+#include "filter.h"
+
+// Test signal levels and amount of samples used by the test function
+#define TEST_STEP_LOW 64
+#define TEST_STEP_HIGH 192
+#define TEST_NOISE_LEVEL 128
+#define TEST_NOISE_AMPLITUDE 16
+#define TEST_SETTLE_SAMPLES 512
+#define TEST_MAX_DELAY 2048
+#define TEST_NOISE_OUTPUTS 64
+
+/** Function returning the median of three samples.
+ *  @return uint8_t - The median of a, b and c.
+ */
+static uint8_t filter_median(uint8_t a, uint8_t b, uint8_t c) {
+    if (a > b) {
+        uint8_t temp = a;
+        a = b;
+        b = temp;
+    }
+    if (b > c) {
+        b = c;
+    }
+    return (a > b) ? a : b;
+}
+
+/** Function for initializing a filter with the given settings, clearing its state.
+ *  @param filter* f - The filter to initialize.
+ *  @param filter_settings settings - Settings of the filter. Shifts are limited to their maximum values.
+ */
+void filter_init(filter* f, filter_settings settings) {
+    if (settings.oversampling_shift > FILTER_MAX_OVERSAMPLING_SHIFT) {
+        settings.oversampling_shift = FILTER_MAX_OVERSAMPLING_SHIFT;
+    }
+    if (settings.iir_shift > FILTER_MAX_IIR_SHIFT) {
+        settings.iir_shift = FILTER_MAX_IIR_SHIFT;
+    }
+
+    f->settings = settings;
+    f->sum = 0;
+    f->count = 0;
+    f->state = 0;
+    f->primed = false;
+    f->output = 0;
+}
+
+/** Function for feeding one sample to a filter.
+ *  @param filter* f - The filter.
+ *  @param uint8_t sample - Raw sample (0-255).
+ *  @return bool - true if a new output was produced (every 2^oversampling_shift samples), false otherwise.
+ */
+bool filter_sample(filter* f, uint8_t sample) {
+    // Fill the history with the first sample, so that the filter starts at the input level instead of zero
+    if (!f->primed) {
+        f->history[0] = sample;
+        f->history[1] = sample;
+        f->history[2] = sample;
+        f->state = (uint16_t)sample << FILTER_FRACTION_BITS;
+        f->primed = true;
+    }
+
+    // Median
+    if (f->settings.median) {
+        f->history[2] = f->history[1];
+        f->history[1] = f->history[0];
+        f->history[0] = sample;
+        sample = filter_median(f->history[0], f->history[1], f->history[2]);
+    }
+
+    // Oversampling with decimation
+    f->sum += sample;
+    f->count++;
+
+    if (f->count < ((uint16_t)1 << f->settings.oversampling_shift)) {
+        return false;
+    }
+
+    uint16_t input = (f->sum >> f->settings.oversampling_shift) << FILTER_FRACTION_BITS;
+    f->sum = 0;
+    f->count = 0;
+
+    // First-order IIR, state += alpha * (input - state)
+    if (input > f->state) {
+        f->state += (input - f->state) >> f->settings.iir_shift;
+    }
+    else {
+        f->state -= (f->state - input) >> f->settings.iir_shift;
+    }
+
+    // Round to nearest
+    uint16_t rounded = f->state + (1 << (FILTER_FRACTION_BITS - 1));
+    f->output = (f->state >= ((uint16_t)255U << FILTER_FRACTION_BITS)) ? 255 : (rounded >> FILTER_FRACTION_BITS);
+
+    return true;
+}
+
+/** Function for returning the most recent output of a filter.
+ *  @param filter* f - The filter.
+ *  @return uint8_t output - Filtered value (0-255).
+ */
+uint8_t filter_output(filter* f) {
+    return f->output;
+}
+
+/** Test function reporting the group delay and noise reduction of a set of filter settings.
+ *  The group delay is the number of input samples before the output passes 50 % of a step, the noise reduction is the output noise variance in percent of the input noise variance.
+ */
+void test_filter_settings(void) {
+    const filter_settings settings[] = {
+        {0, 0, false},
+        {0, 0, true},
+        {2, 0, false},
+        {0, 2, false},
+        {2, 2, false},
+        {2, 2, true},
+        {3, 3, true},
+    };
+
+    filter f;
+
+    for (uint8_t i = 0; i < sizeof(settings)/sizeof(settings[0]); i++) {
+        // Step response
+        filter_init(&f, settings[i]);
+        for (uint16_t n = 0; n < TEST_SETTLE_SAMPLES; n++) {
+            filter_sample(&f, TEST_STEP_LOW);
+        }
+
+        uint16_t delay = 0;
+        while ((filter_output(&f) < (TEST_STEP_LOW + TEST_STEP_HIGH)/2) && (delay < TEST_MAX_DELAY)) {
+            filter_sample(&f, TEST_STEP_HIGH);
+            delay++;
+        }
+
+        // Noise response
+        filter_init(&f, settings[i]);
+        for (uint16_t n = 0; n < TEST_SETTLE_SAMPLES; n++) {
+            filter_sample(&f, TEST_NOISE_LEVEL + (rand() % (2*TEST_NOISE_AMPLITUDE + 1)) - TEST_NOISE_AMPLITUDE);
+        }
+
+        uint32_t input_variance = 0;
+        uint32_t output_variance = 0;
+        uint16_t inputs = 0;
+        uint16_t outputs = 0;
+
+        while (outputs < TEST_NOISE_OUTPUTS) {
+            int16_t noise = (rand() % (2*TEST_NOISE_AMPLITUDE + 1)) - TEST_NOISE_AMPLITUDE;
+            input_variance += noise * noise;
+            inputs++;
+
+            if (filter_sample(&f, TEST_NOISE_LEVEL + noise)) {
+                int16_t error = filter_output(&f) - TEST_NOISE_LEVEL;
+                output_variance += error * error;
+                outputs++;
+            }
+        }
+
+        input_variance /= inputs;
+        output_variance /= outputs;
+
+        printf("Oversampling: %u, IIR: %u, Median: %u\n\r", settings[i].oversampling_shift, settings[i].iir_shift, settings[i].median);
+        printf("    Group delay: %u samples\n\r", delay);
+        printf("    Noise variance: %u %%\n\r", (unsigned int)((output_variance * 100) / input_variance));
+    }
+}
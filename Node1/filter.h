@@ -0,0 +1,76 @@
+/** @file filter.h
+ *  @brief Header-file for the fixed-point input filters used on the ADC channels. Each filter is an optional 3-tap median, followed by oversampling with decimation and a first-order IIR.
+ *  @authors: Anastasia Lindbäck and Marie Skatvedt
+ */
+
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Largest oversampling shift, 2^8 samples of 255 still fit in the 16 bit sum
+#define FILTER_MAX_OVERSAMPLING_SHIFT 8
+
+// Largest IIR shift, alpha = 1/256
+#define FILTER_MAX_IIR_SHIFT 8
+
+// Fractional bits of the IIR state
+#define FILTER_FRACTION_BITS 8
+
+/** Struct filter_settings representing the configuration of one filter.
+ */
+typedef struct {
+    // 2^oversampling_shift samples are averaged into one output, 0 disables oversampling
+    uint8_t oversampling_shift;
+
+    // IIR coefficient alpha = 1/2^iir_shift, 0 disables the IIR
+    uint8_t iir_shift;
+
+    // Median of the last three samples before oversampling
+    bool median;
+} filter_settings;
+
+/** Struct filter representing the settings and state of one filter.
+ */
+typedef struct {
+    filter_settings settings;
+
+    uint8_t history[3];
+    uint16_t sum;
+    uint16_t count;
+
+    // IIR state with FILTER_FRACTION_BITS fractional bits
+    uint16_t state;
+    bool primed;
+
+    uint8_t output;
+} filter;
+
+/** Function for initializing a filter with the given settings, clearing its state.
+ *  @param filter* f - The filter to initialize.
+ *  @param filter_settings settings - Settings of the filter. Shifts are limited to their maximum values.
+ */
+void filter_init(filter* f, filter_settings settings);
+
+/** Function for feeding one sample to a filter.
+ *  @param filter* f - The filter.
+ *  @param uint8_t sample - Raw sample (0-255).
+ *  @return bool - true if a new output was produced (every 2^oversampling_shift samples), false otherwise.
+ */
+bool filter_sample(filter* f, uint8_t sample);
+
+/** Function for returning the most recent output of a filter.
+ *  @param filter* f - The filter.
+ *  @return uint8_t output - Filtered value (0-255).
+ */
+uint8_t filter_output(filter* f);
+
+/** Test function reporting the group delay and noise reduction of a set of filter settings.
+ *  The group delay is the number of input samples before the output passes 50 % of a step, the noise reduction is the output noise variance in percent of the input noise variance.
+ */
+void test_filter_settings(void);
+
+#endif
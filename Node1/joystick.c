@@ -16,37 +16,314 @@
 #define RESOLUTION_START 0
 #define RESOLUTION_END 255
 
-// Origo of joystick area is approximately at (128, 128) with a resolution scale 0-255, can be calibrated using calibrate function
-int resolution_left = 128;
-int resolution_right = 128;
+// Lookup tables in external SRAM mapping raw 0-255 samples to -100-100, one per axis. Built by the calibrate function
+#define X_AXIS_TABLE (joystick_table_addr)
+#define Y_AXIS_TABLE (joystick_table_addr + JOYSTICK_TABLE_SIZE)
 
 
-/** Function for detecting if joystick button is pressed.
- *  @return int joystick_button - Returns 0 if joystick button is pressed, 1 otherwise.
+// Calibration stored in EEPROM, loaded at boot
+static joystick_calibration EEMEM joystick_calibration_eeprom;
+
+// Calibration being recorded, its state, and when the state was entered
+static joystick_calibration joystick_new_calibration;
+static joystick_calibration_step joystick_calibration_state = JOYSTICK_CALIBRATION_IDLE;
+static uint16_t joystick_calibration_time = 0;
+
+
+/** Function for filling the lookup table of one axis, mapping min-max to -100-100 around the neutral position.
+ *  Samples within the deadzone around the centre map to 0, and samples outside min-max are clamped.
+ *  @param volatile int8_t* table - Lookup table with JOYSTICK_TABLE_SIZE entries.
+ *  @param joystick_axis_calibration axis - Raw samples (0-255) at min, neutral and max position.
+ *  @param uint8_t deadzone - Raw distance from the centre that maps to 0.
+ */
+static void joystick_build_table(volatile int8_t* table, joystick_axis_calibration axis, uint8_t deadzone) {
+    int low = axis.centre - deadzone;
+    int high = axis.centre + deadzone;
+
+    for (int raw = RESOLUTION_START; raw <= RESOLUTION_END; raw++) {
+        if (raw <= axis.min) {
+            table[raw] = -100;
+        }
+        else if (raw >= axis.max) {
+            table[raw] = 100;
+        }
+        else if (raw < low) {
+            table[raw] = -(((low - raw) * 100) / (low - axis.min));
+        }
+        else if (raw > high) {
+            table[raw] = ((raw - high) * 100) / (axis.max - high);
+        }
+        else {
+            table[raw] = 0;
+        }
+    }
+}
+
+/** Function for calculating the checksum of a calibration, complement of the sum of all bytes before the checksum.
+ *  @param joystick_calibration* calibration - The calibration.
+ *  @return uint8_t - The checksum.
+ */
+static uint8_t joystick_calibration_checksum(joystick_calibration* calibration) {
+    uint8_t* bytes = (uint8_t*) calibration;
+    uint8_t sum = 0;
+
+    for (uint8_t i = 0; i < offsetof(joystick_calibration, checksum); i++) {
+        sum += bytes[i];
+    }
+
+    return ~sum;
+}
+
+/** Function for making sure an axis has room for the deadzone and a usable range on both sides of the centre.
+ *  An axis that was not moved all the way during calibration falls back to the full 0-255 range.
+ *  @param joystick_axis_calibration* axis - The axis to check.
+ *  @param uint8_t deadzone - Raw distance from the centre that maps to 0.
+ */
+static void joystick_limit_axis(joystick_axis_calibration* axis, uint8_t deadzone) {
+    if (axis->centre < deadzone + JOYSTICK_MIN_SPAN || axis->centre > RESOLUTION_END - deadzone - JOYSTICK_MIN_SPAN) {
+        axis->centre = RESOLUTION_END / 2;
+    }
+    if (axis->min > axis->centre - deadzone - JOYSTICK_MIN_SPAN) {
+        axis->min = RESOLUTION_START;
+    }
+    if (axis->max < axis->centre + deadzone + JOYSTICK_MIN_SPAN) {
+        axis->max = RESOLUTION_END;
+    }
+}
+
+/** Function for building the lookup tables of both axes from a calibration.
+ *  @param joystick_calibration* calibration - The calibration.
+ */
+static void joystick_apply_calibration(joystick_calibration* calibration) {
+    joystick_build_table(X_AXIS_TABLE, calibration->x, calibration->deadzone);
+    joystick_build_table(Y_AXIS_TABLE, calibration->y, calibration->deadzone);
+}
+
+
+/** Function for reading one ADC channel the way joystick_position did before the background scan and lookup tables, for test_joystick_mapping_cycles.
+ *  Blocks for the conversion time. The background scan must be stopped.
+ *  @param int channel - ADC channel.
+ *  @return uint8_t - Sample of the channel (0-255).
+ */
+static uint8_t joystick_baseline_read(int channel) {
+    // Write to the channel wanted on the ADC
+    volatile char *address = adc_addr;
+    address[0] = channel;
+
+    // Delaying time t_c, waiting for writetoggle to be registered
+    _delay_us(500);
+
+    return address[0];
+}
+
+/** Function for mapping the joystick to -100-100 the way joystick_position did before the lookup tables: six blocking ADC reads and a division per axis, with the neutral position at 128 on both axes.
+ *  Kept unchanged for test_joystick_mapping_cycles. The background scan must be stopped.
+ *  @return joystick position - Struct containing x-and-y-positions of joysticks represented as percentage of displacement -100-100.
+ */
+static joystick joystick_position_baseline(void) {
+    int resolution_left = 128;
+    int resolution_right = 128;
+    joystick position;
+
+    // Converting from 0-255 resolution to -100-100 resolution in x-axis
+    if ((joystick_baseline_read(X_AXIS_CHANNEL) >= (resolution_left)) && (joystick_baseline_read(X_AXIS_CHANNEL) <= (resolution_left))) {
+        position.x = 0;
+    }
+    else if (joystick_baseline_read(X_AXIS_CHANNEL) < resolution_left) {
+        position.x = -(((resolution_left-joystick_baseline_read(X_AXIS_CHANNEL))*100)/resolution_left);
+    }
+    else {
+        position.x = (((joystick_baseline_read(X_AXIS_CHANNEL)-resolution_left)*100)/resolution_right);
+    }
+
+    // Converting from 0-255 resolution to -100-100 resolution in y-axis
+    if ((joystick_baseline_read(Y_AXIS_CHANNEL) >= (resolution_left)) && (joystick_baseline_read(Y_AXIS_CHANNEL) <= (resolution_left))) {
+        position.y = 0;
+    }
+
+    else if (joystick_baseline_read(Y_AXIS_CHANNEL) < resolution_left) {
+        position.y = -(((resolution_left-joystick_baseline_read(Y_AXIS_CHANNEL))*100)/resolution_left);
+    }
+
+    else {
+        position.y = (((joystick_baseline_read(Y_AXIS_CHANNEL)-resolution_left)*100)/resolution_right);
+    }
+
+    return position;
+}
+
+
+/** Function for detecting if joystick button has been pressed since the last call. Does not block.
+ *  @return int joystick_button - Returns 0 if joystick button has been pressed, 1 otherwise.
  */
 int joystick_button_not_pressed(void) {
-    int joystick_button = (PINB & (1 << PINB2));
-    _delay_ms(100);
+    int joystick_button = 1;
+    button_event event;
+
+    while (buttons_get_event(JOYSTICK_BUTTON, &event)) {
+        if (event.pressed) {
+            joystick_button = 0;
+        }
+    }
     return joystick_button;
 }
 
-/** Function for detecting if touch button is pressed.
+/** Function for detecting if touch button is pressed, or has been pressed since the last call, so that short presses are not missed.
  * @return bool - Returns 1 if touch button is pressed, 0 otherwise.
  */
 bool touch_button_pressed() {
-    return ((PINB & (1 << PINB0)) || (PINB & (1 << PINB1)));
+    bool pressed = buttons_is_pressed(TOUCH_BUTTON_0) || buttons_is_pressed(TOUCH_BUTTON_1);
+    button_event event;
+
+    while (buttons_get_event(TOUCH_BUTTON_0, &event)) {
+        pressed |= event.pressed;
+    }
+    while (buttons_get_event(TOUCH_BUTTON_1, &event)) {
+        pressed |= event.pressed;
+    }
+    return pressed;
+}
+
+/** Function for recording the joystick position in a calibration being swept, widening the range of each axis.
+ *  @param uint8_t x - Raw x-axis sample (0-255).
+ *  @param uint8_t y - Raw y-axis sample (0-255).
+ */
+static void joystick_calibration_sample(uint8_t x, uint8_t y) {
+    if (x < joystick_new_calibration.x.min) {
+        joystick_new_calibration.x.min = x;
+    }
+    if (x > joystick_new_calibration.x.max) {
+        joystick_new_calibration.x.max = x;
+    }
+    if (y < joystick_new_calibration.y.min) {
+        joystick_new_calibration.y.min = y;
+    }
+    if (y > joystick_new_calibration.y.max) {
+        joystick_new_calibration.y.max = y;
+    }
+}
+
+/** Function for finishing a calibration. The calibration is stored in EEPROM, and the lookup tables of both axes are built.
+ */
+static void joystick_calibration_finish(void) {
+    joystick_calibration* calibration = &joystick_new_calibration;
+
+    joystick_limit_axis(&calibration->x, calibration->deadzone);
+    joystick_limit_axis(&calibration->y, calibration->deadzone);
+
+    calibration->magic = JOYSTICK_CALIBRATION_MAGIC;
+    calibration->checksum = joystick_calibration_checksum(calibration);
+
+    eeprom_update_block(calibration, &joystick_calibration_eeprom, sizeof(joystick_calibration));
+
+    joystick_apply_calibration(calibration);
+
+    printf("Joystick calibrated. X: %u %u %u, Y: %u %u %u\n\r",
+        calibration->x.min, calibration->x.centre, calibration->x.max,
+        calibration->y.min, calibration->y.centre, calibration->y.max);
+}
+
+/** Function for starting a calibration of the joystick. The neutral position is sampled after JOYSTICK_SETTLE_MS, then min and max of both axes are recorded
+ *  while the joystick is moved around its full range for JOYSTICK_SWEEP_MS. Does not block, the calibration is advanced by joystick_calibration_update.
+ *  The old lookup tables are used until the calibration is finished.
+ */
+void joystick_calibration_start(void) {
+    joystick_calibration_state = JOYSTICK_CALIBRATION_SETTLE;
+    joystick_calibration_time = timer_ms();
+}
+
+/** Function for advancing a running calibration with the latest ADC snapshot. Does not block.
+ *  When the calibration is finished it is stored in EEPROM, and the lookup tables of both axes are built.
+ *  Called every few milliseconds while the calibration is running, so that the extremes of the sweep are not missed.
+ *  @return bool - true if the calibration is still running.
+ */
+bool joystick_calibration_update(void) {
+    if (joystick_calibration_state == JOYSTICK_CALIBRATION_IDLE) {
+        return false;
+    }
+
+    ADC_snapshot snapshot = ADC_read_snapshot();
+    uint8_t x = snapshot.channel[X_AXIS_CHANNEL - ADC_FIRST_CHANNEL];
+    uint8_t y = snapshot.channel[Y_AXIS_CHANNEL - ADC_FIRST_CHANNEL];
+
+    if (joystick_calibration_state == JOYSTICK_CALIBRATION_SETTLE) {
+        // Let the multiboard settle before the neutral position is taken
+        if (timer_elapsed_ms(joystick_calibration_time) < JOYSTICK_SETTLE_MS) {
+            return true;
+        }
+
+        joystick_new_calibration.x.min = x;
+        joystick_new_calibration.x.centre = x;
+        joystick_new_calibration.x.max = x;
+        joystick_new_calibration.y.min = y;
+        joystick_new_calibration.y.centre = y;
+        joystick_new_calibration.y.max = y;
+        joystick_new_calibration.deadzone = JOYSTICK_DEADZONE;
+
+        printf("Move joystick around its full range\n\r");
+
+        joystick_calibration_state = JOYSTICK_CALIBRATION_SWEEP;
+        joystick_calibration_time = timer_ms();
+        return true;
+    }
+
+    // Record the extremes of both axes
+    joystick_calibration_sample(x, y);
+
+    if (timer_elapsed_ms(joystick_calibration_time) < JOYSTICK_SWEEP_MS) {
+        return true;
+    }
+
+    joystick_calibration_finish();
+    joystick_calibration_state = JOYSTICK_CALIBRATION_IDLE;
+
+    return false;
 }
 
-/** Function for calibrating the joystick neutral position (neutral = origo).
+/** Function for checking whether a calibration is running.
+ *  @return bool - true if a calibration is running.
+ */
+bool joystick_calibration_running(void) {
+    return joystick_calibration_state != JOYSTICK_CALIBRATION_IDLE;
+}
+
+/** Function for calibrating the joystick, blocking until the calibration is finished. Only for use before the scheduler is started.
  */
 void joystick_calibrate(void) {
-    joystick position;
+    joystick_calibration_start();
 
-    position.x = selected_channel_output(X_AXIS_CHANNEL);
-    position.y = selected_channel_output(Y_AXIS_CHANNEL);
+    // Advance the calibration once for every new scan
+    while (joystick_calibration_update()) {
+        ADC_wait_for_scan();
+    }
+}
+
+/** Function for loading the calibration stored in EEPROM, and building the lookup tables of both axes.
+ *  @return bool - true if a valid calibration was found, false if the EEPROM is empty or the checksum does not match.
+ */
+bool joystick_load_calibration(void) {
+    joystick_calibration calibration;
 
-    resolution_left = position.x;
-    resolution_right = RESOLUTION_END - position.x;
+    eeprom_read_block(&calibration, &joystick_calibration_eeprom, sizeof(joystick_calibration));
+
+    if ((calibration.magic != JOYSTICK_CALIBRATION_MAGIC) || (calibration.checksum != joystick_calibration_checksum(&calibration))) {
+        return false;
+    }
+
+    joystick_apply_calibration(&calibration);
+
+    return true;
+}
+
+/** Function for initializing the joystick at boot. The stored calibration is used if it is valid, otherwise the joystick is calibrated.
+ *  Holding the joystick button down during boot forces a new calibration.
+ */
+void joystick_init(void) {
+    bool button_held = buttons_is_pressed(JOYSTICK_BUTTON);
+
+    if (button_held || !joystick_load_calibration()) {
+        joystick_calibrate();
+    }
 }
 
 /** Function for returning the quadrant the joystick is position in by reading x-and y-position.
@@ -91,35 +368,18 @@ bool is_vertical_direction(joystick position) {
 }
 
 /** Function converts digital signal from joysticks x- and y-values with voltage resolution 0-255 to percent-representation -100-100.
+ *  Each axis is sampled once and mapped through its lookup table.
  *  @return joystick position - Struct containing x-and-y-positions of joysticks represented as percentage of displacement -100-100.
  */
 joystick joystick_position(void) {
     joystick position;
 
-    // Converting from 0-255 resolution to -100-100 resolution in x-axis
-    if ((selected_channel_output(X_AXIS_CHANNEL) >= (resolution_left)) && (selected_channel_output(X_AXIS_CHANNEL) <= (resolution_left))) {
-        position.x = 0;
-    }
-    else if (selected_channel_output(X_AXIS_CHANNEL) < resolution_left) {
-        position.x = -(((resolution_left-selected_channel_output(X_AXIS_CHANNEL))*100)/resolution_left);
-    }
-    else {
-        position.x = (((selected_channel_output(X_AXIS_CHANNEL)-resolution_left)*100)/resolution_right);
-    }
-
-    // Converting from 0-255 resolution to -100-100 resolution in y-axis
-    if ((selected_channel_output(Y_AXIS_CHANNEL) >= (resolution_left)) && (selected_channel_output(Y_AXIS_CHANNEL) <= (resolution_left))) {
-        position.y = 0;
-    }
-
-    else if (selected_channel_output(Y_AXIS_CHANNEL) < resolution_left) {
-        position.y = -(((resolution_left-selected_channel_output(Y_AXIS_CHANNEL))*100)/resolution_left);
-    }
-
-    else {
-        position.y = (((selected_channel_output(Y_AXIS_CHANNEL)-resolution_left)*100)/resolution_right);
-    }
+    // One sample per axis, both from the same scan
+    ADC_snapshot snapshot = ADC_read_snapshot();
 
+    // Converting from 0-255 resolution to -100-100 resolution using the calibrated tables
+    position.x = X_AXIS_TABLE[snapshot.channel[X_AXIS_CHANNEL - ADC_FIRST_CHANNEL]];
+    position.y = Y_AXIS_TABLE[snapshot.channel[Y_AXIS_CHANNEL - ADC_FIRST_CHANNEL]];
 
     return position;
 }
@@ -189,3 +449,31 @@ void test_read_joystick_position(void) {
     printf("Y-value: %i\n\r", joy_position.y);
 
 }
+
+/** Test function comparing the CPU cycles of the division based mapping with the lookup table mapping, timed with TIMER1.
+ *  The division based mapping is the path the lookup tables replaced, six blocking ADC reads included, so the background scan is stopped while it runs.
+ */
+void test_joystick_mapping_cycles(void) {
+    // Run TIMER1 at clk/1. The baseline takes at most eight reads of 500 us, within the 13 ms before TIMER1 overflows
+    TCCR1A = 0;
+    TCCR1B = (1 << CS10);
+
+    ADC_scan_stop();
+    TCNT1 = 0;
+    joystick baseline = joystick_position_baseline();
+    uint16_t baseline_cycles = TCNT1;
+    ADC_scan_start();
+
+    // Let the scan publish a complete snapshot again
+    ADC_wait_for_scan();
+    ADC_wait_for_scan();
+
+    TCNT1 = 0;
+    joystick table = joystick_position();
+    uint16_t table_cycles = TCNT1;
+
+    TCCR1B = 0;
+
+    printf("Division mapping, six ADC reads: %u cycles, (%i, %i)\n\r", baseline_cycles, baseline.x, baseline.y);
+    printf("Table mapping, snapshot read: %u cycles, (%i, %i)\n\r", table_cycles, table.x, table.y);
+}
@@ -7,15 +7,31 @@
 #define JOYSTICK_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <avr/eeprom.h>
 #include <avr/io.h>
 #include <util/delay.h>
 
 #include "ADC.h"
-#include "CAN.h"
+#include "buttons.h"
 #include "slider.h"
+#include "timer.h"
+
+// Calibration: settle time before sampling the neutral position, time to move the joystick around its full range
+#define JOYSTICK_SETTLE_MS 1000
+#define JOYSTICK_SWEEP_MS 5000
+
+// Raw distance from the centre that maps to 0
+#define JOYSTICK_DEADZONE 4
+
+// Smallest raw range on each side of the deadzone accepted from calibration
+#define JOYSTICK_MIN_SPAN 16
+
+// Marks a calibration written by this firmware in EEPROM. Change when the calibration struct changes
+#define JOYSTICK_CALIBRATION_MAGIC 0xa5
 
 
 /** Struct joystick representing the x- and y-axis respectively.
@@ -25,25 +41,80 @@ typedef struct {
     int y;
 } joystick;
 
+/** Struct joystick_axis_calibration representing the raw samples (0-255) at the ends and neutral position of one axis.
+ */
+typedef struct {
+    uint8_t min;
+    uint8_t centre;
+    uint8_t max;
+} joystick_axis_calibration;
+
+/** Struct joystick_calibration representing the calibration of both axes, as stored in EEPROM.
+ */
+typedef struct {
+    uint8_t magic;
+    joystick_axis_calibration x;
+    joystick_axis_calibration y;
+    uint8_t deadzone;
+    uint8_t checksum;
+} joystick_calibration;
+
+/** Enum joystick_calibration_step representing the steps of a calibration.
+ */
+typedef enum {
+    JOYSTICK_CALIBRATION_IDLE,
+    JOYSTICK_CALIBRATION_SETTLE,
+    JOYSTICK_CALIBRATION_SWEEP
+} joystick_calibration_step;
+
 /** Enum direction representing the directions of the joystick.
  */
 typedef enum {LEFT, RIGHT, UP, DOWN, NEUTRAL, UNKNOWN} direction;
 
 
-/** Function for detecting if joystick button is pressed.
- *  @return int joystick_button - Returns 0 if joystick button is pressed, 1 otherwise.
+/** Function for detecting if joystick button has been pressed since the last call. Does not block.
+ *  @return int joystick_button - Returns 0 if joystick button has been pressed, 1 otherwise.
  */
 int joystick_button_not_pressed(void);
 
-/** Function for detecting if touch button is pressed.
+/** Function for detecting if touch button is pressed, or has been pressed since the last call, so that short presses are not missed.
  * @return bool - Returns 1 if touch button is pressed, 0 otherwise.
  */
 bool touch_button_pressed();
 
-/** Function for calibrating the joystick neutral position (neutral = origo).
+/** Function for starting a calibration of the joystick. The neutral position is sampled after JOYSTICK_SETTLE_MS, then min and max of both axes are recorded
+ *  while the joystick is moved around its full range for JOYSTICK_SWEEP_MS. Does not block, the calibration is advanced by joystick_calibration_update.
+ *  The old lookup tables are used until the calibration is finished.
+ */
+void joystick_calibration_start(void);
+
+/** Function for advancing a running calibration with the latest ADC snapshot. Does not block.
+ *  When the calibration is finished it is stored in EEPROM, and the lookup tables of both axes are built.
+ *  Called every few milliseconds while the calibration is running, so that the extremes of the sweep are not missed.
+ *  @return bool - true if the calibration is still running.
+ */
+bool joystick_calibration_update(void);
+
+/** Function for checking whether a calibration is running.
+ *  @return bool - true if a calibration is running.
+ */
+bool joystick_calibration_running(void);
+
+/** Function for calibrating the joystick, blocking until the calibration is finished. Only for use before the scheduler is started.
  */
 void joystick_calibrate(void);
 
+/** Function for loading the calibration stored in EEPROM, and building the lookup tables of both axes.
+ *  @return bool - true if a valid calibration was found, false if the EEPROM is empty or the checksum does not match.
+ */
+bool joystick_load_calibration(void);
+
+/** Function for initializing the joystick at boot. The stored calibration is used if it is valid, otherwise the joystick is calibrated.
+ *  Holding the joystick button down during boot forces a new calibration.
+ *  Must be called before joystick_position.
+ */
+void joystick_init(void);
+
 /** Function for returning the quadrant the joystick is position in by reading x-and y-position.
  *  @param struct Joystick position - Struct that yields the x- and y-values respectively.
  *  @return int 1-4 - Quadrant the joystick is in.
@@ -70,4 +141,9 @@ direction joystick_direction(void);
  */
 void test_read_joystick_position(void);
 
+/** Test function comparing the CPU cycles of the division based mapping with the lookup table mapping, timed with TIMER1.
+ *  The division based mapping is the path the lookup tables replaced, six blocking ADC reads included, so the background scan is stopped while it runs.
+ */
+void test_joystick_mapping_cycles(void);
+
 #endif
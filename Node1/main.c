@@ -5,16 +5,19 @@
 
 #include "ADC.h"
 #include "addresses.h"
+#include "animation.h"
+#include "buttons.h"
 #include "CAN.h"
+#include "CAN_health.h"
 #include "joystick.h"
 #include "menu.h"
 #include "OLED.h"
+#include "scheduler.h"
 #include "UART.h"
 #include "slider.h"
 #include "SPI.h"
 #include "sram_test.h"
-
-#include <util/delay.h>
+#include "timer.h"
 
 /** Interrupt vector function for detecting unhandled interrupts.
  */
@@ -23,78 +26,191 @@ ISR(__vector_default) {
 
 }
 
-void main() {
+// Task periods. The controller is sampled and sent at 200 Hz, the menu is redrawn at 20 Hz, and the OLED gets a part of the framebuffer every millisecond.
+#define INPUT_PERIOD_MS 5
+#define CAN_TX_PERIOD_MS 5
+#define CAN_RX_PERIOD_MS 5
+#define MENU_PERIOD_MS 50
+#define OLED_PERIOD_MS 1
 
-    sei();
-    UART_init(9600);
-    CAN_init();
+// Time a held joystick direction waits before it moves the menu again
+#define MENU_REPEAT_MS 500
 
-    //set_bit(UCSR1A, UPE1);
-    set_bit(MCUCR, SRE); // Sets the SRE (Static Ram Enable) bit in the MCUCR (MCU Control Register) - enabling external write
-    set_bit(SFIOR, XMM2); // Setting XMM2 (External Memory High Mask) bit in the SFIOR (Special Function IO Register) - use 4 bits for external memory address
+// Set to 1 to print the run times of the tasks over UART every STATISTICS_PERIOD_MS, and start them again. The print blocks the other tasks for about 0.7 s at 9600 baud, so they are counted late once
+#define PRINT_STATISTICS 0
+#define STATISTICS_PERIOD_MS 10000
 
+// Latest controller input, written by the input task and sent by the CAN task
+static joystick position;
+static Sliders slider;
 
-    /* USB MULTIBOARD INIT */
-    _delay_ms(1000);
-    joystick_calibrate();
-    joystick position = joystick_position();
-    Sliders slider = slider_position();
+// Game over flag of the latest game info frame from Node 2
+static uint8_t game_over = 0;
 
-    /* MENU INIT */
-    OLED_init();
-    // Parent menu is Main Menu
-    menu* parent_menu = menu_init();
-    // Child menu is Play Game, which means that this is the first current menu from menu_navigate
-    menu* child_menu = parent_menu->child;
-    // Current menu is nothing
-    menu* current_menu = NULL;
-    // Direction of joystick
+// Menu state. The parent menu is Main Menu, and the child menu Play Game is the first current menu from menu_navigate.
+static menu_id parent_menu = MENU_MAIN;
+static menu_id child_menu = MENU_PLAY_GAME;
+
+// Direction that last moved the menu, and when
+static direction menu_dir = NEUTRAL;
+static uint16_t menu_dir_time = 0;
+
+/** Function for reading the joystick and sliders, and advancing a joystick calibration started from the menu.
+ */
+static void task_input(void) {
+    joystick_calibration_update();
+
+    position = joystick_position();
+    slider = slider_position();
+}
+
+/** Function for sending the controller input to Node 2, and moving queued frames to free transmit buffers.
+ */
+static void task_can_tx(void) {
+    CAN_transmit_game_controller(position, slider, PLAY_GAME_FLAG, DIFFICULTY_FLAG);
+    CAN_service_transmit();
+}
+
+/** Function for following the game over flag of a game info message from Node 2.
+ *  @param message* msg - The received message.
+ */
+static void game_info_received(message* msg) {
+    game_over = msg->data[1];
+}
+
+/** Function for handing the frames received from Node 2 to their handlers.
+ */
+static void task_can_rx(void) {
+    CAN_dispatch();
+}
+
+/** Function for returning the joystick direction used by the menu. A held direction moves the menu once, and again every MENU_REPEAT_MS.
+ *  @return direction dir - Direction to navigate, NEUTRAL while a held direction waits.
+ */
+static direction menu_direction(void) {
     direction dir = joystick_direction();
 
+    if ((dir != menu_dir) || (timer_elapsed_ms(menu_dir_time) >= MENU_REPEAT_MS)) {
+        menu_dir = dir;
+        menu_dir_time = timer_ms();
+        return dir;
+    }
+    return NEUTRAL;
+}
+
+/** Function for advancing the menu, and the game over animation when it is running.
+ */
+static void task_menu(void) {
+    if (joystick_calibration_running()) {
+        // Keep MOVE JOYSTICK on the display, and drop button presses made while calibrating
+        joystick_button_not_pressed();
+    }
+
+    else if (animation_running()) {
+        // Keep the animation going while the controller keeps running, skip it with the joystick button
+        animation_update();
 
-    while(1) {
+        if (!joystick_button_not_pressed()) {
+            animation_stop();
+        }
+    }
+
+    else if (game_over != 1){
         // The current menu is changed to the one menu navigate decides
-        current_menu = menu_navigate(child_menu, dir);
-
-        if (CAN_recent_message().data[1] != 1){
-            if (current_menu->title != "GAME OVER") {
-                // Print submenu of current menu
-                menu_print_submenu(parent_menu, current_menu);
-                _delay_ms(500);
-                dir = joystick_direction();
-                child_menu = current_menu;
-                parent_menu = child_menu->parent;
-            } else {
-                OLED_reset();
-
-                // Printing game over
-                child_menu = current_menu;
-                parent_menu = child_menu->parent;
-            }
+        menu_id current_menu = menu_navigate(child_menu, menu_direction());
+
+        if (animation_running()) {
+            // Game over was chosen in the menu, the animation is drawn by the next passes
+        } else if (joystick_calibration_running()) {
+            // Calibrate was chosen in the menu, MOVE JOYSTICK stays until it is finished
+        } else if (current_menu != MENU_GAME_OVER) {
+            // Print submenu of current menu
+            menu_print_submenu(parent_menu, current_menu);
         } else {
-            // Print game over
+            // Printing game over
             OLED_reset();
-            menu_print_game_over();
-            _delay_ms(100);
-
-            // Return to main menu
-            while (current_menu->title != "PLAY GAME"){
-                current_menu = (current_menu->parent);
-            }
+            OLED_update();
+        }
+        child_menu = current_menu;
+        parent_menu = menu_parent(child_menu);
+    } else {
+        // Print game over
+        menu_print_game_over();
+
+        // Return to main menu
+        child_menu = MENU_PLAY_GAME;
+        parent_menu = menu_parent(child_menu);
+
+        PLAY_GAME_FLAG = 0;
+        DIFFICULTY_FLAG = 0;
+    }
+}
 
-            child_menu = current_menu;
-            parent_menu = child_menu->parent;
+/** Function for sampling the CAN error counters, and sending a status frame to Node 2 once per rate window.
+ */
+static void task_can_health(void) {
+    if (CAN_health_sample()) {
+        CAN_health_transmit_status(CAN_ID_NODE1_STATUS);
+    }
+}
 
-            PLAY_GAME_FLAG = 0;
-            DIFFICULTY_FLAG = 0;
-        }
+/** Function for sending the next part of the OLED framebuffer.
+ */
+static void task_oled(void) {
+    OLED_flush_tick();
+}
 
-        // USB MULTIFUNCTION BOARD
-        position = joystick_position();
-        slider = slider_position();
+static void task_statistics(void);
 
-        CAN_transmit_game_controller(position, slider, PLAY_GAME_FLAG, DIFFICULTY_FLAG);
+// Tasks in priority order
+static task tasks[] = {
+    TASK("INPUT", task_input, INPUT_PERIOD_MS),
+    TASK("CAN TX", task_can_tx, CAN_TX_PERIOD_MS),
+    TASK("CAN RX", task_can_rx, CAN_RX_PERIOD_MS),
+    TASK("OLED", task_oled, OLED_PERIOD_MS),
+    TASK("MENU", task_menu, MENU_PERIOD_MS),
+    TASK("CAN HEALTH", task_can_health, CAN_HEALTH_PERIOD_MS),
+    TASK("STATISTICS", task_statistics, STATISTICS_PERIOD_MS),
+};
 
-        _delay_ms(100);
+/** Function for printing the run times of the tasks since the last print, when PRINT_STATISTICS is set.
+ */
+static void task_statistics(void) {
+    if (!PRINT_STATISTICS) {
+        return;
     }
+
+    scheduler_print_statistics(tasks, sizeof(tasks)/sizeof(tasks[0]));
+    scheduler_reset_statistics(tasks, sizeof(tasks)/sizeof(tasks[0]));
+}
+
+void main() {
+
+    sei();
+    UART_init(9600);
+    buttons_init();
+    timer_init();
+    CAN_init();
+    CAN_register_handler(CAN_ID_GAME_INFO, false, game_info_received);
+    CAN_health_register_peer(CAN_ID_NODE2_STATUS);
+    CAN_apply_filters();
+    CAN_health_init();
+
+    //set_bit(UCSR1A, UPE1);
+    set_bit(MCUCR, SRE); // Sets the SRE (Static Ram Enable) bit in the MCUCR (MCU Control Register) - enabling external write
+    set_bit(SFIOR, XMM2); // Setting XMM2 (External Memory High Mask) bit in the SFIOR (Special Function IO Register) - use 4 bits for external memory address
+
+
+    /* USB MULTIBOARD INIT */
+    ADC_init();
+    slider_init();
+    joystick_init();
+    position = joystick_position();
+    slider = slider_position();
+
+    /* MENU INIT */
+    OLED_init();
+    child_menu = menu_child(parent_menu);
+
+    scheduler_run(tasks, sizeof(tasks)/sizeof(tasks[0]));
 }
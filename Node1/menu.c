@@ -11,105 +11,186 @@ int PLAY_GAME_FLAG = 0;
 // Flag (0-2) indicating difficulty of game.
 int DIFFICULTY_FLAG = 0;
 
-/** Function for creating new submenu and initialising it.
- *  @param char* menu_title - Title of the menu being created
- *  @param menu* parent_menu - Pointer to struct menu that should be current menus' parent
- *  @param menu* child_menu - Pointer to struct menu that should be current menus' child
- *  @param menu* left_sibling_menu - Pointer to struct menu that should be current menus' left sibling
- *  @param menu* right_sibling_menu - Pointer to struct menu that should be current menus' right sibling
- *  @return new_menu - New menu struct with specified child, parent and siblings
+// Titles in flash, menu_title_<id>
+#define MENU_TITLE(id, title, parent, child, right_sibling, action) static const char menu_title_##id[] PROGMEM = title;
+MENU_TABLE(MENU_TITLE)
+
+// Table entry of each node, indexed by menu_id
+#define MENU_ENTRY(id, title, parent, child, right_sibling, action) \
+    [MENU_##id] = {menu_title_##id, MENU_##parent, MENU_##child, MENU_##right_sibling, MENU_ACTION_##action},
+
+static const menu_node menu_table[MENU_NUM_NODES] PROGMEM = {
+    MENU_TABLE(MENU_ENTRY)
+};
+
+/** Function for copying a node from the table in flash.
+ *  @param menu_id id - The node.
+ *  @return menu_node node - Copy of the node, the title still points to flash.
+ */
+static menu_node menu_read_node(menu_id id){
+    menu_node node;
+    memcpy_P(&node, &menu_table[id], sizeof(menu_node));
+    return node;
+}
+
+/** Function for printing the title of a node on the OLED.
+ *  @param menu_id id - The node.
+ *  @param bool highlight - Print highlighted if true.
+ */
+static void menu_print_title(menu_id id, bool highlight){
+    char title[MENU_TITLE_LENGTH + 1];
+    strncpy_P(title, menu_read_node(id).title, MENU_TITLE_LENGTH);
+    title[MENU_TITLE_LENGTH] = '\0';
+
+    if (highlight) {
+        OLED_print_highlight("%s", title);
+    } else {
+        OLED_print("%s", title);
+    }
+}
+
+/** Function for returning the parent of a node.
+ *  @param menu_id id - The node.
+ *  @return menu_id - The parent, MENU_NONE for the main menu.
+ */
+menu_id menu_parent(menu_id id){
+    return pgm_read_byte(&menu_table[id].parent);
+}
+
+/** Function for returning the first child of a node.
+ *  @param menu_id id - The node.
+ *  @return menu_id - The first child, MENU_NONE if the node has no children.
+ */
+menu_id menu_child(menu_id id){
+    return pgm_read_byte(&menu_table[id].child);
+}
+
+/** Function for returning the right sibling of a node.
+ *  @param menu_id id - The node.
+ *  @return menu_id - The right sibling, MENU_NONE if the node is the last child.
+ */
+menu_id menu_right_sibling(menu_id id){
+    return pgm_read_byte(&menu_table[id].right_sibling);
+}
+
+/** Function for returning the left sibling of a node.
+ *  @param menu_id id - The node.
+ *  @return menu_id - The left sibling, MENU_NONE if the node is the first child.
  */
-menu* menu_new(char* menu_title, menu* parent_menu, menu* child_menu, menu* left_sibling_menu, menu* right_sibling_menu){
-    menu* new_menu = malloc(sizeof(menu));
+menu_id menu_left_sibling(menu_id id){
+    menu_id parent = menu_parent(id);
+    if (parent == MENU_NONE) {
+        return MENU_NONE;
+    }
 
-    new_menu->title = menu_title;
-    new_menu->parent = parent_menu;
-    new_menu->child = child_menu;
-    new_menu->left_sibling = left_sibling_menu;
-    new_menu->right_sibling = right_sibling_menu;
+    menu_id left = MENU_NONE;
+    menu_id sibling = menu_child(parent);
 
-    return new_menu;
+    while ((sibling != MENU_NONE) && (sibling != id)) {
+        left = sibling;
+        sibling = menu_right_sibling(sibling);
+    }
+    return left;
 }
 
 /** Function for printing a submenu.
- *  @param menu* parent_menu - pointer to struct that is current menus' parent.
- *  @param menu* current_menu - pointer to curren menu struct.
+ *  @param menu_id parent_menu - Node whose children are printed.
+ *  @param menu_id current_menu - Node that is highlighted.
  */
-void menu_print_submenu(menu* parent_menu, menu* current_menu){
+void menu_print_submenu(menu_id parent_menu, menu_id current_menu){
     OLED_reset();
     OLED_home();
 
-    if (parent_menu->title == "PLAY GAME") {
+    if (parent_menu == MENU_PLAY_GAME) {
         OLED_print("  PLAYING GAME");
 
     } else {
         OLED_print("   ");
-        OLED_print(parent_menu->title);
+        menu_print_title(parent_menu, false);
     }
 
     OLED_go_to_line(current_line + 2);
 
-    menu* child_menu = parent_menu->child;
+    menu_id child_menu = menu_child(parent_menu);
 
-    while (child_menu != NULL){
+    while (child_menu != MENU_NONE){
         if (child_menu == current_menu) {
-            OLED_print_highlight("o ", 5);
-            OLED_print_highlight(child_menu->title, 5);
+            OLED_print_highlight("o ");
+            menu_print_title(child_menu, true);
             OLED_go_to_line(current_line + 1);
         }
 
         else {
             OLED_print("  ");
-            OLED_print(child_menu->title);
+            menu_print_title(child_menu, false);
             OLED_go_to_line(current_line + 1);
         }
-        child_menu = child_menu->right_sibling;
+        child_menu = menu_right_sibling(child_menu);
     }
+
+    // Send only the lines that changed to the display
+    OLED_update();
 }
 
-/** Function for printing GAME OVER when game is ended. Toggling data.
+/** Function for drawing a frame of the game over animation, GAME OVER is shown in frame 0 and cleared in frame 1.
+ *  @param uint8_t frame - Frame to draw.
  */
-void menu_print_game_over(void){
-    for (int i = 0; i < 10; i++) {
+static void menu_draw_game_over(uint8_t frame){
+    if (frame == 0) {
         OLED_position(4, 25);
         OLED_print("GAME OVER");
-        _delay_ms(700);
+    } else {
         OLED_clear_line(4);
-        _delay_ms(1000);
     }
 }
 
+// Game over blinks 10 times, shown for 700 ms and cleared for 1000 ms
+static const uint16_t menu_game_over_durations[] = {700, 1000};
+
+static const animation menu_game_over_animation = {
+    .draw = menu_draw_game_over,
+    .frames = 2,
+    .durations = menu_game_over_durations,
+    .repeats = 10,
+};
 
+/** Function for starting the GAME OVER animation when game is ended. Toggling data.
+ *  Does not block, the animation is advanced by animation_update.
+ */
+void menu_print_game_over(void){
+    OLED_reset();
+    animation_start(&menu_game_over_animation);
+}
 
-/** Function for navigating the menu by moving between siblings and parent/child and setting flags when indicated by joystick button press.
- *  @param menu* child_menu - Pointer to struct menu that corresponds to current menus' child
+/** Function for navigating the menu by moving between siblings and parent/child and running the action of a node when indicated by joystick button press.
+ *  @param menu_id child_menu - Node that is currently selected.
  *  @param direction dir - direction enum corresponding to joystick movement.
- *  @return current_menu - Menu struct that is chosen by joystick movement
+ *  @return menu_id current_menu - Node that is chosen by joystick movement.
  */
-menu* menu_navigate(menu* child_menu, direction dir){
-    menu* current_menu = child_menu;
+menu_id menu_navigate(menu_id child_menu, direction dir){
+    menu_id current_menu = child_menu;
 
     if (dir == NEUTRAL) {
         current_menu = child_menu;
     }
 
     else if (dir == UP) {
-        if (current_menu->left_sibling != NULL) {
-            current_menu = (current_menu->left_sibling);
+        if (menu_left_sibling(current_menu) != MENU_NONE) {
+            current_menu = menu_left_sibling(current_menu);
         }
     }
 
     else if (dir == DOWN) {
-        if (current_menu->right_sibling != NULL) {
-            current_menu = (current_menu->right_sibling);
+        if (menu_right_sibling(current_menu) != MENU_NONE) {
+            current_menu = menu_right_sibling(current_menu);
         }
     }
 
     // If direction is left and the game is not playing
     else if ((dir == LEFT) && (PLAY_GAME_FLAG != 1)) {
-        menu* parent = current_menu->parent;
-        if ((parent != NULL) && (parent->title != "MAIN MENU")){
-            current_menu = (current_menu->parent);
+        menu_id parent = menu_parent(current_menu);
+        if ((parent != MENU_NONE) && (parent != MENU_MAIN)){
+            current_menu = parent;
         }
     }
 
@@ -119,136 +200,51 @@ menu* menu_navigate(menu* child_menu, direction dir){
 
     // Navigate through abstraction layers by pressing joystick button
     if (!(joystick_button_not_pressed())) {
-        if (current_menu->title == "PLAY GAME"){
-            current_menu = current_menu->child;
-            PLAY_GAME_FLAG = 1;
-
-        } else if (current_menu->title == "END GAME"){
-            current_menu = (current_menu->child);
-
-        } else if (current_menu->title == "GAME OVER"){
-            menu_print_game_over();
-            _delay_ms(5000);
-            // Return to main menu
-            while (current_menu->title != "PLAY GAME"){
-                current_menu = (current_menu->parent);
-            }
-            PLAY_GAME_FLAG = 0;
-            DIFFICULTY_FLAG = 0;
-
-        } else if (current_menu->title == "EASY"){
-            // Return to main menu
-            while (current_menu->title != "GAME SETTINGS"){
-                current_menu = (current_menu->parent);
-            }
-            DIFFICULTY_FLAG = 0;
-
-        } else if (current_menu->title == "MEDIUM"){
-            // Return to main menu
-            while (current_menu->title != "GAME SETTINGS"){
-                current_menu = (current_menu->parent);
-            }
-            DIFFICULTY_FLAG = 1;
-        } else if (current_menu->title == "HARD"){
-            // Return to main menu
-            while (current_menu->title != "GAME SETTINGS"){
-                current_menu = (current_menu->parent);
-            }
-            DIFFICULTY_FLAG = 2;
-        } else if (current_menu->child != NULL){
-
-            current_menu = current_menu->child;
+        switch (pgm_read_byte(&menu_table[current_menu].action)) {
+            case MENU_ACTION_PLAY_GAME:
+                current_menu = menu_child(current_menu);
+                PLAY_GAME_FLAG = 1;
+                break;
+
+            case MENU_ACTION_GAME_OVER:
+                menu_print_game_over();
+                // Return to main menu
+                current_menu = MENU_PLAY_GAME;
+                PLAY_GAME_FLAG = 0;
+                DIFFICULTY_FLAG = 0;
+                break;
+
+            case MENU_ACTION_EASY:
+                // Return to game settings
+                current_menu = MENU_GAME_SETTINGS;
+                DIFFICULTY_FLAG = 0;
+                break;
+
+            case MENU_ACTION_MEDIUM:
+                current_menu = MENU_GAME_SETTINGS;
+                DIFFICULTY_FLAG = 1;
+                break;
+
+            case MENU_ACTION_HARD:
+                current_menu = MENU_GAME_SETTINGS;
+                DIFFICULTY_FLAG = 2;
+                break;
+
+            case MENU_ACTION_CALIBRATE:
+                // Recalibrate joystick and store the calibration. The calibration is advanced by the input task, and the menu waits for it
+                OLED_reset();
+                OLED_position(3, 0);
+                OLED_print(" MOVE JOYSTICK");
+                OLED_update();
+                joystick_calibration_start();
+                break;
+
+            default:
+                if (menu_child(current_menu) != MENU_NONE){
+                    current_menu = menu_child(current_menu);
+                }
+                break;
         }
     }
     return current_menu;
 }
-
-/** Function for creating main menu and submenus and setting their member variables.
- *  @return main_menu - Menu struct corresponding to main menu.
- */
-menu* menu_init() {
-    /* MAIN MENU */
-    // Creating main menu, initializing its parent, child and siblings to NULL
-    menu* main_menu = menu_new("MAIN MENU", NULL, NULL, NULL, NULL);
-
-    /* SUBMENUS */
-    // Submenu of main menu: setting left siblings and parent, right siblings and children must be set after initialization
-    menu* play_game = menu_new("PLAY GAME", main_menu, NULL, NULL, NULL);
-    menu* game_settings = menu_new("GAME SETTINGS", main_menu, NULL, play_game, NULL);
-    menu* highscores = menu_new("HIGHSCORES", main_menu, NULL, game_settings, NULL);
-
-    // GAME SETTINGS
-    // Submenus of game settings
-    menu* play_mode = menu_new("DIFFICULTY", game_settings, NULL, NULL, NULL);
-    menu* players = menu_new("PLAYER MODE", game_settings, NULL, play_mode, NULL);
-
-    // Submenus of players
-    menu* single_player = menu_new("SINGLE PLAYER", players, NULL, NULL, NULL);
-    menu* multi_player = menu_new("MULTIPLAYER", players, NULL, single_player, NULL);
-
-    // Submenu for difficulty
-    menu* easy = menu_new("EASY", play_mode, NULL, NULL, NULL);
-    menu* medium = menu_new("MEDIUM", play_mode, NULL, easy, NULL);
-    menu* hard = menu_new("HARD", play_mode, NULL, medium, NULL);
-
-    // PLAY GAME
-    // Submenu of play game
-    menu* end_game = menu_new("END GAME", play_game, NULL, NULL, NULL);
-
-    // Subsubmenu of play game
-    menu* game_over = menu_new("GAME OVER", end_game, NULL, NULL, NULL);
-
-    // HIGH SCORE
-    menu* high_score_submenu = menu_new(" ", highscores, NULL, NULL, NULL);
-
-    /* SETTING THE CHILD VARIABLES*/
-    // Setting child of main menu
-    main_menu->child = play_game;
-
-    // Setting child of play game
-    play_game->child = end_game;
-
-    // Setting child of end game
-    end_game->child = game_over;
-
-    // Setting child of game settings
-    game_settings->child = play_mode;
-
-    // Setting child of players
-    players->child = single_player;
-
-    // Setting child of play_mode
-    play_mode->child = easy;
-
-    // Setting child of high score
-    highscores->child = high_score_submenu;
-
-    /* SETTING RIGHT SIBLINGS*/
-    // Main menu right siblings
-    play_game->right_sibling = game_settings;
-    game_settings->right_sibling = highscores;
-    highscores->right_sibling = NULL;
-
-    // Settings submenu
-    play_mode->right_sibling = players;
-    players->right_sibling = NULL;
-
-    // Settings subsubmenu
-    single_player->right_sibling = multi_player;
-    multi_player->right_sibling = NULL;
-
-    easy->right_sibling = medium;
-    medium->right_sibling = hard;
-    hard->right_sibling = NULL;
-
-    // Play game submenu
-    end_game->right_sibling = NULL;
-
-    // Play game subsubmenu
-    game_over->right_sibling = NULL;
-
-    // High score submenu
-    high_score_submenu->right_sibling = NULL;
-
-    return main_menu;
-}
@@ -1,5 +1,6 @@
 /** @file menu.c
  *  @brief H-file for the menu on the OLED - to move around in the menu.
+ *  The menu tree is a table in flash, generated from the MENU_TABLE description. Nodes are referred to by their menu_id.
  *  @authors: Anastasia Lindbäck and Marie Skatvedt
  */
 
@@ -11,8 +12,11 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include <stdlib.h>
+#include <string.h>
 #include <util/delay.h>
+#include <avr/pgmspace.h>
 
+#include "animation.h"
 #include "joystick.h"
 #include "OLED.h"
 
@@ -22,47 +26,105 @@ extern int PLAY_GAME_FLAG;
 // Global flag for setting difficulty of the game
 extern int DIFFICULTY_FLAG;
 
-// Menu struct containing menu struct pointers to other submenus
+// Longest menu title, without the terminating zero
+#define MENU_TITLE_LENGTH 16
+
+/* Menu tree description: MENU_NODE(id, title, parent, child, right sibling, action)
+ * Each row is one node. The children of a node are linked from its child through their right siblings, in the order they are printed.
+ * Left siblings are found by walking the children of the parent. NONE marks a missing node or action.
+ */
+#define MENU_TABLE(MENU_NODE) \
+    MENU_NODE(MAIN,            "MAIN MENU",     NONE,          PLAY_GAME,       NONE,          NONE) \
+    MENU_NODE(PLAY_GAME,       "PLAY GAME",     MAIN,          END_GAME,        GAME_SETTINGS, PLAY_GAME) \
+    MENU_NODE(GAME_SETTINGS,   "GAME SETTINGS", MAIN,          DIFFICULTY,      HIGHSCORES,    NONE) \
+    MENU_NODE(HIGHSCORES,      "HIGHSCORES",    MAIN,          HIGH_SCORE_LIST, NONE,          NONE) \
+    MENU_NODE(DIFFICULTY,      "DIFFICULTY",    GAME_SETTINGS, EASY,            PLAYER_MODE,   NONE) \
+    MENU_NODE(PLAYER_MODE,     "PLAYER MODE",   GAME_SETTINGS, SINGLE_PLAYER,   CALIBRATE,     NONE) \
+    MENU_NODE(CALIBRATE,       "CALIBRATE",     GAME_SETTINGS, NONE,            NONE,          CALIBRATE) \
+    MENU_NODE(SINGLE_PLAYER,   "SINGLE PLAYER", PLAYER_MODE,   NONE,            MULTIPLAYER,   NONE) \
+    MENU_NODE(MULTIPLAYER,     "MULTIPLAYER",   PLAYER_MODE,   NONE,            NONE,          NONE) \
+    MENU_NODE(EASY,            "EASY",          DIFFICULTY,    NONE,            MEDIUM,        EASY) \
+    MENU_NODE(MEDIUM,          "MEDIUM",        DIFFICULTY,    NONE,            HARD,          MEDIUM) \
+    MENU_NODE(HARD,            "HARD",          DIFFICULTY,    NONE,            NONE,          HARD) \
+    MENU_NODE(END_GAME,        "END GAME",      PLAY_GAME,     GAME_OVER,       NONE,          NONE) \
+    MENU_NODE(GAME_OVER,       "GAME OVER",     END_GAME,      NONE,            NONE,          GAME_OVER) \
+    MENU_NODE(HIGH_SCORE_LIST, " ",             HIGHSCORES,    NONE,            NONE,          NONE)
+
+// Generates MENU_<id> for each node
+#define MENU_ID(id, title, parent, child, right_sibling, action) MENU_##id,
+
+/** Enum menu_id representing the nodes of the menu tree, MENU_NONE for no node.
+ */
+typedef enum {
+    MENU_TABLE(MENU_ID)
+    MENU_NUM_NODES,
+    MENU_NONE = 0xff
+} menu_id;
+
+/** Enum menu_action representing what happens when the joystick button is pressed on a node.
+ */
+typedef enum {
+    MENU_ACTION_NONE,
+    MENU_ACTION_PLAY_GAME,
+    MENU_ACTION_GAME_OVER,
+    MENU_ACTION_EASY,
+    MENU_ACTION_MEDIUM,
+    MENU_ACTION_HARD,
+    MENU_ACTION_CALIBRATE
+} menu_action;
+
+/** Struct menu_node representing one node of the menu table in flash.
+ */
 typedef struct {
-    char* title;
-
-    struct menu* parent;
-    struct menu* child;
-    struct menu* left_sibling;
-    struct menu* right_sibling;
-} menu;
-
-
-/** Function for creating new submenu and initialising it.
- *  @param char* menu_title - Title of the menu being created
- *  @param menu* parent_menu - Pointer to struct menu that should be current menus' parent
- *  @param menu* child_menu - Pointer to struct menu that should be current menus' child
- *  @param menu* left_sibling_menu - Pointer to struct menu that should be current menus' left sibling
- *  @param menu* right_sibling_menu - Pointer to struct menu that should be current menus' right sibling
- *  @return new_menu - New menu struct with specified child, parent and siblings
+    const char* title;
+
+    uint8_t parent;
+    uint8_t child;
+    uint8_t right_sibling;
+    uint8_t action;
+} menu_node;
+
+
+/** Function for returning the parent of a node.
+ *  @param menu_id id - The node.
+ *  @return menu_id - The parent, MENU_NONE for the main menu.
+ */
+menu_id menu_parent(menu_id id);
+
+/** Function for returning the first child of a node.
+ *  @param menu_id id - The node.
+ *  @return menu_id - The first child, MENU_NONE if the node has no children.
+ */
+menu_id menu_child(menu_id id);
+
+/** Function for returning the right sibling of a node.
+ *  @param menu_id id - The node.
+ *  @return menu_id - The right sibling, MENU_NONE if the node is the last child.
+ */
+menu_id menu_right_sibling(menu_id id);
+
+/** Function for returning the left sibling of a node.
+ *  @param menu_id id - The node.
+ *  @return menu_id - The left sibling, MENU_NONE if the node is the first child.
  */
-menu* menu_new(char* menu_title, menu* parent_menu, menu* child_menu, menu* left_sibling_menu, menu* right_sibling_menu);
+menu_id menu_left_sibling(menu_id id);
 
 /** Function for printing a submenu.
- *  @param menu* parent_menu - pointer to struct that is current menus' parent.
- *  @param menu* current_menu - pointer to curren menu struct.
+ *  @param menu_id parent_menu - Node whose children are printed.
+ *  @param menu_id current_menu - Node that is highlighted.
  */
-void menu_print_submenu(menu* parent_menu, menu* current_menu);
+void menu_print_submenu(menu_id parent_menu, menu_id current_menu);
 
-/** Function for printing GAME OVER when game is ended. Toggling data.
+/** Function for starting the GAME OVER animation when game is ended. Toggling data.
+ *  Does not block, the animation is advanced by animation_update.
  */
 void menu_print_game_over(void);
 
-/** Function for navigating the menu by moving between siblings and parent/child and setting flags when indicated by joystick button press.
- *  @param menu* child_menu - Pointer to struct menu that corresponds to current menus' child
+/** Function for navigating the menu by moving between siblings and parent/child and running the action of a node when indicated by joystick button press.
+ *  @param menu_id child_menu - Node that is currently selected.
  *  @param direction dir - direction enum corresponding to joystick movement.
- *  @return current_menu - Menu struct that is chosen by joystick movement
- */
-menu* menu_navigate(menu* child_menu, direction dir);
-
-/** Function for creating main menu and submenus and setting their member variables.
- *  @return main_menu - Menu struct corresponding to main menu.
+ *  @return menu_id current_menu - Node that is chosen by joystick movement.
  */
-menu* menu_init();
+menu_id menu_navigate(menu_id child_menu, direction dir);
 
 #endif
@@ -0,0 +1,150 @@
+/** @file protocol.h
+ *  @brief Header-file for the frame formats shared by Node 1 and Node 2. Packs the controller state into a versioned CAN frame with a sequence number and a CRC-8, and unpacks it again.
+ *  The file is the same on both nodes, tests/Makefile checks that the copies are equal.
+ *  @authors: Anastasia Lindbäck and Marie Skatvedt
+ */
+
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Version of the controller frame layout, sent in the high nibble of the first byte
+#define PROTOCOL_VERSION 1
+
+/* Controller frame layout:
+ *  byte 0 - version (bits 7-4), difficulty (bits 3-2), play game (bit 1), touch button (bit 0)
+ *  byte 1 - sequence number, incremented for each frame sent
+ *  byte 2 - joystick x, signed (-100 - 100)
+ *  byte 3 - joystick y, signed (-100 - 100)
+ *  byte 4 - left slider (0 - 255)
+ *  byte 5 - right slider (0 - 255)
+ *  byte 6 - CRC-8 of bytes 0-5
+ */
+#define PROTOCOL_CONTROLLER_FLAGS 0
+#define PROTOCOL_CONTROLLER_SEQUENCE 1
+#define PROTOCOL_CONTROLLER_X 2
+#define PROTOCOL_CONTROLLER_Y 3
+#define PROTOCOL_CONTROLLER_SLIDER_LEFT 4
+#define PROTOCOL_CONTROLLER_SLIDER_RIGHT 5
+#define PROTOCOL_CONTROLLER_CRC 6
+#define PROTOCOL_CONTROLLER_LENGTH 7
+
+// Fields of the flags byte
+#define PROTOCOL_VERSION_SHIFT 4
+#define PROTOCOL_DIFFICULTY_SHIFT 2
+#define PROTOCOL_DIFFICULTY_MASK 0x03
+#define PROTOCOL_PLAY_GAME_BIT 1
+#define PROTOCOL_BUTTON_BIT 0
+
+// CRC-8 polynomial x^8 + x^2 + x + 1, initial value 0
+#define PROTOCOL_CRC_POLYNOMIAL 0x07
+
+// Sequence numbers further ahead than this are taken as old frames
+#define PROTOCOL_SEQUENCE_WINDOW 127
+
+// Old frames in a row after which the sender is taken as restarted, and the receiver follows its new sequence
+#define PROTOCOL_RESYNC_STALE 3
+
+/** Struct controller_frame representing the controller state sent from Node 1 to Node 2.
+ */
+typedef struct {
+    int8_t x;
+    int8_t y;
+
+    uint8_t slider_left;
+    uint8_t slider_right;
+
+    bool button;
+    bool play_game;
+
+    // 0 for EASY, 1 for MEDIUM and 2 for HARD
+    uint8_t difficulty;
+
+    uint8_t sequence;
+} controller_frame;
+
+/** Enum protocol_status representing the result of unpacking a frame.
+ */
+typedef enum {
+    PROTOCOL_OK,
+    PROTOCOL_ERROR_LENGTH,
+    PROTOCOL_ERROR_VERSION,
+    PROTOCOL_ERROR_CRC,
+    PROTOCOL_ERROR_STALE
+} protocol_status;
+
+/** Struct protocol_receiver representing the sequence state and error counters of a received frame stream.
+ */
+typedef struct {
+    bool synchronized;
+    uint8_t sequence;
+
+    // Old frames since the last accepted frame
+    uint8_t stale_run;
+
+    uint16_t received;
+    uint16_t lost;
+    uint16_t stale;
+    uint16_t resyncs;
+    uint16_t length_errors;
+    uint16_t version_errors;
+    uint16_t crc_errors;
+} protocol_receiver;
+
+/** Function for calculating the CRC-8 of a block of bytes.
+ *  @param const uint8_t* data - The bytes.
+ *  @param uint8_t length - Number of bytes.
+ *  @return uint8_t - The CRC.
+ */
+uint8_t protocol_crc8(const uint8_t* data, uint8_t length);
+
+/** Function for packing a controller frame.
+ *  @param const controller_frame* frame - The controller state. The joystick is limited to -100 - 100 and the difficulty to 2 bits.
+ *  @param uint8_t* data - Buffer for the PROTOCOL_CONTROLLER_LENGTH packed bytes.
+ *  @return uint8_t - Number of bytes packed, PROTOCOL_CONTROLLER_LENGTH.
+ */
+uint8_t protocol_encode_controller(const controller_frame* frame, uint8_t* data);
+
+/** Function for unpacking a controller frame, checking its length, version and CRC.
+ *  @param const uint8_t* data - The packed bytes.
+ *  @param uint8_t length - Number of bytes received.
+ *  @param controller_frame* frame - The unpacked controller state, only written when the frame is valid.
+ *  @return protocol_status - PROTOCOL_OK, or the reason the frame was rejected.
+ */
+protocol_status protocol_decode_controller(const uint8_t* data, uint8_t length, controller_frame* frame);
+
+/** Function for clearing the sequence state and counters of a receiver.
+ *  @param protocol_receiver* receiver - The receiver.
+ */
+void protocol_receiver_init(protocol_receiver* receiver);
+
+/** Function for making a receiver accept the next valid frame whatever its sequence number, e.g. when the link has been lost and the sender may have restarted. The counters are kept.
+ *  @param protocol_receiver* receiver - The receiver.
+ */
+void protocol_receiver_resync(protocol_receiver* receiver);
+
+/** Function for unpacking a received controller frame, rejecting invalid and old frames and counting the frames lost before it.
+ *  After PROTOCOL_RESYNC_STALE old frames in a row the sender is taken as restarted, and the frame is accepted.
+ *  @param protocol_receiver* receiver - Sequence state and counters of the stream.
+ *  @param const uint8_t* data - The packed bytes.
+ *  @param uint8_t length - Number of bytes received.
+ *  @param controller_frame* frame - The unpacked controller state, only written when the frame is accepted.
+ *  @return protocol_status - PROTOCOL_OK, or the reason the frame was rejected.
+ */
+protocol_status protocol_receive_controller(protocol_receiver* receiver, const uint8_t* data, uint8_t length, controller_frame* frame);
+
+/** Function for printing the counters of a receiver.
+ *  @param const protocol_receiver* receiver - The receiver.
+ */
+void protocol_print_receiver(const protocol_receiver* receiver);
+
+/** Test function packing and unpacking controller frames, checking that every field survives the round trip and that corrupted, truncated, foreign-version and old frames are rejected.
+ *  Runs on the target, and on the PC with tests/Makefile.
+ *  @return uint16_t - Number of failed checks.
+ */
+uint16_t test_protocol_controller_frame(void);
+
+#endif
@@ -0,0 +1,82 @@
+/** @file scheduler.c
+ *  @brief C-file for the cooperative scheduler running the main loop. Each task is run to completion when its period has elapsed on the system tick, and its run time is measured.
+ *  @authors: Anastasia Lindbäck and Marie Skatvedt
+ */
+
+#include "scheduler.h"
+
+/** Function for running the tasks that are due, once each. Tasks are checked in table order, so earlier tasks have higher priority.
+ *  @param task* tasks - Table of tasks.
+ *  @param uint8_t num_tasks - Number of tasks in the table.
+ */
+void scheduler_run_due(task* tasks, uint8_t num_tasks) {
+    for (uint8_t i = 0; i < num_tasks; i++) {
+        task* t = &tasks[i];
+        uint16_t elapsed = timer_elapsed_ms(t->last_run);
+
+        if (elapsed < t->period_ms) {
+            continue;
+        }
+
+        // A whole period was missed, the task is started from now instead of catching up
+        if ((t->period_ms > 0) && (elapsed >= 2 * t->period_ms)) {
+            t->late++;
+            t->last_run = timer_ms();
+        } else {
+            t->last_run += t->period_ms;
+        }
+
+        uint16_t start = timer_ticks();
+        t->run();
+        uint16_t ticks = timer_ticks() - start;
+
+        t->runs++;
+        t->total_ticks += ticks;
+        if (ticks > t->max_ticks) {
+            t->max_ticks = ticks;
+        }
+    }
+}
+
+/** Function for running the tasks forever. Does not return.
+ *  @param task* tasks - Table of tasks.
+ *  @param uint8_t num_tasks - Number of tasks in the table.
+ */
+void scheduler_run(task* tasks, uint8_t num_tasks) {
+    uint16_t now = timer_ms();
+
+    for (uint8_t i = 0; i < num_tasks; i++) {
+        tasks[i].last_run = now;
+    }
+
+    while (1) {
+        scheduler_run_due(tasks, num_tasks);
+    }
+}
+
+/** Function for clearing the statistics of all tasks.
+ *  @param task* tasks - Table of tasks.
+ *  @param uint8_t num_tasks - Number of tasks in the table.
+ */
+void scheduler_reset_statistics(task* tasks, uint8_t num_tasks) {
+    for (uint8_t i = 0; i < num_tasks; i++) {
+        tasks[i].runs = 0;
+        tasks[i].late = 0;
+        tasks[i].max_ticks = 0;
+        tasks[i].total_ticks = 0;
+    }
+}
+
+/** Function for printing the runs, missed periods and run times of all tasks over UART.
+ *  @param task* tasks - Table of tasks.
+ *  @param uint8_t num_tasks - Number of tasks in the table.
+ */
+void scheduler_print_statistics(task* tasks, uint8_t num_tasks) {
+    for (uint8_t i = 0; i < num_tasks; i++) {
+        task* t = &tasks[i];
+        uint32_t average = t->runs ? (t->total_ticks / t->runs) : 0;
+
+        printf("%s: period %u ms, runs %u, late %u\n\r", t->name, t->period_ms, t->runs, t->late);
+        printf("    Run time: average %lu us, max %lu us\n\r", TIMER_TICKS_TO_US(average), TIMER_TICKS_TO_US(t->max_ticks));
+    }
+}
@@ -0,0 +1,58 @@
+/** @file scheduler.h
+ *  @brief Header-file for the cooperative scheduler running the main loop. Each task is run to completion when its period has elapsed on the system tick, and its run time is measured.
+ *  @authors: Anastasia Lindbäck and Marie Skatvedt
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "timer.h"
+
+/** Struct task representing one periodic task and its run time statistics.
+ */
+typedef struct {
+    const char* name;
+    void (*run)(void);
+
+    // Time between the starts of two runs, 0 runs the task on every pass
+    uint16_t period_ms;
+    uint16_t last_run;
+
+    // Statistics, run times in TIMER2 ticks
+    uint16_t runs;
+    uint16_t late;
+    uint16_t max_ticks;
+    uint32_t total_ticks;
+} task;
+
+// Initializer for a task in a task table
+#define TASK(name, run, period_ms) {name, run, period_ms, 0, 0, 0, 0, 0}
+
+/** Function for running the tasks that are due, once each. Tasks are checked in table order, so earlier tasks have higher priority.
+ *  @param task* tasks - Table of tasks.
+ *  @param uint8_t num_tasks - Number of tasks in the table.
+ */
+void scheduler_run_due(task* tasks, uint8_t num_tasks);
+
+/** Function for running the tasks forever. Does not return.
+ *  @param task* tasks - Table of tasks.
+ *  @param uint8_t num_tasks - Number of tasks in the table.
+ */
+void scheduler_run(task* tasks, uint8_t num_tasks);
+
+/** Function for clearing the statistics of all tasks.
+ *  @param task* tasks - Table of tasks.
+ *  @param uint8_t num_tasks - Number of tasks in the table.
+ */
+void scheduler_reset_statistics(task* tasks, uint8_t num_tasks);
+
+/** Function for printing the runs, missed periods and run times of all tasks over UART.
+ *  @param task* tasks - Table of tasks.
+ *  @param uint8_t num_tasks - Number of tasks in the table.
+ */
+void scheduler_print_statistics(task* tasks, uint8_t num_tasks);
+
+#endif
@@ -10,6 +10,13 @@
 
 #define RESOLUTION 255
 
+/** Function for setting up the input filter of both slider channels.
+ */
+void slider_init(void){
+    ADC_set_filter(LEFT_SLIDER_CHANNEL, SLIDER_FILTER);
+    ADC_set_filter(RIGHT_SLIDER_CHANNEL, SLIDER_FILTER);
+}
+
 /** Function retrieving position of right and left sliders as a percent-value 0-100
  *  @return struct Sliders position - the position of the left and right slider.
  */
@@ -17,9 +24,10 @@ Sliders slider_position(void){
 
     Sliders position;
 
-    // Selecting which channel of the ADC to get output from. Hexadecimal representation of channel wanted from ADC.
-    int left_slider = selected_channel_output(LEFT_SLIDER_CHANNEL);
-    int right_slider = selected_channel_output(RIGHT_SLIDER_CHANNEL);
+    // Reading both sliders from the same scan of the ADC. Hexadecimal representation of channel wanted from ADC.
+    ADC_snapshot snapshot = ADC_read_snapshot();
+    int left_slider = snapshot.channel[LEFT_SLIDER_CHANNEL - ADC_FIRST_CHANNEL];
+    int right_slider = snapshot.channel[RIGHT_SLIDER_CHANNEL - ADC_FIRST_CHANNEL];
 
     // Output with resolution 0-255
     position.Left = left_slider;
@@ -16,6 +16,9 @@
 #include "ADC.h"
 
 
+// Input filter of the sliders: median, 4 x oversampling and IIR with alpha = 1/4. Smooths the PID reference on Node 2
+#define SLIDER_FILTER ((filter_settings){2, 2, true})
+
 /** Struct Sliders representing the left and right sliders respectively
  */
 typedef struct {
@@ -23,6 +26,10 @@ typedef struct {
     int Right;
 } Sliders ;
 
+/** Function for setting up the input filter of both slider channels.
+ */
+void slider_init(void);
+
 /** Function retrieving position of right and left sliders as a percent-value 0-100
  *  @return struct Sliders position - the position of the left and right slider.
  */
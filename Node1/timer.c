@@ -0,0 +1,71 @@
+/** @file timer.c
+ *  @brief C-file for the system tick. TIMER2 in CTC mode gives a millisecond time base for timeouts and intervals.
+ *  @authors: Anastasia Lindbäck and Marie Skatvedt
+ */
+
+#include "timer.h"
+
+// Milliseconds since timer_init
+static volatile uint16_t timer_milliseconds = 0;
+
+/** Function for initializing the system tick on TIMER2.
+ */
+void timer_init(void) {
+    timer_milliseconds = 0;
+
+    // CTC mode, prescaler 64
+    set_bit(TCCR2, WGM21);
+    set_bit(TCCR2, CS22);
+
+    OCR2 = TIMER_PERIOD_TICKS - 1;
+
+    // Enable compare match interrupt
+    set_bit(TIMSK, OCIE2);
+}
+
+/** Function for returning the time since timer_init in milliseconds. Wraps around after 65.5 s.
+ *  @return uint16_t ms - Milliseconds since start.
+ */
+uint16_t timer_ms(void) {
+    // The 16 bit counter is read with interrupts disabled, so that the ISR can not change it between the two bytes
+    uint8_t sreg = SREG;
+    cli();
+    uint16_t ms = timer_milliseconds;
+    SREG = sreg;
+
+    return ms;
+}
+
+/** Function for returning the time in TIMER2 ticks of 1/76800 s, for measuring short durations. Wraps around after 0.85 s.
+ *  @return uint16_t ticks - TIMER2 ticks since start.
+ */
+uint16_t timer_ticks(void) {
+    uint8_t sreg = SREG;
+    cli();
+    uint16_t ms = timer_milliseconds;
+    uint8_t count = TCNT2;
+
+    // A compare match that is not yet handled has restarted the counter without counting the millisecond
+    if (test_bit(TIFR, OCF2) && (count < TIMER_PERIOD_TICKS / 2)) {
+        ms++;
+    }
+    SREG = sreg;
+
+    return ms * TIMER_PERIOD_TICKS + count;
+}
+
+/** Function for returning the milliseconds elapsed since a time returned by timer_ms. Correct across wrap around.
+ *  @param uint16_t since - Earlier time from timer_ms.
+ *  @return uint16_t - Milliseconds elapsed.
+ */
+uint16_t timer_elapsed_ms(uint16_t since) {
+    return timer_ms() - since;
+}
+
+/** Interrupt service routine executed every millisecond, counting the system time and sampling the buttons.
+ */
+ISR(TIMER2_COMP_vect) {
+    timer_milliseconds++;
+
+    buttons_sample(timer_milliseconds);
+}
@@ -0,0 +1,42 @@
+/** @file timer.h
+ *  @brief Header-file for the system tick. TIMER2 in CTC mode gives a millisecond time base for timeouts and intervals.
+ *  @authors: Anastasia Lindbäck and Marie Skatvedt
+ */
+
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdint.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "bit_operations.h"
+#include "buttons.h"
+
+// TIMER2 prescaler 64 gives 4915200/64 = 76800 Hz, 77 ticks ~ 1 ms
+#define TIMER_PERIOD_TICKS 77
+
+// Converts TIMER2 ticks to microseconds, 1/76800 s ~ 13 us
+#define TIMER_TICKS_TO_US(ticks) (((uint32_t)(ticks) * 625) / 48)
+
+/** Function for initializing the system tick on TIMER2.
+ */
+void timer_init(void);
+
+/** Function for returning the time since timer_init in milliseconds. Wraps around after 65.5 s.
+ *  @return uint16_t ms - Milliseconds since start.
+ */
+uint16_t timer_ms(void);
+
+/** Function for returning the time in TIMER2 ticks of 1/76800 s, for measuring short durations. Wraps around after 0.85 s.
+ *  @return uint16_t ticks - TIMER2 ticks since start.
+ */
+uint16_t timer_ticks(void);
+
+/** Function for returning the milliseconds elapsed since a time returned by timer_ms. Correct across wrap around.
+ *  @param uint16_t since - Earlier time from timer_ms.
+ *  @return uint16_t - Milliseconds elapsed.
+ */
+uint16_t timer_elapsed_ms(uint16_t since);
+
+#endif
@@ -5,14 +5,74 @@
 
 #include "CAN.h"
 
+// Software transmit queue of each priority class
+static message CAN_tx_queue[CAN_NUM_PRIORITIES][CAN_TX_QUEUE_LENGTH];
+static uint8_t CAN_tx_head[CAN_NUM_PRIORITIES];
+static uint8_t CAN_tx_count[CAN_NUM_PRIORITIES];
+
+// Priority class of the frame last loaded into each transmit buffer
+static uint8_t CAN_tx_buffer_priority[MCP_NUM_TX_BUFFERS];
+
+// Bit n set while the frame loaded into transmit buffer n is not yet counted as sent or flushed
+static uint8_t CAN_tx_pending = 0;
+
+static CAN_queue_statistics CAN_queue_stats;
+
+// Receive ring, filled by the receive drain and emptied in place by the main loop. Only the drain writes the head, and only the main loop writes the tail.
+// The indices run freely, the slot is the index modulo CAN_RX_RING_LENGTH.
+static message CAN_rx_ring[CAN_RX_RING_LENGTH];
+static volatile uint8_t CAN_rx_head = 0;
+static volatile uint8_t CAN_rx_tail = 0;
+
+static volatile CAN_rx_statistics CAN_rx_stats;
+
+/** Struct CAN_handler_entry representing the handler of one message id.
+ */
+typedef struct {
+    uint32_t id;
+    bool extended;
+    CAN_handler handler;
+} CAN_handler_entry;
+
+static CAN_handler_entry CAN_handlers[CAN_MAX_HANDLERS];
+static uint8_t CAN_num_handlers = 0;
+
+// Set when the acceptance filters only let the registered ids through
+static bool CAN_filtering = false;
+
+// Keeps the compiler from moving ring accesses across the index updates
+#define CAN_MEMORY_BARRIER() __asm__ __volatile__ ("" ::: "memory")
+
 /** Function for initializing CAN communication.
  */
 int CAN_init(void){
 
+    // Frames still in the transmit buffers are lost in the reset
+    for (uint8_t buffer = 0; buffer < MCP_NUM_TX_BUFFERS; buffer++){
+        if (test_bit(CAN_tx_pending, buffer)) {
+            CAN_queue_stats.flushed++;
+        }
+    }
+    CAN_tx_pending = 0;
+
     // Reset MCP2515 to configuration mode and test self
     MCP_init();
 
-    MCP_bit_modify(MCP_RXB0CTRL, MCP_RX_BUFF_OP_MODE_BITS, 0xFF);
+    // Bit timing for CAN_BITRATE from the MCP2515 oscillator
+    MCP_bit_timing timing;
+    if (MCP_set_bit_timing(CAN_BITRATE, &timing)) {
+        printf("No bit timing for %lu bit/s!\n\r", (uint32_t)CAN_BITRATE);
+    }
+    else {
+        printf("CAN at %lu bit/s, sample point %u.%u %%\n\r", timing.bitrate, timing.sample_point_permille / 10, timing.sample_point_permille % 10);
+    }
+
+    // Roll over from RXB0 to RXB1, so that a second frame is kept while the first is read
+    MCP_bit_modify(MCP_RXB0CTRL, MCP_RXB0CTRL_BUKT, MCP_RXB0CTRL_BUKT);
+
+    // Receive every frame until acceptance filters are applied
+    MCP_set_receive_mode(0, MCP_RXM_ANY);
+    MCP_set_receive_mode(1, MCP_RXM_ANY);
 
     // Set MCP to normal mode
     MCP_bit_modify(MCP_CANCTRL, MODE_MASK, MODE_NORMAL);
@@ -23,6 +83,12 @@ int CAN_init(void){
     // Clear interrupt flag
     MCP_bit_modify(MCP_CANINTF, MCP_INT_MASK, 0);
 
+    // MCP2515 interrupt output on INT4, low level triggered. The pull-up keeps an unconnected pin from triggering
+    clear_bit(DDRE, CAN_INT_PIN);
+    set_bit(PORTE, CAN_INT_PIN);
+    set_bit(EIFR, INTF4);
+    set_bit(EIMSK, INT4);
+
     uint8_t value;
     value = MCP_read(MCP_CANSTAT);
 
@@ -37,10 +103,405 @@ int CAN_init(void){
     return 0;
 }
 
+/** Function for keeping the receive interrupt from taking frames, for the tests that read the receive buffers themselves. Bus transactions of the main loop are protected by SPI_bus_acquire instead.
+ *  @return bool enabled - Whether the interrupt was enabled, passed to CAN_rx_interrupt_restore.
+ */
+bool CAN_rx_interrupt_block(void){
+    bool enabled = test_bit(EIMSK, INT4);
+    clear_bit(EIMSK, INT4);
+
+    return enabled;
+}
+
+/** Function for enabling the receive interrupt again after CAN_rx_interrupt_block. A frame that arrived meanwhile is taken when the interrupt is enabled, since it is level triggered.
+ *  @param bool enabled - Return value of CAN_rx_interrupt_block.
+ */
+void CAN_rx_interrupt_restore(bool enabled){
+    if (enabled) {
+        set_bit(EIMSK, INT4);
+    }
+}
+
+/** Function for writing a frame to a transmit buffer and requesting transmission.
+ *  @param uint8_t buffer - Transmit buffer (0-2), must be free.
+ *  @param message* msg - The message to be sent.
+ *  @param CAN_priority priority - Priority class, sets the TXP bits of the buffer.
+ */
+static void CAN_load_tx_buffer(uint8_t buffer, message* msg, CAN_priority priority){
+    uint8_t length = (msg->length > MCP_FRAME_MAX_DATA) ? MCP_FRAME_MAX_DATA : msg->length;
+    uint8_t frame[MCP_FRAME_MAX_LENGTH];
+
+    MCP_encode_id(msg->id, msg->extended, &frame[MCP_FRAME_SIDH]);
+    frame[MCP_FRAME_DLC] = length;
+
+    for (uint8_t i = 0; i < length; i++){
+        frame[MCP_FRAME_HEADER_LENGTH + i] = msg->data[i];
+    }
+
+    MCP_bit_modify(MCP_TXB_CTRL(buffer), MCP_TXP_MASK, (priority == CAN_PRIORITY_HIGH) ? MCP_TXP_HIGHEST : MCP_TXP_LOWEST);
+    MCP_load_tx_buffer(buffer, frame, length);
+    MCP_request_to_send(buffer);
+
+    CAN_tx_buffer_priority[buffer] = priority;
+    set_bit(CAN_tx_pending, buffer);
+}
+
+/** Function for counting the frames that have left their transmit buffers, as sent, or as flushed if they were aborted.
+ *  @param uint8_t status - READ STATUS byte.
+ */
+static void CAN_count_tx_done(uint8_t status){
+    for (uint8_t buffer = 0; buffer < MCP_NUM_TX_BUFFERS; buffer++){
+        if (!test_bit(CAN_tx_pending, buffer) || (status & MCP_STATUS_TXREQ(buffer))) {
+            continue;
+        }
+
+        if (MCP_read(MCP_TXB_CTRL(buffer)) & MCP_TXB_ABTF) {
+            CAN_queue_stats.flushed++;
+        }
+        else {
+            CAN_queue_stats.sent++;
+        }
+        clear_bit(CAN_tx_pending, buffer);
+    }
+}
+
+/** Function for finding a transmit buffer for the next frame of a priority class.
+ *  At equal TXP the MCP2515 sends the highest buffer number first, so the frame must go below every buffer still sending a frame of the same class to keep the class in order.
+ *  @param uint8_t status - READ STATUS byte.
+ *  @param CAN_priority priority - Priority class of the frame.
+ *  @return int8_t buffer - Transmit buffer (0-2), -1 if none can be used now.
+ */
+static int8_t CAN_free_tx_buffer(uint8_t status, CAN_priority priority){
+    int8_t limit = MCP_NUM_TX_BUFFERS;
+
+    for (int8_t buffer = 0; buffer < MCP_NUM_TX_BUFFERS; buffer++){
+        if ((status & MCP_STATUS_TXREQ(buffer)) && (CAN_tx_buffer_priority[buffer] == priority)) {
+            limit = buffer;
+            break;
+        }
+    }
+
+    for (int8_t buffer = limit - 1; buffer >= 0; buffer--){
+        if (!(status & MCP_STATUS_TXREQ(buffer))) {
+            return buffer;
+        }
+    }
+    return -1;
+}
+
+/** Function for moving queued frames to free transmit buffers, high priority frames first. Called by CAN_send_message, and periodically to empty the queue and count the frames that have gone out.
+ */
+void CAN_service_transmit(void){
+    if ((CAN_tx_count[CAN_PRIORITY_HIGH] == 0) && (CAN_tx_count[CAN_PRIORITY_LOW] == 0) && (CAN_tx_pending == 0)) {
+        return;
+    }
+
+    SPI_bus_acquire();
+    uint8_t status = MCP_read_status();
+
+    CAN_count_tx_done(status);
+
+    for (int8_t priority = CAN_NUM_PRIORITIES - 1; priority >= 0; priority--){
+        while (CAN_tx_count[priority] > 0) {
+            int8_t buffer = CAN_free_tx_buffer(status, priority);
+            if (buffer < 0) {
+                break;
+            }
+
+            CAN_load_tx_buffer(buffer, &CAN_tx_queue[priority][CAN_tx_head[priority]], priority);
+            status |= MCP_STATUS_TXREQ(buffer);
+
+            CAN_tx_head[priority] = (CAN_tx_head[priority] + 1) % CAN_TX_QUEUE_LENGTH;
+            CAN_tx_count[priority]--;
+        }
+    }
+
+    SPI_bus_release();
+}
+
 /** Function for sending a message with a given id and data using MCP2515 for CAN communication.
+ *  The message is queued behind the frames of its priority class, and moved to a transmit buffer as soon as one is free. High priority frames go ahead of low priority frames.
  *  @param message msg - The message to be sent.
+ *  @param CAN_priority priority - CAN_PRIORITY_HIGH for game state, CAN_PRIORITY_LOW for periodic frames.
+ *  @return bool - true if the message was queued, false if the queue of its class was full and it was dropped.
  */
-void CAN_send_message(message msg){
+bool CAN_send_message(message msg, CAN_priority priority){
+    if (CAN_tx_count[priority] >= CAN_TX_QUEUE_LENGTH) {
+        CAN_queue_stats.dropped[priority]++;
+        return false;
+    }
+
+    uint8_t tail = (CAN_tx_head[priority] + CAN_tx_count[priority]) % CAN_TX_QUEUE_LENGTH;
+    CAN_tx_queue[priority][tail] = msg;
+    CAN_tx_count[priority]++;
+
+    if (CAN_tx_count[priority] > CAN_queue_stats.max_depth[priority]) {
+        CAN_queue_stats.max_depth[priority] = CAN_tx_count[priority];
+    }
+
+    CAN_service_transmit();
+
+    return true;
+}
+
+/** Function for emptying the transmit queues of both priority classes, e.g. on bus-off, so that old frames are not sent when the bus comes back. Frames already in a transmit buffer must be aborted with ABORT_TX.
+ */
+void CAN_tx_flush(void){
+    for (uint8_t priority = 0; priority < CAN_NUM_PRIORITIES; priority++){
+        CAN_queue_stats.flushed += CAN_tx_count[priority];
+        CAN_tx_count[priority] = 0;
+        CAN_tx_head[priority] = 0;
+    }
+}
+
+/** Function for returning the transmit queue depths and counters.
+ *  @return CAN_queue_statistics - Current and largest depth and drops of each priority class, and frames sent and flushed.
+ */
+CAN_queue_statistics CAN_read_queue_statistics(void){
+    CAN_queue_statistics statistics = CAN_queue_stats;
+
+    for (uint8_t priority = 0; priority < CAN_NUM_PRIORITIES; priority++){
+        statistics.depth[priority] = CAN_tx_count[priority];
+    }
+    return statistics;
+}
+
+/** Function for receiving a message using MCP2515 for CAN communication.
+ *  The RX status is read first, so an empty receive buffer is never read. A full buffer is read in one SPI transaction, RXB0 before RXB1.
+ *  Called by the receive interrupt, the main loop takes frames from the receive ring with CAN_rx_peek.
+ *  @param message* msg - Filled with the message received, unchanged if there was none.
+ *  @return bool - true if a message was received.
+ */
+bool CAN_receive(message* msg){
+    uint8_t status = MCP_rx_status();
+    uint8_t buffer;
+
+    if (status & MCP_RX_STATUS_RXB0) {
+        buffer = 0;
+    }
+    else if (status & MCP_RX_STATUS_RXB1) {
+        buffer = 1;
+    }
+    else {
+        return false;
+    }
+
+    uint8_t frame[MCP_FRAME_MAX_LENGTH];
+    msg->length = MCP_read_rx_buffer(buffer, frame);
+
+    msg->id = MCP_decode_id(&frame[MCP_FRAME_SIDH], &msg->extended);
+
+    for (uint8_t i = 0; i < msg->length; i++){
+        msg->data[i] = frame[MCP_FRAME_HEADER_LENGTH + i];
+    }
+
+    return true;
+}
+
+/** Function for reading every frame the MCP2515 holds into the receive ring.
+ *  When the ring is full the frame is still read, so that the receive buffer is released, and counted as an overflow.
+ */
+static void CAN_rx_drain(void){
+    while (1) {
+        uint8_t count = CAN_rx_head - CAN_rx_tail;
+
+        if (count < CAN_RX_RING_LENGTH) {
+            if (!CAN_receive(&CAN_rx_ring[CAN_rx_head % CAN_RX_RING_LENGTH])) {
+                break;
+            }
+
+            // Publish the frame after it is complete
+            CAN_MEMORY_BARRIER();
+            CAN_rx_head++;
+
+            count++;
+            CAN_rx_stats.received++;
+            if (count > CAN_rx_stats.high_water) {
+                CAN_rx_stats.high_water = count;
+            }
+        }
+        else {
+            message dropped;
+            if (!CAN_receive(&dropped)) {
+                break;
+            }
+            CAN_rx_stats.overflows++;
+        }
+    }
+}
+
+/** Function for draining the receive buffers and enabling the receive interrupt again. Run by the receive interrupt through SPI_bus_run, at once if the bus is free and when the main loop releases it otherwise.
+ */
+static void CAN_rx_service(void){
+    CAN_rx_drain();
+    set_bit(EIMSK, INT4);
+}
+
+/** Function for draining the receive buffers if the MCP2515 holds a frame the interrupt has not taken. Called periodically, as a fallback in case the interrupt is not connected.
+ */
+void CAN_rx_poll(void){
+    SPI_bus_acquire();
+
+    if (MCP_rx_status() & (MCP_RX_STATUS_RXB0 | MCP_RX_STATUS_RXB1)) {
+        uint8_t head = CAN_rx_head;
+        CAN_rx_drain();
+        CAN_rx_stats.polled += (uint8_t)(CAN_rx_head - head);
+    }
+
+    SPI_bus_release();
+}
+
+/** Function for returning the oldest received frame without removing it from the receive ring. The frame stays valid until CAN_rx_release.
+ *  @return message* - The oldest frame, NULL if the ring is empty.
+ */
+message* CAN_rx_peek(void){
+    if (CAN_rx_head == CAN_rx_tail) {
+        return NULL;
+    }
+
+    CAN_MEMORY_BARRIER();
+    return &CAN_rx_ring[CAN_rx_tail % CAN_RX_RING_LENGTH];
+}
+
+/** Function for removing the oldest received frame from the receive ring, when it has been handled.
+ */
+void CAN_rx_release(void){
+    if (CAN_rx_head != CAN_rx_tail) {
+        // Finish reading the frame before the ISR can reuse its slot
+        CAN_MEMORY_BARRIER();
+        CAN_rx_tail++;
+    }
+}
+
+/** Function for returning the receive ring counters.
+ *  @return CAN_rx_statistics - Frames received, frames lost because the ring was full, frames without a handler, the largest number of frames waiting, and frames found by polling.
+ */
+CAN_rx_statistics CAN_read_rx_statistics(void){
+    uint8_t sreg = SREG;
+    cli();
+    CAN_rx_statistics statistics = CAN_rx_stats;
+    SREG = sreg;
+
+    return statistics;
+}
+
+/** Function for setting the receive mode of both receive buffers from the acceptance filter setting.
+ */
+static void CAN_restore_receive_mode(void){
+    uint8_t mode = CAN_filtering ? MCP_RXM_FILTER : MCP_RXM_ANY;
+
+    MCP_set_receive_mode(0, mode);
+    MCP_set_receive_mode(1, mode);
+}
+
+/** Function for registering the handler of a message id. Registering an id again replaces its handler.
+ *  CAN_apply_filters must be called after the handlers are registered.
+ *  @param uint32_t id - Message id.
+ *  @param bool extended - true for a 29 bit extended id.
+ *  @param CAN_handler handler - Function called with each received message with the id.
+ *  @return bool - false if CAN_MAX_HANDLERS ids already have handlers.
+ */
+bool CAN_register_handler(uint32_t id, bool extended, CAN_handler handler){
+    for (uint8_t i = 0; i < CAN_num_handlers; i++){
+        if ((CAN_handlers[i].id == id) && (CAN_handlers[i].extended == extended)) {
+            CAN_handlers[i].handler = handler;
+            return true;
+        }
+    }
+
+    if (CAN_num_handlers >= CAN_MAX_HANDLERS) {
+        return false;
+    }
+
+    CAN_handlers[CAN_num_handlers].id = id;
+    CAN_handlers[CAN_num_handlers].extended = extended;
+    CAN_handlers[CAN_num_handlers].handler = handler;
+    CAN_num_handlers++;
+
+    return true;
+}
+
+/** Function for setting the acceptance filters so that only the ids with handlers reach the MCU.
+ *  Up to MCP_NUM_FILTERS standard ids are matched exactly, the ids registered first use the filters of RXB0. With an extended id every frame is received, and the dispatch table does the filtering.
+ *  @return uint8_t - 0 on success, 1 if the MCP2515 did not enter configuration mode.
+ */
+uint8_t CAN_apply_filters(void){
+    // A mask comparing the extended bits would also compare the first data bytes of standard frames, so extended ids are not filtered in hardware
+    bool filtering = (CAN_num_handlers > 0) && (CAN_num_handlers <= MCP_NUM_FILTERS);
+    for (uint8_t i = 0; i < CAN_num_handlers; i++){
+        if (CAN_handlers[i].extended) {
+            filtering = false;
+        }
+    }
+
+    SPI_bus_acquire();
+    uint8_t mode = MCP_read(MCP_CANSTAT) & MODE_MASK;
+
+    if (MCP_set_mode(MODE_CONFIG)) {
+        SPI_bus_release();
+        return 1;
+    }
+
+    if (filtering) {
+        // Compare all 11 identifier bits, and no data bytes
+        MCP_set_mask(0, MCP_STANDARD_ID_MAX, false);
+        MCP_set_mask(1, MCP_STANDARD_ID_MAX, false);
+
+        // Unused filters repeat the first id
+        for (uint8_t filter = 0; filter < MCP_NUM_FILTERS; filter++){
+            uint8_t i = (filter < CAN_num_handlers) ? filter : 0;
+            MCP_set_filter(filter, CAN_handlers[i].id, false);
+        }
+    }
+
+    CAN_filtering = filtering;
+    CAN_restore_receive_mode();
+
+    MCP_set_mode(mode);
+    SPI_bus_release();
+
+    return 0;
+}
+
+/** Function for handing every frame in the receive ring to the handler of its id. Frames without a handler are counted and dropped.
+ */
+void CAN_dispatch(void){
+    message* msg;
+
+    while ((msg = CAN_rx_peek()) != NULL) {
+        uint8_t i = 0;
+
+        while ((i < CAN_num_handlers) && ((CAN_handlers[i].id != msg->id) || (CAN_handlers[i].extended != msg->extended))) {
+            i++;
+        }
+
+        if (i < CAN_num_handlers) {
+            CAN_handlers[i].handler(msg);
+        }
+        else {
+            CAN_rx_stats.unhandled++;
+        }
+
+        CAN_rx_release();
+    }
+}
+
+/** Function for waiting until a frame is in the receive ring.
+ *  @return message* - The oldest frame, NULL if none was received within CAN_BENCHMARK_TIMEOUT_MS.
+ */
+static message* CAN_rx_wait(void){
+    uint16_t start = timer_ms();
+    message* msg;
+
+    while (((msg = CAN_rx_peek()) == NULL) && (timer_elapsed_ms(start) < CAN_BENCHMARK_TIMEOUT_MS)) {};
+
+    return msg;
+}
+
+/** Function for sending a message by writing each register of TXB0 in a separate transaction. Kept as the reference for the frame transfer benchmark.
+ *  @param message msg - The message to be sent.
+ */
+static void CAN_send_message_registers(message msg){
 
     // Write id for transmit buffers enabled to send to SIDH and SIDL registers
     MCP_write(MCP_TXB0SIDH, (msg.id >> 3));
@@ -57,12 +518,13 @@ void CAN_send_message(message msg){
     MCP_request_to_send(0);
 }
 
-/** Function for receiving a message with a given id and data using MCP2515 for CAN communication.
- *  @return message message - The message received.
+/** Function for receiving a message from RXB0 by reading each register in a separate transaction. Kept as the reference for the frame transfer benchmark.
+ *  @return message msg - The message received.
  */
-message CAN_data_receive(void){
+static message CAN_receive_registers(void){
 
     message msg;
+    msg.extended = false;
 
     // Read message id
     msg.id = (MCP_read(MCP_RXB0SIDH) << 3) | (MCP_read(MCP_RXB0SIDL) >> 5);
@@ -80,18 +542,34 @@ message CAN_data_receive(void){
     return msg;
 }
 
+/** Function for waiting until a frame sent in loopback mode is received.
+ *  @return bool - true if a frame was received within CAN_BENCHMARK_TIMEOUT_MS.
+ */
+static bool CAN_wait_for_frame(void){
+    uint16_t start = timer_ms();
+
+    while (!(MCP_read_status() & (MCP_STATUS_RX0IF | MCP_STATUS_RX1IF))) {
+        if (timer_elapsed_ms(start) >= CAN_BENCHMARK_TIMEOUT_MS) {
+            return false;
+        }
+    }
+    return true;
+}
+
 /** Function for sending GAME OVER via CAN to Node 1.
  *  @param uint8_t GAME_OVER_FLAG - Flag indicating that game is over.
  */
 void CAN_transmit_game_info(uint8_t GAME_OVER_FLAG) {
     message msg;
     msg.length = 2;
-    msg.id = 1;
+    msg.id = CAN_ID_GAME_INFO;
+    msg.extended = false;
 
     //msg.data[0] = score;
     msg.data[1] = GAME_OVER_FLAG;
 
-    CAN_send_message(msg);
+    // Game state goes ahead of any other queued frames
+    CAN_send_message(msg, CAN_PRIORITY_HIGH);
 }
 
 /** Function for testing transmit in loop-back mode.
@@ -101,20 +579,252 @@ void CAN_transmit_game_info(uint8_t GAME_OVER_FLAG) {
     message msg;
 
     msg.id = 1;
+    msg.extended = false;
     msg.length = sizeof(msg.data);
     int stop = 1;
     for(int j = 0; j < 8; j++){
         msg.data[j] = j*2;
     }
     while(stop < 10) {
-        CAN_send_message(msg);
+        CAN_send_message(msg, CAN_PRIORITY_LOW);
+
+        message* received = CAN_rx_wait();
 
-        message received = CAN_data_receive();
-        printf("ID: %d\n\r", received.id);
-        printf("Length : %d\n\r", received.length);
-        for (int i = 0; i < received.length; i++){
-            printf("%d ", received.data[i]);
+        if (received != NULL) {
+            printf("ID: %d\n\r", received->id);
+            printf("Length : %d\n\r", received->length);
+            for (int i = 0; i < received->length; i++){
+                printf("%d ", received->data[i]);
+            }
+            CAN_rx_release();
         }
         stop++;
     }
 }
+
+/** Test function comparing the SPI bytes and time used per frame when a frame is moved register by register, and in one burst transaction. Runs in loopback mode.
+ */
+void test_CAN_frame_transfer(void){
+    message msg;
+    msg.id = 1;
+    msg.extended = false;
+    msg.length = 8;
+    for (uint8_t i = 0; i < msg.length; i++){
+        msg.data[i] = i;
+    }
+
+    // Keep the receive interrupt from taking the frames
+    bool interrupt = CAN_rx_interrupt_block();
+    MCP_bit_modify(MCP_CANCTRL, MODE_MASK, MODE_LOOPBACK);
+
+    // Receive the test frames whatever the filters are
+    MCP_set_receive_mode(0, MCP_RXM_ANY);
+    MCP_set_receive_mode(1, MCP_RXM_ANY);
+
+    for (uint8_t burst = 0; burst < 2; burst++){
+        uint32_t send_bytes = 0;
+        uint32_t send_ticks = 0;
+        uint32_t receive_bytes = 0;
+        uint32_t receive_ticks = 0;
+        uint16_t frames = 0;
+
+        for (uint16_t n = 0; n < CAN_BENCHMARK_FRAMES; n++){
+            uint32_t bytes = SPI_bytes_transferred();
+            uint16_t start = timer_ticks();
+
+            if (burst) {
+                CAN_send_message(msg, CAN_PRIORITY_HIGH);
+            }
+            else {
+                CAN_send_message_registers(msg);
+            }
+
+            send_ticks += (uint16_t)(timer_ticks() - start);
+            send_bytes += SPI_bytes_transferred() - bytes;
+
+            if (!CAN_wait_for_frame()) {
+                break;
+            }
+
+            message received;
+            bytes = SPI_bytes_transferred();
+            start = timer_ticks();
+
+            if (burst) {
+                CAN_receive(&received);
+            }
+            else {
+                received = CAN_receive_registers();
+            }
+
+            receive_ticks += (uint16_t)(timer_ticks() - start);
+            receive_bytes += SPI_bytes_transferred() - bytes;
+            frames++;
+        }
+
+        printf("%s: %u frames\n\r", burst ? "Burst" : "Register by register", frames);
+
+        if (frames > 0) {
+            printf("    Send: %lu bytes, %lu us per frame\n\r", send_bytes / frames, TIMER_TICKS_TO_US(send_ticks) / frames);
+            printf("    Receive: %lu bytes, %lu us per frame\n\r", receive_bytes / frames, TIMER_TICKS_TO_US(receive_ticks) / frames);
+        }
+    }
+
+    CAN_restore_receive_mode();
+    MCP_bit_modify(MCP_CANCTRL, MODE_MASK, MODE_NORMAL);
+    CAN_rx_interrupt_restore(interrupt);
+}
+
+/** Test function measuring in loopback mode the frames per second carried at each bit rate, with 8 byte frames sent through the transmit queue and received in burst transfers.
+ */
+void test_CAN_bitrates(void){
+    const uint32_t bitrates[] = {125000, 250000, 500000, 1000000};
+
+    message msg;
+    msg.id = 1;
+    msg.extended = false;
+    msg.length = 8;
+    for (uint8_t i = 0; i < msg.length; i++){
+        msg.data[i] = i;
+    }
+
+    // Keep the receive interrupt from taking the frames
+    bool interrupt = CAN_rx_interrupt_block();
+    MCP_set_receive_mode(0, MCP_RXM_ANY);
+    MCP_set_receive_mode(1, MCP_RXM_ANY);
+
+    for (uint8_t i = 0; i < sizeof(bitrates)/sizeof(bitrates[0]); i++){
+        MCP_bit_timing timing;
+
+        MCP_set_mode(MODE_CONFIG);
+        if (MCP_set_bit_timing(bitrates[i], &timing)) {
+            printf("%lu bit/s: no bit timing\n\r", bitrates[i]);
+            continue;
+        }
+        MCP_set_mode(MODE_LOOPBACK);
+
+        uint16_t sent = 0;
+        uint16_t received = 0;
+        uint16_t start = timer_ms();
+        uint16_t progress = start;
+
+        while (received < CAN_BITRATE_BENCHMARK_FRAMES) {
+            // Keep the transmit queue from overflowing
+            if ((sent < CAN_BITRATE_BENCHMARK_FRAMES) && ((uint16_t)(sent - received) < CAN_TX_QUEUE_LENGTH)) {
+                CAN_send_message(msg, CAN_PRIORITY_HIGH);
+                sent++;
+            }
+            else {
+                CAN_service_transmit();
+            }
+
+            message frame;
+            while (CAN_receive(&frame)) {
+                received++;
+                progress = timer_ms();
+            }
+
+            if (timer_elapsed_ms(progress) >= CAN_BENCHMARK_TIMEOUT_MS) {
+                break;
+            }
+        }
+
+        uint16_t elapsed = timer_elapsed_ms(start);
+
+        printf("%lu bit/s, %u quanta, sample point %u.%u %%: %u frames in %u ms", timing.bitrate, timing.quanta,
+            timing.sample_point_permille / 10, timing.sample_point_permille % 10, received, elapsed);
+        if (elapsed > 0) {
+            printf(", %lu frames per second", ((uint32_t)received * 1000) / elapsed);
+        }
+        printf("\n\r");
+    }
+
+    MCP_set_mode(MODE_CONFIG);
+    MCP_set_bit_timing(CAN_BITRATE, NULL);
+    CAN_restore_receive_mode();
+    MCP_set_mode(MODE_NORMAL);
+
+    CAN_rx_interrupt_restore(interrupt);
+}
+
+/** Test function for printing the transmit queue depths and counters.
+ */
+void test_CAN_transmit_queue(void){
+    CAN_queue_statistics statistics = CAN_read_queue_statistics();
+
+    printf("Frames sent: %u, flushed %u\n\r", statistics.sent, statistics.flushed);
+    printf("High priority: depth %u, max %u, dropped %u\n\r", statistics.depth[CAN_PRIORITY_HIGH], statistics.max_depth[CAN_PRIORITY_HIGH], statistics.dropped[CAN_PRIORITY_HIGH]);
+    printf("Low priority: depth %u, max %u, dropped %u\n\r", statistics.depth[CAN_PRIORITY_LOW], statistics.max_depth[CAN_PRIORITY_LOW], statistics.dropped[CAN_PRIORITY_LOW]);
+}
+
+/** Test function for printing the receive ring counters.
+ */
+void test_CAN_rx_ring(void){
+    CAN_rx_statistics statistics = CAN_read_rx_statistics();
+
+    printf("Frames received: %u\n\r", statistics.received);
+    printf("Overflows: %u\n\r", statistics.overflows);
+    printf("Without handler: %u\n\r", statistics.unhandled);
+    printf("High water mark: %u of %u\n\r", statistics.high_water, CAN_RX_RING_LENGTH);
+    printf("Found by polling: %u\n\r", statistics.polled);
+}
+
+/** Test function checking in loopback mode that a registered id passes the acceptance filters and another id does not.
+ */
+void test_CAN_acceptance_filters(void){
+    if (CAN_num_handlers == 0) {
+        printf("No handlers registered\n\r");
+        return;
+    }
+
+    // Find a standard id without a handler
+    uint32_t other = MCP_STANDARD_ID_MAX;
+    uint8_t handler = 0;
+    while (handler < CAN_num_handlers) {
+        if (CAN_handlers[handler].id == other) {
+            other--;
+            handler = 0;
+        }
+        else {
+            handler++;
+        }
+    }
+
+    if (!CAN_filtering) {
+        printf("Acceptance filters are off, every id is received\n\r");
+    }
+
+    message msg;
+    msg.extended = false;
+    msg.length = 1;
+    msg.data[0] = 0;
+
+    bool interrupt = CAN_rx_interrupt_block();
+    MCP_bit_modify(MCP_CANCTRL, MODE_MASK, MODE_LOOPBACK);
+
+    const uint32_t ids[2] = {CAN_handlers[0].id, other};
+
+    for (uint8_t i = 0; i < 2; i++){
+        msg.id = ids[i];
+        CAN_send_message(msg, CAN_PRIORITY_HIGH);
+
+        bool received = CAN_wait_for_frame();
+
+        // Empty the receive buffers
+        message dropped;
+        while (CAN_receive(&dropped)) {};
+
+        printf("Id 0x%03lx: %s\n\r", ids[i], received ? "received" : "filtered out");
+    }
+
+    MCP_bit_modify(MCP_CANCTRL, MODE_MASK, MODE_NORMAL);
+    CAN_rx_interrupt_restore(interrupt);
+}
+
+/** Interrupt service routine for the MCP2515 interrupt, moving the received frames to the receive ring.
+ */
+ISR(INT4_vect){
+    // The interrupt is level triggered, so it is disabled until the frames are read
+    clear_bit(EIMSK, INT4);
+    SPI_bus_run(CAN_rx_service);
+}
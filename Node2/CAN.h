@@ -6,6 +6,7 @@
 #ifndef CAN_H
 #define CAN_H
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <avr/io.h>
@@ -13,33 +14,167 @@
 #include <util/delay.h>
 
 #include "MCP2515.h"
+#include "protocol.h"
 #include "SPI.h"
+#include "timer.h"
 
 #include "bit_operations.h"
 
-#define MCP_RX_BUFF_OP_MODE_BITS 0b01100000
-
 /** Struct for message, defining id, length and data byte.
  */
 typedef struct {
-    uint8_t id;
+    // 11 bit standard or 29 bit extended identifier
+    uint32_t id;
+    bool extended;
+
     uint8_t length;
     uint8_t data[8];
 } message;
 
+/** Function pointer type for the handler of a message id. The message is only valid during the call.
+ */
+typedef void (*CAN_handler)(message* msg);
+
+// Message ids that can have a handler, one acceptance filter each
+#define CAN_MAX_HANDLERS 6
+
+// Message ids
+#define CAN_ID_CONTROLLER 0
+#define CAN_ID_GAME_INFO 1
+#define CAN_ID_NODE1_STATUS 2
+#define CAN_ID_NODE2_STATUS 3
+
+// Bit rate of the bus, the MCP2515 bit timing is calculated from it in CAN_init
+#define CAN_BITRATE 500000
+
+// Received frames the receive ring holds, a power of two
+#define CAN_RX_RING_LENGTH 8
+
+/** Struct CAN_rx_statistics representing the counters of the receive ring.
+ */
+typedef struct {
+    uint16_t received;
+    uint16_t overflows;
+    uint16_t unhandled;
+    uint8_t high_water;
+
+    // Frames found by CAN_rx_poll instead of the interrupt. Should stay 0 when the interrupt is wired
+    uint16_t polled;
+} CAN_rx_statistics;
+
+// MCP2515 interrupt output, taken as INT4 on PE4 (pin 2 on the Arduino shield). Not yet checked against the shield schematic.
+// The pin has a pull-up, so it stays high if it is not connected, and CAN_rx_poll takes the frames instead
+#define CAN_INT_PIN PE4
+
+// Frames each priority class can queue while the transmit buffers are busy
+#define CAN_TX_QUEUE_LENGTH 4
+
+/** Enum CAN_priority representing the transmit priority classes. High priority frames are queued and sent ahead of low priority frames.
+ */
+typedef enum {
+    CAN_PRIORITY_LOW,
+    CAN_PRIORITY_HIGH,
+    CAN_NUM_PRIORITIES
+} CAN_priority;
+
+/** Struct CAN_queue_statistics representing the state and counters of the transmit queue.
+ */
+typedef struct {
+    // Frames that left a transmit buffer on the bus, and frames thrown away by CAN_tx_flush or aborted in a transmit buffer
+    uint16_t sent;
+    uint16_t flushed;
+
+    uint16_t dropped[CAN_NUM_PRIORITIES];
+    uint8_t depth[CAN_NUM_PRIORITIES];
+    uint8_t max_depth[CAN_NUM_PRIORITIES];
+} CAN_queue_statistics;
+
+// Frames sent and the longest wait for each frame in the frame transfer benchmark
+#define CAN_BENCHMARK_FRAMES 100
+#define CAN_BENCHMARK_TIMEOUT_MS 10
+
+// Frames sent at each bit rate in the bit rate benchmark
+#define CAN_BITRATE_BENCHMARK_FRAMES 500
+
 /** Function for initializing CAN communication.
  */
 int CAN_init(void);
 
+/** Function for keeping the receive interrupt from taking frames, for the tests that read the receive buffers themselves. Bus transactions of the main loop are protected by SPI_bus_acquire instead.
+ *  @return bool enabled - Whether the interrupt was enabled, passed to CAN_rx_interrupt_restore.
+ */
+bool CAN_rx_interrupt_block(void);
+
+/** Function for enabling the receive interrupt again after CAN_rx_interrupt_block. A frame that arrived meanwhile is taken when the interrupt is enabled, since it is level triggered.
+ *  @param bool enabled - Return value of CAN_rx_interrupt_block.
+ */
+void CAN_rx_interrupt_restore(bool enabled);
+
 /** Function for sending a message with a given id and data using MCP2515 for CAN communication.
+ *  The message is queued behind the frames of its priority class, and moved to a transmit buffer as soon as one is free. High priority frames go ahead of low priority frames.
  *  @param message msg - The message to be sent.
+ *  @param CAN_priority priority - CAN_PRIORITY_HIGH for game state, CAN_PRIORITY_LOW for periodic frames.
+ *  @return bool - true if the message was queued, false if the queue of its class was full and it was dropped.
+ */
+bool CAN_send_message(message msg, CAN_priority priority);
+
+/** Function for registering the handler of a message id. Registering an id again replaces its handler.
+ *  CAN_apply_filters must be called after the handlers are registered.
+ *  @param uint32_t id - Message id.
+ *  @param bool extended - true for a 29 bit extended id.
+ *  @param CAN_handler handler - Function called with each received message with the id.
+ *  @return bool - false if CAN_MAX_HANDLERS ids already have handlers.
  */
-void CAN_send_message(message msg);
+bool CAN_register_handler(uint32_t id, bool extended, CAN_handler handler);
 
-/** Function for receiving a message with a given id and data using MCP2515 for CAN communication.
- *  @return message message - The message received.
+/** Function for setting the acceptance filters so that only the ids with handlers reach the MCU.
+ *  Up to MCP_NUM_FILTERS standard ids are matched exactly, the ids registered first use the filters of RXB0. With an extended id every frame is received, and the dispatch table does the filtering.
+ *  @return uint8_t - 0 on success, 1 if the MCP2515 did not enter configuration mode.
  */
-message CAN_data_receive(void);
+uint8_t CAN_apply_filters(void);
+
+/** Function for draining the receive buffers if the MCP2515 holds a frame the interrupt has not taken. Called periodically, as a fallback in case the interrupt is not connected.
+ */
+void CAN_rx_poll(void);
+
+/** Function for handing every frame in the receive ring to the handler of its id. Frames without a handler are counted and dropped.
+ */
+void CAN_dispatch(void);
+
+/** Function for returning the oldest received frame without removing it from the receive ring. The frame stays valid until CAN_rx_release.
+ *  @return message* - The oldest frame, NULL if the ring is empty.
+ */
+message* CAN_rx_peek(void);
+
+/** Function for removing the oldest received frame from the receive ring, when it has been handled.
+ */
+void CAN_rx_release(void);
+
+/** Function for returning the receive ring counters.
+ *  @return CAN_rx_statistics - Frames received, frames lost because the ring was full, frames without a handler, the largest number of frames waiting, and frames found by polling.
+ */
+CAN_rx_statistics CAN_read_rx_statistics(void);
+
+/** Function for moving queued frames to free transmit buffers, high priority frames first. Called by CAN_send_message, and periodically to empty the queue and count the frames that have gone out.
+ */
+void CAN_service_transmit(void);
+
+/** Function for emptying the transmit queues of both priority classes, e.g. on bus-off, so that old frames are not sent when the bus comes back. Frames already in a transmit buffer must be aborted with ABORT_TX.
+ */
+void CAN_tx_flush(void);
+
+/** Function for returning the transmit queue depths and counters.
+ *  @return CAN_queue_statistics - Current and largest depth and drops of each priority class, and frames sent and flushed.
+ */
+CAN_queue_statistics CAN_read_queue_statistics(void);
+
+/** Function for receiving a message using MCP2515 for CAN communication.
+ *  The RX status is read first, so an empty receive buffer is never read. A full buffer is read in one SPI transaction, RXB0 before RXB1.
+ *  Called by the receive interrupt, the main loop takes frames from the receive ring with CAN_rx_peek.
+ *  @param message* msg - Filled with the message received, unchanged if there was none.
+ *  @return bool - true if a message was received.
+ */
+bool CAN_receive(message* msg);
 
 /** Function for sending GAME OVER via CAN to Node 1.
  *  @param uint8_t GAME_OVER_FLAG - Flag indicating that game is over.
@@ -50,5 +185,24 @@ void CAN_transmit_game_info(uint8_t GAME_OVER_FLAG);
  */
  void CAN_transmit_loopback_test(void);
 
+/** Test function comparing the SPI bytes and time used per frame when a frame is moved register by register, and in one burst transaction. Runs in loopback mode.
+ */
+void test_CAN_frame_transfer(void);
+
+/** Test function measuring in loopback mode the frames per second carried at each bit rate, with 8 byte frames sent through the transmit queue and received in burst transfers.
+ */
+void test_CAN_bitrates(void);
+
+/** Test function for printing the transmit queue depths and counters.
+ */
+void test_CAN_transmit_queue(void);
+
+/** Test function for printing the receive ring counters.
+ */
+void test_CAN_rx_ring(void);
+
+/** Test function checking in loopback mode that a registered id passes the acceptance filters and another id does not.
+ */
+void test_CAN_acceptance_filters(void);
 
 #endif
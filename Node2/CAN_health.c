@@ -0,0 +1,256 @@
+/** @file CAN_health.c
+ *  @brief C-file for the CAN bus health monitor. Samples the MCP2515 error counters and flags, counts receive overflows, estimates frame rates and bus load, and recovers from bus-off.
+ *  The status frame of the other node is kept, see CAN_health_register_peer.
+ *  The file is the same on both nodes, tests/Makefile checks that the copies are equal.
+ *  @authors: Anastasia Lindbäck and Marie Skatvedt
+ */
+
+#include "CAN_health.h"
+
+static CAN_health_statistics CAN_health;
+
+// Set while in bus-off, and when bus-off was entered or the MCP2515 was last reset
+static bool CAN_health_bus_off = false;
+static uint16_t CAN_health_bus_off_time = 0;
+
+// Samples taken in the current rate window, when it started, and the frame counters at its start
+static uint8_t CAN_health_samples = 0;
+static uint16_t CAN_health_window_start = 0;
+static uint16_t CAN_health_window_received = 0;
+static uint16_t CAN_health_window_sent = 0;
+
+// Last status frame of the other node
+static CAN_health_peer_status CAN_health_peer;
+
+/** Function for finding the fault confinement state from the error flags.
+ *  @param uint8_t flags - EFLG.
+ *  @return CAN_error_state - The state.
+ */
+static CAN_error_state CAN_health_state(uint8_t flags) {
+    if (flags & MCP_EFLG_TXBO) {
+        return CAN_STATE_BUS_OFF;
+    }
+    if (flags & (MCP_EFLG_TXEP | MCP_EFLG_RXEP)) {
+        return CAN_STATE_PASSIVE;
+    }
+    if (flags & MCP_EFLG_EWARN) {
+        return CAN_STATE_WARNING;
+    }
+    return CAN_STATE_ACTIVE;
+}
+
+/** Function for limiting a counter to one byte of the status frame.
+ *  @param uint16_t value - The counter.
+ *  @return uint8_t - The counter, at most 255.
+ */
+static uint8_t CAN_health_saturate(uint16_t value) {
+    return (value > 0xFF) ? 0xFF : value;
+}
+
+/** Function for starting a new rate window at the current frame counters.
+ */
+static void CAN_health_start_window(void) {
+    CAN_health_samples = 0;
+    CAN_health_window_start = timer_ms();
+    CAN_health_window_received = CAN_read_rx_statistics().received;
+    CAN_health_window_sent = CAN_read_queue_statistics().sent;
+}
+
+/** Function for updating the frame rates and bus load from the frames counted in the rate window.
+ */
+static void CAN_health_update_rates(void) {
+    uint16_t elapsed = timer_elapsed_ms(CAN_health_window_start);
+    uint16_t received = CAN_read_rx_statistics().received - CAN_health_window_received;
+    uint16_t sent = CAN_read_queue_statistics().sent - CAN_health_window_sent;
+
+    if (elapsed == 0) {
+        return;
+    }
+
+    CAN_health.rx_fps = ((uint32_t)received * 1000) / elapsed;
+    CAN_health.tx_fps = ((uint32_t)sent * 1000) / elapsed;
+
+    uint32_t bits = ((uint32_t)CAN_health.rx_fps + CAN_health.tx_fps) * CAN_HEALTH_FRAME_BITS;
+    CAN_health.bus_load_permille = (bits * 1000) / CAN_BITRATE;
+}
+
+/** Function for clearing the counters and starting the first rate window. CAN_init must be called first.
+ */
+void CAN_health_init(void) {
+    CAN_health = (CAN_health_statistics){0};
+    CAN_health_bus_off = false;
+
+    CAN_health_start_window();
+}
+
+/** Function for reading the error counters and flags, and recovering from bus-off. Called every CAN_HEALTH_PERIOD_MS.
+ *  In bus-off the pending transmissions are aborted, and the MCP2515 is reset if it has not recovered within CAN_HEALTH_BUS_OFF_RESET_MS.
+ *  @return bool - true when a rate window has been completed, and the rates are updated.
+ */
+bool CAN_health_sample(void) {
+    SPI_bus_acquire();
+
+    uint8_t tec = MCP_read(MCP_TEC);
+    uint8_t rec = MCP_read(MCP_REC);
+    uint8_t flags = MCP_read(MCP_EFLG);
+
+    // The overflow flags stay set until cleared
+    if (flags & MCP_EFLG_RXOVR) {
+        MCP_bit_modify(MCP_EFLG, MCP_EFLG_RXOVR, 0);
+    }
+
+    SPI_bus_release();
+
+    if (flags & MCP_EFLG_RX0OVR) {
+        CAN_health.rx_overflows++;
+    }
+    if (flags & MCP_EFLG_RX1OVR) {
+        CAN_health.rx_overflows++;
+    }
+
+    CAN_health.tec = tec;
+    CAN_health.rec = rec;
+    CAN_health.error_flags = flags;
+    CAN_health.state = CAN_health_state(flags);
+
+    if (tec > CAN_health.tec_max) {
+        CAN_health.tec_max = tec;
+    }
+    if (rec > CAN_health.rec_max) {
+        CAN_health.rec_max = rec;
+    }
+
+    if (CAN_health.state == CAN_STATE_BUS_OFF) {
+        if (!CAN_health_bus_off) {
+            // Drop the pending frames, so that old controller state is not sent when the bus comes back
+            CAN_health_bus_off = true;
+            CAN_health_bus_off_time = timer_ms();
+            CAN_health.bus_off_events++;
+
+            SPI_bus_acquire();
+            MCP_bit_modify(MCP_CANCTRL, ABORT_TX, ABORT_TX);
+            SPI_bus_release();
+            CAN_tx_flush();
+        }
+        else if (timer_elapsed_ms(CAN_health_bus_off_time) >= CAN_HEALTH_BUS_OFF_RESET_MS) {
+            // The MCP2515 recovers by itself after 128 x 11 recessive bits. Reset it if the bus is never quiet that long
+            CAN_health_bus_off_time = timer_ms();
+            CAN_health.resets++;
+
+            SPI_bus_acquire();
+            CAN_init();
+            CAN_apply_filters();
+            SPI_bus_release();
+        }
+    }
+    else if (CAN_health_bus_off) {
+        CAN_health_bus_off = false;
+        CAN_health.recoveries++;
+
+        SPI_bus_acquire();
+        MCP_bit_modify(MCP_CANCTRL, ABORT_TX, 0);
+        SPI_bus_release();
+    }
+
+    CAN_health_samples++;
+    if (CAN_health_samples < CAN_HEALTH_WINDOW_SAMPLES) {
+        return false;
+    }
+
+    CAN_health_update_rates();
+    CAN_health_start_window();
+
+    return true;
+}
+
+/** Function for returning the health counters.
+ *  @return CAN_health_statistics - Error state, counters and rates.
+ */
+CAN_health_statistics CAN_read_health_statistics(void) {
+    return CAN_health;
+}
+
+/** Function for keeping a status frame of the other node.
+ *  @param message* msg - The status frame.
+ */
+static void CAN_health_peer_received(message* msg) {
+    if (msg->length < CAN_HEALTH_STATUS_LENGTH) {
+        return;
+    }
+
+    CAN_health_peer.received++;
+    CAN_health_peer.time = timer_ms();
+
+    CAN_health_peer.tec = msg->data[CAN_HEALTH_STATUS_TEC];
+    CAN_health_peer.rec = msg->data[CAN_HEALTH_STATUS_REC];
+    CAN_health_peer.error_flags = msg->data[CAN_HEALTH_STATUS_FLAGS];
+    CAN_health_peer.bus_load_percent = msg->data[CAN_HEALTH_STATUS_LOAD];
+    CAN_health_peer.rx_fps = msg->data[CAN_HEALTH_STATUS_RX_FPS];
+    CAN_health_peer.tx_fps = msg->data[CAN_HEALTH_STATUS_TX_FPS];
+    CAN_health_peer.bus_off_events = msg->data[CAN_HEALTH_STATUS_BUS_OFF];
+    CAN_health_peer.overflows = msg->data[CAN_HEALTH_STATUS_OVERFLOWS];
+}
+
+/** Function for registering the handler of the status frames of the other node. CAN_apply_filters must be called after.
+ *  @param uint32_t id - Status id of the other node.
+ *  @return bool - false if there is no free handler.
+ */
+bool CAN_health_register_peer(uint32_t id) {
+    CAN_health_peer = (CAN_health_peer_status){0};
+    return CAN_register_handler(id, false, CAN_health_peer_received);
+}
+
+/** Function for returning the last status received from the other node.
+ *  @return CAN_health_peer_status - The status, received is 0 if none has arrived.
+ */
+CAN_health_peer_status CAN_read_peer_status(void) {
+    return CAN_health_peer;
+}
+
+/** Function for packing the health counters into a status frame and queuing it.
+ *  @param uint32_t id - Status id of this node.
+ *  @return bool - true if the frame was queued.
+ */
+bool CAN_health_transmit_status(uint32_t id) {
+    CAN_rx_statistics rx = CAN_read_rx_statistics();
+
+    message msg;
+    msg.id = id;
+    msg.extended = false;
+    msg.length = CAN_HEALTH_STATUS_LENGTH;
+
+    msg.data[CAN_HEALTH_STATUS_TEC] = CAN_health.tec;
+    msg.data[CAN_HEALTH_STATUS_REC] = CAN_health.rec;
+    msg.data[CAN_HEALTH_STATUS_FLAGS] = CAN_health.error_flags;
+    msg.data[CAN_HEALTH_STATUS_LOAD] = CAN_health_saturate((CAN_health.bus_load_permille + 5) / 10);
+    msg.data[CAN_HEALTH_STATUS_RX_FPS] = CAN_health_saturate(CAN_health.rx_fps);
+    msg.data[CAN_HEALTH_STATUS_TX_FPS] = CAN_health_saturate(CAN_health.tx_fps);
+    msg.data[CAN_HEALTH_STATUS_BUS_OFF] = CAN_health_saturate(CAN_health.bus_off_events);
+    msg.data[CAN_HEALTH_STATUS_OVERFLOWS] = CAN_health_saturate(CAN_health.rx_overflows + rx.overflows);
+
+    return CAN_send_message(msg, CAN_PRIORITY_LOW);
+}
+
+/** Test function for printing the health counters, and the last status of the other node, over UART.
+ */
+void test_CAN_health_statistics(void) {
+    const char* states[] = {"ACTIVE", "WARNING", "PASSIVE", "BUS-OFF"};
+    CAN_rx_statistics rx = CAN_read_rx_statistics();
+
+    printf("State: %s, EFLG: 0x%02x\n\r", states[CAN_health.state], CAN_health.error_flags);
+    printf("TEC: %u (max %u), REC: %u (max %u)\n\r", CAN_health.tec, CAN_health.tec_max, CAN_health.rec, CAN_health.rec_max);
+    printf("Overflows: %u in MCP2515, %u in ring\n\r", CAN_health.rx_overflows, rx.overflows);
+    printf("Bus-off: %u, resets: %u, recoveries: %u\n\r", CAN_health.bus_off_events, CAN_health.resets, CAN_health.recoveries);
+    printf("Received: %u fps, sent: %u fps\n\r", CAN_health.rx_fps, CAN_health.tx_fps);
+    printf("Bus load: %u.%u %%\n\r", CAN_health.bus_load_permille / 10, CAN_health.bus_load_permille % 10);
+
+    if (CAN_health_peer.received == 0) {
+        printf("No status from the other node\n\r");
+        return;
+    }
+
+    printf("Other node, %u ms ago (%u status frames):\n\r", timer_elapsed_ms(CAN_health_peer.time), CAN_health_peer.received);
+    printf("    EFLG: 0x%02x, TEC: %u, REC: %u\n\r", CAN_health_peer.error_flags, CAN_health_peer.tec, CAN_health_peer.rec);
+    printf("    Received: %u fps, sent: %u fps, bus load: %u %%\n\r", CAN_health_peer.rx_fps, CAN_health_peer.tx_fps, CAN_health_peer.bus_load_percent);
+    printf("    Bus-off: %u, overflows: %u\n\r", CAN_health_peer.bus_off_events, CAN_health_peer.overflows);
+}
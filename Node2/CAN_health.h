@@ -0,0 +1,139 @@
+/** @file CAN_health.h
+ *  @brief Header-file for the CAN bus health monitor. Samples the MCP2515 error counters and flags, counts receive overflows, estimates frame rates and bus load, and recovers from bus-off.
+ *  The status frame of the other node is kept, see CAN_health_register_peer.
+ *  The file is the same on both nodes, tests/Makefile checks that the copies are equal.
+ *  @authors: Anastasia Lindbäck and Marie Skatvedt
+ */
+
+#ifndef CAN_HEALTH_H
+#define CAN_HEALTH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "CAN.h"
+#include "MCP2515.h"
+#include "timer.h"
+
+// Time between samples, and samples per rate window
+#define CAN_HEALTH_PERIOD_MS 100
+#define CAN_HEALTH_WINDOW_SAMPLES 10
+
+// Time in bus-off before the MCP2515 is reset, if it has not recovered by itself
+#define CAN_HEALTH_BUS_OFF_RESET_MS 500
+
+// Bits of a standard frame with 8 data bytes, without stuffing. Used for the bus load estimate
+#define CAN_HEALTH_FRAME_BITS 111
+
+/* Status frame layout:
+ *  byte 0 - transmit error counter
+ *  byte 1 - receive error counter
+ *  byte 2 - error flags (EFLG) of the last sample
+ *  byte 3 - bus load in percent
+ *  byte 4 - frames received per second
+ *  byte 5 - frames sent per second
+ *  byte 6 - bus-off events
+ *  byte 7 - receive overflows in the MCP2515 and the receive ring
+ *  Counters are limited to 255.
+ */
+#define CAN_HEALTH_STATUS_TEC 0
+#define CAN_HEALTH_STATUS_REC 1
+#define CAN_HEALTH_STATUS_FLAGS 2
+#define CAN_HEALTH_STATUS_LOAD 3
+#define CAN_HEALTH_STATUS_RX_FPS 4
+#define CAN_HEALTH_STATUS_TX_FPS 5
+#define CAN_HEALTH_STATUS_BUS_OFF 6
+#define CAN_HEALTH_STATUS_OVERFLOWS 7
+#define CAN_HEALTH_STATUS_LENGTH 8
+
+/** Enum CAN_error_state representing the fault confinement state of the MCP2515.
+ */
+typedef enum {
+    CAN_STATE_ACTIVE,
+    CAN_STATE_WARNING,
+    CAN_STATE_PASSIVE,
+    CAN_STATE_BUS_OFF
+} CAN_error_state;
+
+/** Struct CAN_health_statistics representing the error counters, flags and rates of the bus.
+ */
+typedef struct {
+    CAN_error_state state;
+    uint8_t error_flags;
+
+    // Error counters at the last sample, and their largest values
+    uint8_t tec;
+    uint8_t rec;
+    uint8_t tec_max;
+    uint8_t rec_max;
+
+    // Frames lost because both receive buffers of the MCP2515 were full
+    uint16_t rx_overflows;
+
+    uint16_t bus_off_events;
+    uint16_t resets;
+    uint16_t recoveries;
+
+    // Frames received and sent by this node, over the last rate window
+    uint16_t rx_fps;
+    uint16_t tx_fps;
+    uint16_t bus_load_permille;
+} CAN_health_statistics;
+
+/** Struct CAN_health_peer_status representing the last status frame received from the other node.
+ */
+typedef struct {
+    // Status frames received, 0 if none has arrived
+    uint16_t received;
+
+    // When the last status frame arrived
+    uint16_t time;
+
+    uint8_t tec;
+    uint8_t rec;
+    uint8_t error_flags;
+    uint8_t bus_load_percent;
+    uint8_t rx_fps;
+    uint8_t tx_fps;
+    uint8_t bus_off_events;
+    uint8_t overflows;
+} CAN_health_peer_status;
+
+/** Function for clearing the counters and starting the first rate window. CAN_init must be called first.
+ */
+void CAN_health_init(void);
+
+/** Function for reading the error counters and flags, and recovering from bus-off. Called every CAN_HEALTH_PERIOD_MS.
+ *  In bus-off the pending transmissions are aborted, and the MCP2515 is reset if it has not recovered within CAN_HEALTH_BUS_OFF_RESET_MS.
+ *  @return bool - true when a rate window has been completed, and the rates are updated.
+ */
+bool CAN_health_sample(void);
+
+/** Function for returning the health counters.
+ *  @return CAN_health_statistics - Error state, counters and rates.
+ */
+CAN_health_statistics CAN_read_health_statistics(void);
+
+/** Function for registering the handler of the status frames of the other node. CAN_apply_filters must be called after.
+ *  @param uint32_t id - Status id of the other node.
+ *  @return bool - false if there is no free handler.
+ */
+bool CAN_health_register_peer(uint32_t id);
+
+/** Function for returning the last status received from the other node.
+ *  @return CAN_health_peer_status - The status, received is 0 if none has arrived.
+ */
+CAN_health_peer_status CAN_read_peer_status(void);
+
+/** Function for packing the health counters into a status frame and queuing it.
+ *  @param uint32_t id - Status id of this node.
+ *  @return bool - true if the frame was queued.
+ */
+bool CAN_health_transmit_status(uint32_t id);
+
+/** Test function for printing the health counters, and the last status of the other node, over UART.
+ */
+void test_CAN_health_statistics(void);
+
+#endif
@@ -33,6 +33,11 @@ uint16_t IR_read_photodiode(void);
  */
 uint16_t IR_read_filtered_photodiode(void);
 
+/** Function for counting number of goals performed.
+ *  @return int goals - Number of goals counted this round.
+ */
+int counting_goals(void);
+
 /** Function for resetting goals.
  */
 void reset_goals(void);
@@ -15,6 +15,7 @@ Copyright 2003 Kimberly Otten Software Consulting
 
 // Define MCP2515 register addresses
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <avr/io.h>
@@ -73,6 +74,8 @@ Copyright 2003 Kimberly Otten Software Consulting
 #define MCP_TXB0D       0x36
 #define MCP_TXB1CTRL	0x40
 #define MCP_TXB2CTRL	0x50
+#define MCP_TXB_CTRL(n)	(MCP_TXB0CTRL + 0x10*(n))
+#define MCP_NUM_TX_BUFFERS	3
 #define MCP_RXB0CTRL	0x60
 #define MCP_RXB0DLC	    0x65 
 #define MCP_RXB0D	    0x66
@@ -80,6 +83,11 @@ Copyright 2003 Kimberly Otten Software Consulting
 #define MCP_RXB0SIDL	0x62
 #define MCP_RXB1CTRL	0x70
 #define MCP_RXB1SIDH	0x71
+#define MCP_RXF_SIDH(n)	(((n) < 3) ? (4*(n)) : (0x10 + 4*((n) - 3)))
+#define MCP_RXM_SIDH(n)	(MCP_RXM0SIDH + 4*(n))
+#define MCP_RXB_CTRL(n)	(MCP_RXB0CTRL + 0x10*(n))
+#define MCP_NUM_FILTERS	6
+#define MCP_NUM_MASKS	2
 
 
 #define MCP_INT_MASK    0x03
@@ -171,6 +179,100 @@ Copyright 2003 Kimberly Otten Software Consulting
 #define MCP_WAKIF		0x40
 #define MCP_MERRF		0x80
 
+// EFLG Register Bits
+
+#define MCP_EFLG_EWARN		0x01
+#define MCP_EFLG_RXWAR		0x02
+#define MCP_EFLG_TXWAR		0x04
+#define MCP_EFLG_RXEP		0x08
+#define MCP_EFLG_TXEP		0x10
+#define MCP_EFLG_TXBO		0x20
+#define MCP_EFLG_RX0OVR		0x40
+#define MCP_EFLG_RX1OVR		0x80
+#define MCP_EFLG_RXOVR		0xC0
+
+// CANSTAT reads, 100 us apart, waiting for a mode change
+#define MCP_MODE_POLLS		100
+
+// RXBnCTRL receive mode, filtered or every message
+#define MCP_RXM_MASK		0x60
+#define MCP_RXM_FILTER		0x00
+#define MCP_RXM_ANY			0x60
+
+// SIDL extended identifier bit, IDE in received frames and EXIDE in transmit buffers and filters
+#define MCP_SIDL_IDE		0x08
+
+// Largest identifiers
+#define MCP_STANDARD_ID_MAX	0x7FF
+#define MCP_EXTENDED_ID_MAX	0x1FFFFFFF
+
+// RXB0CTRL rollover, a message arriving while RXB0 is full is written to RXB1
+#define MCP_RXB0CTRL_BUKT	0x04
+
+// READ STATUS bits
+#define MCP_STATUS_RX0IF	0x01
+#define MCP_STATUS_RX1IF	0x02
+#define MCP_STATUS_TX0REQ	0x04
+#define MCP_STATUS_TX1REQ	0x10
+#define MCP_STATUS_TX2REQ	0x40
+#define MCP_STATUS_TXREQ(n)	(MCP_STATUS_TX0REQ << (2*(n)))
+
+// TXBnCTRL transmit priority, the buffer with the highest TXP is sent first, and the highest buffer number at equal TXP
+#define MCP_TXP_MASK		0x03
+#define MCP_TXP_LOWEST		0x00
+#define MCP_TXP_HIGHEST		0x03
+
+// TXBnCTRL abort flag, set when the frame in the buffer was aborted instead of sent. Cleared when the buffer is requested again
+#define MCP_TXB_ABTF		0x40
+
+// RX STATUS bits
+#define MCP_RX_STATUS_RXB0	0x40
+#define MCP_RX_STATUS_RXB1	0x80
+
+// Oscillator of the MCP2515
+#define MCP_OSCILLATOR_HZ	16000000
+
+// Bit timing limits. A bit is 8-25 time quanta of 2*(BRP+1)/Fosc, the segments are given in time quanta
+#define MCP_MIN_QUANTA		8
+#define MCP_MAX_QUANTA		25
+#define MCP_MAX_BRP			63
+#define MCP_MAX_SEGMENT		8
+#define MCP_MIN_PS2			2
+#define MCP_MAX_SJW			4
+
+// Sample point aimed for, and the largest bit rate error accepted, in per mille
+#define MCP_SAMPLE_POINT_PERMILLE	875
+#define MCP_MAX_RATE_ERROR_PERMILLE	5
+
+/** Struct MCP_bit_timing representing the bit timing for one bit rate, and the CNF register values giving it.
+ */
+typedef struct {
+    uint8_t brp;
+    uint8_t quanta;
+    uint8_t prop_seg;
+    uint8_t phase_seg1;
+    uint8_t phase_seg2;
+    uint8_t sjw;
+
+    uint32_t bitrate;
+    uint16_t sample_point_permille;
+
+    uint8_t cnf1;
+    uint8_t cnf2;
+    uint8_t cnf3;
+} MCP_bit_timing;
+
+// Frame layout used by the READ RX BUFFER and LOAD TX BUFFER instructions
+#define MCP_FRAME_SIDH			0
+#define MCP_FRAME_SIDL			1
+#define MCP_FRAME_EID8			2
+#define MCP_FRAME_EID0			3
+#define MCP_FRAME_DLC			4
+#define MCP_FRAME_HEADER_LENGTH	5
+#define MCP_FRAME_MAX_DATA		8
+#define MCP_FRAME_MAX_LENGTH	(MCP_FRAME_HEADER_LENGTH + MCP_FRAME_MAX_DATA)
+#define MCP_DLC_MASK			0x0F
+
 // Select CAN
 #define CAN_CS PB7
 #define SS PB0
@@ -180,37 +282,115 @@ Copyright 2003 Kimberly Otten Software Consulting
 
 
 /** Function for initializing MCP and checking if it is in configuration mode.
- * @return uint8_t 
+ *  @return uint8_t
  */
 uint8_t MCP_init(void);
 
 
-/** Function for reading data stored at spesific address from MCP2515.
- * @param uint8_t address - Select address you want data from
- * @return uint8_t character result - The data stored at address selected
+/** Function for reading data stored at specific address from MCP2515.
+ * @param uint8_t address - Select address you want data from.
+ * @return uint8_t character result - The data stored at address selected.
  */
 uint8_t MCP_read(uint8_t address);
 
-/** Function for writing data address of the MCP2515
+/** Function for writing data address of the MCP2515.
  * @param char data
  * @param uint8_t address
  */
 void MCP_write(uint8_t address, char data);
 
-/** Function for initiating message transmission for one or more of the transmit buffers.
+/** Function for initiating message transmission for one of the transmit buffers.
+ * @param uint8_t buffer - Transmit buffer (0-2). Any other value requests transmission on all buffers.
  */
-void MCP_request_to_send(uint8_t bit);
+void MCP_request_to_send(uint8_t buffer);
 
-/** Function for allowing single instruction access to some of the often used status bits
- * for message reception and transmission. 
- * @return uint8_t status - Status for the MCP
+/** Function for allowing single instruction access to some of the often used status bits for message reception and transmission.
+ * @return uint8_t status - Status for the MCP.
  */
 uint8_t MCP_read_status(void);
 
-/** Function for setting or clearing individual bits in specific status and control registers. 
- * @param uint8_t address - The address of the register you want to modify
- * @param uint8_t mask - Mask determines which bit in register will be allowed to change
- * @param uint8_t data - Data byte determines what value the modified bits in the register will be changed to. 
+/** Function for reading the receive status, telling which receive buffers hold a message.
+ * @return uint8_t status - MCP_RX_STATUS_RXB0 and MCP_RX_STATUS_RXB1 are set for full buffers.
+ */
+uint8_t MCP_rx_status(void);
+
+/** Function for reading a received frame in one transaction with the READ RX BUFFER instruction. Only the data bytes given by DLC are read.
+ *  The receive flag of the buffer is cleared by the MCP2515 when the transaction ends.
+ * @param uint8_t buffer - Receive buffer (0-1).
+ * @param uint8_t* frame - Filled with SIDH, SIDL, EID8, EID0, DLC and the data bytes, at least MCP_FRAME_MAX_LENGTH bytes.
+ * @return uint8_t length - Number of data bytes read (0-8).
+ */
+uint8_t MCP_read_rx_buffer(uint8_t buffer, uint8_t* frame);
+
+/** Function for writing a frame to a transmit buffer in one transaction with the LOAD TX BUFFER instruction.
+ * @param uint8_t buffer - Transmit buffer (0-2).
+ * @param const uint8_t* frame - SIDH, SIDL, EID8, EID0, DLC followed by the data bytes.
+ * @param uint8_t length - Number of data bytes (0-8).
+ */
+void MCP_load_tx_buffer(uint8_t buffer, const uint8_t* frame, uint8_t length);
+
+/** Function for changing operation mode, and waiting until the MCP2515 reports the new mode.
+ * @param uint8_t mode - MODE_NORMAL, MODE_LOOPBACK, MODE_CONFIG etc.
+ * @return uint8_t - 0 when the mode is entered, 1 if the MCP2515 did not enter it.
+ */
+uint8_t MCP_set_mode(uint8_t mode);
+
+/** Function for encoding an identifier into the SIDH, SIDL, EID8 and EID0 register layout.
+ * @param uint32_t id - 11 bit standard or 29 bit extended identifier.
+ * @param bool extended - true for an extended identifier.
+ * @param uint8_t* bytes - Filled with SIDH, SIDL, EID8 and EID0.
+ */
+void MCP_encode_id(uint32_t id, bool extended, uint8_t* bytes);
+
+/** Function for decoding an identifier from the SIDH, SIDL, EID8 and EID0 register layout of a received frame.
+ * @param const uint8_t* bytes - SIDH, SIDL, EID8 and EID0.
+ * @param bool* extended - Set to true for an extended identifier.
+ * @return uint32_t id - 11 bit standard or 29 bit extended identifier.
+ */
+uint32_t MCP_decode_id(const uint8_t* bytes, bool* extended);
+
+/** Function for setting one of the acceptance filters. The MCP2515 must be in configuration mode.
+ *  Filters 0-1 belong to RXB0 and mask 0, filters 2-5 to RXB1 and mask 1.
+ * @param uint8_t filter - Filter (0-5).
+ * @param uint32_t id - Identifier accepted by the filter.
+ * @param bool extended - true to accept extended frames only, false for standard frames only.
+ */
+void MCP_set_filter(uint8_t filter, uint32_t id, bool extended);
+
+/** Function for setting one of the acceptance masks. The MCP2515 must be in configuration mode.
+ *  A set bit compares that identifier bit with the filters. For standard frames the EID8 and EID0 bits are compared with data byte 0 and 1, so they must be cleared to filter on the identifier only.
+ * @param uint8_t mask - Mask (0-1).
+ * @param uint32_t bits - Identifier bits to compare, in the layout of an extended identifier if extended is set.
+ * @param bool extended - true to also compare the 18 extended identifier bits.
+ */
+void MCP_set_mask(uint8_t mask, uint32_t bits, bool extended);
+
+/** Function for choosing whether a receive buffer uses the acceptance filters or receives every message.
+ * @param uint8_t buffer - Receive buffer (0-1).
+ * @param uint8_t mode - MCP_RXM_FILTER or MCP_RXM_ANY.
+ */
+void MCP_set_receive_mode(uint8_t buffer, uint8_t mode);
+
+/** Function for finding the bit timing closest to a bit rate, with the sample point near MCP_SAMPLE_POINT_PERMILLE.
+ * The most time quanta per bit are used among the settings with the smallest rate error.
+ * @param uint32_t oscillator - Oscillator frequency of the MCP2515 in Hz.
+ * @param uint32_t bitrate - Wanted bit rate in bit/s.
+ * @param MCP_bit_timing* timing - Filled with the segments, the resulting bit rate and sample point, and the CNF register values.
+ * @return uint8_t - 0 on success, 1 if no setting is within MCP_MAX_RATE_ERROR_PERMILLE of the bit rate.
+ */
+uint8_t MCP_calculate_bit_timing(uint32_t oscillator, uint32_t bitrate, MCP_bit_timing* timing);
+
+/** Function for setting the bit rate. The MCP2515 must be in configuration mode.
+ * @param uint32_t bitrate - Wanted bit rate in bit/s.
+ * @param MCP_bit_timing* timing - Filled with the timing used, may be NULL.
+ * @return uint8_t - 0 on success, 1 if the bit rate can not be made from MCP_OSCILLATOR_HZ. The CNF registers are then unchanged.
+ */
+uint8_t MCP_set_bit_timing(uint32_t bitrate, MCP_bit_timing* timing);
+
+/** Function for setting or clearing individual bits in specific status and control registers.
+ * @param uint8_t address - The address of the register you want to modify.
+ * @param uint8_t mask - Mask determines which bit in register will be allowed to change.
+ * @param uint8_t data - Data byte determines what value the modified bits in the register will be changed to.
  */
 void MCP_bit_modify(uint8_t address, uint8_t mask, uint8_t data);
 
@@ -5,8 +5,6 @@
 
 #include "PID.h"
 
-int PID_FLAG = 0;
-
 #define ERROR_SLACK 15
 #define EDGE_SLACK 30
 #define MAX_RESOLUTION 255
@@ -19,29 +17,23 @@ void PID_init(PID* pid) {
 
     // Initializing error variables to zero from start
     PID_reset(pid);
-
-    cli();
-
-    // Enabling timer
-	// Using normal mode
-	set_bit(TCCR3B, CS31);
-
-	// Enable timer interrupt
-	set_bit(TIMSK3, TOIE3);
-
-	sei();
-
-	_delay_ms(500);
-
 }
 
 /** Function for resetting the PID-controller.
  * @param PID* pid - PID controller
  */
 void PID_reset(PID* pid) {
-    pid->last_error = 0;
+    for (uint8_t i = 0; i < PID_RATE_SCALE; i++) {
+        pid->errors[i] = 0;
+    }
+    pid->error_index = 0;
     pid->sum_errors = 0;
 
+    pid->reference = 0;
+    pid->process = 0;
+    pid->error = 0;
+    pid->control = 0;
+
     PID_set_parameters(pid, EASY);
 }
 
@@ -69,17 +61,20 @@ int16_t PID_calculate_control(uint8_t reference_value, uint8_t process_value, PI
     // Calculate P term
     p_term = pid->K_p * error;
 
-    // Calculcate I term
+    // Calculcate I term, the sum is scaled to the tuned period
     if (abs(error) > ERROR_SLACK) {
         pid->sum_errors += error;
-        i_term = pid->K_i * pid->sum_errors;
+        i_term = (pid->K_i * pid->sum_errors) / PID_RATE_SCALE;
     }
     else {
         i_term = 0;
     }
 
-    // Calculate D term
-    d_term = pid->K_d * (error - pid->last_error);
+    // Calculate D term over the tuned period, from the error PID_RATE_SCALE samples ago
+    d_term = pid->K_d * (error - pid->errors[pid->error_index]);
+
+    pid->errors[pid->error_index] = error;
+    pid->error_index = (pid->error_index + 1) % PID_RATE_SCALE;
 
     // Calculate control variable
     control_variable = (p_term + i_term + d_term)/SCALING_FACTOR;
@@ -93,33 +88,31 @@ int16_t PID_calculate_control(uint8_t reference_value, uint8_t process_value, PI
 
     }
 
+    pid->reference = reference_value;
+    pid->process = process_value;
+    pid->error = error;
+    pid->control = control_variable;
+
     return control_variable;
 
 }
 
 /** Function for moving motor according to the reference and process position, controlled by PID-controller.
+ *  Must be called every PID_PERIOD_MS.
  * @param PID* pid - PID controller.
- * @param message msg - Message from CAN, including the slider position.
+ * @param controller_frame controller - Controller state from Node 1, including the slider position.
  */
-void PID_controller(PID* pid, message msg) {
-    if (PID_FLAG == 1) {
-        // Get reference and process values
-        uint8_t reference_value = msg.data[3]; // Left slider (0 - 255)
-        //printf("REFERENCE VALUE: %u \n\r", reference_value);
-
-        uint8_t process_value = motor_position();
-        //printf("PROCESS VALUE: %u \n\r", process_value);
-
-        // Calculate the control variable
-        int16_t control_value = PID_calculate_control(reference_value, process_value, pid);
-        //printf("CONTROL VALUE: %i \n\r", control_value);
+void PID_controller(PID* pid, controller_frame controller) {
+    // Get reference and process values
+    uint8_t reference_value = controller.slider_left; // Left slider (0 - 255)
 
-        // Apply control on system
-        motor_move(control_value);
+    uint8_t process_value = motor_position();
 
-        PID_FLAG = 0;
+    // Calculate the control variable
+    int16_t control_value = PID_calculate_control(reference_value, process_value, pid);
 
-    }
+    // Apply control on system
+    motor_move(control_value);
 }
 
 /** Function for setting the tuning parameters of the PID.
@@ -153,9 +146,3 @@ void PID_set_parameters(PID* pid, difficulty mode) {
             break;
     }
 }
-
-/** Interrupt service routine which is executed at period set by TIMER3, setting the flag for updating control variable for PID.
- */
-ISR(TIMER3_OVF_vect) {
-    PID_FLAG = 1;
-}
@@ -10,6 +10,7 @@
 #include "motor.h"
 
 #include <stdint.h>
+#include <stdlib.h>
 #include <avr/io.h>
 #include <avr/interrupt.h>
 
@@ -18,7 +19,11 @@
 // Define max control variable
 #define MAX_CONTROL_VALUE 1023
 
-extern int PID_FLAG;
+// Period of the controller
+#define PID_PERIOD_MS 1
+
+// The gains were tuned at the TIMER3 overflow period of 32.768 ms. The integral and derivative are scaled to that period, so the gains keep their meaning at PID_PERIOD_MS.
+#define PID_RATE_SCALE 32
 
 typedef enum {EASY = 0, MEDIUM, HARD} difficulty;
 
@@ -28,8 +33,17 @@ typedef struct {
     int16_t K_i;
     int16_t K_d;
 
-    int16_t last_error;
+    // Errors of the last PID_RATE_SCALE samples, for the D term
+    int16_t errors[PID_RATE_SCALE];
+    uint8_t error_index;
+
     int32_t sum_errors;
+
+    // Values of the last step, for telemetry
+    uint8_t reference;
+    uint8_t process;
+    int16_t error;
+    int16_t control;
 } PID;
 
 
@@ -52,10 +66,11 @@ void PID_reset(PID* pid);
 int16_t PID_calculate_control(uint8_t reference_value, uint8_t process_value, PID* pid);
 
 /** Function for moving motor according to the reference and process position, controlled by PID-controller.
+ *  Must be called every PID_PERIOD_MS.
  * @param PID* pid - PID controller.
- * @param message msg - Message from CAN, including the slider position.
+ * @param controller_frame controller - Controller state from Node 1, including the slider position.
  */
-void PID_controller(PID* pid, message msg);
+void PID_controller(PID* pid, controller_frame controller);
 
 /** Function for setting the tuning parameters of the PID.
  * @param PID* pid - PID controller.
@@ -5,6 +5,9 @@
 
 #include "PWM.h"
 
+// Number of PWM periods since PWM_init, counted at TOP
+static volatile uint16_t PWM_period_count = 0;
+
 /** Function for initializing PWM on the ATmega2560.
  */
 void PWM_init(void) {
@@ -31,21 +34,20 @@ void PWM_init(void) {
     // Set output servo pin, PB5 on ATmega2560, pin 11 on Arduino shield
     set_bit(DDRB, PB5);
 
+    // Count the periods, so that the servo can be updated once per period
+    PWM_period_count = 0;
+    set_bit(TIMSK1, TOIE1);
+
     printf("PWM initialized. \n\r");
 }
 
 /** Function for converting joystick position (-100 to 100) to a pulse width (1.0 - 2.0 ms) and finding the duty cycle (PW/T)
- *  @param message position - CAN message containing the position of the joystick.
+ *  @param controller_frame controller - Controller state from Node 1, including the position of the joystick.
  *  @return double PWM_D - duty cycle.
  */
-double PWM_joystick_to_duty_cycle(message position){
+double PWM_joystick_to_duty_cycle(controller_frame controller){
 
-    int8_t x_position = position.data[0];
-
-    // Joystick position is values between (-100 - 100), negative values gets lost in CAN transmission as an uint8_t is transmitted
-    if (position.data[0] > 100) {
-        x_position = position.data[0] - 256;
-    }
+    int8_t x_position = controller.x;
 
     double PWM_resolution = 1.000; // From 1 ms to 2 ms - duty cycle for the PWM signal.
     double PWM_PW = 0.000;
@@ -84,6 +86,19 @@ void PWM_set_duty_cycle(double duty_cycle) {
     }
 }
 
+/** Function for returning the number of PWM periods since init, used as the clock of the servo task. Wraps around after 22 minutes.
+ *  A new duty cycle set right after a period starts is used from the next period, so each period gets exactly one update.
+ *  @return uint16_t - PWM periods since start.
+ */
+uint16_t PWM_periods(void) {
+    uint8_t sreg = SREG;
+    cli();
+    uint16_t periods = PWM_period_count;
+    SREG = sreg;
+
+    return periods;
+}
+
 /** Function for testing that the joystick movement actually moves the servo.
  */
 void test_joystick_to_servo(void){
@@ -91,11 +106,23 @@ void test_joystick_to_servo(void){
     PWM_init();
     CAN_init();
 
-    while(1){
-        message position = CAN_data_receive();
-        double duty_cycle = PWM_joystick_to_duty_cycle(position);
+    controller_frame controller;
 
-        PWM_set_duty_cycle(duty_cycle);
+    while(1){
+        message* position = CAN_rx_peek();
+        if (position != NULL) {
+            if (protocol_decode_controller(position->data, position->length, &controller) == PROTOCOL_OK) {
+                double duty_cycle = PWM_joystick_to_duty_cycle(controller);
+                PWM_set_duty_cycle(duty_cycle);
+            }
+            CAN_rx_release();
+        }
         _delay_ms(100);
     }
 }
+
+/** Interrupt service routine executed at TOP, once every PWM period.
+ */
+ISR(TIMER1_OVF_vect) {
+    PWM_period_count++;
+}
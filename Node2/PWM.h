@@ -7,9 +7,11 @@
 #define PWM_H
 
 #include <avr/io.h>
+#include <avr/interrupt.h>
 #include <stdint.h>
 
 #include "CAN.h"
+#include "USART.h"
 #include "bit_operations.h"
 
 #define PWM_T 20
@@ -33,16 +35,22 @@
 void PWM_init(void);
 
 /** Function for converting joystick position (-100 to 100) to a pulse width (1.0 - 2.0 ms) and finding the duty cycle (PW/T)
- *  @param message position - CAN message containing the position of the joystick.
+ *  @param controller_frame controller - Controller state from Node 1, including the position of the joystick.
  *  @return double PWM_D - duty cycle.
  */
-double PWM_joystick_to_duty_cycle(message position);
+double PWM_joystick_to_duty_cycle(controller_frame controller);
 
 /** Function for setting output compare register in the ATmega2560 to wanted duty cycle.
  *  @param double duty_cycle - the duty cycle to be set.
  */
 void PWM_set_duty_cycle(double duty_cycle);
 
+/** Function for returning the number of PWM periods since init, used as the clock of the servo task. Wraps around after 22 minutes.
+ *  A new duty cycle set right after a period starts is used from the next period, so each period gets exactly one update.
+ *  @return uint16_t - PWM periods since start.
+ */
+uint16_t PWM_periods(void);
+
 /** Function for testing that the joystick movement actually moves the servo.
  */
 void test_joystick_to_servo(void);
@@ -1,41 +1,237 @@
 /** @file USART.c
  *  @brief c-file for the USART driver - to initialize, recieve and transfer data.
+ *  Bytes are sent and received through ring buffers, emptied and filled by the USART interrupts.
  *  @authors: Anastasia Lindbäck and Marie Skatvedt
  */
+
 #include "USART.h"
 
-/** Function for initializing USART.
- *  @param unsigned int ubrr - UBRR register, User Baud Rate Register
+// Rings between the main loop and the USART interrupts. The indices run freely, the slot is the index modulo the length
+static volatile uint8_t USART_tx_ring[USART_TX_BUFFER_LENGTH];
+static volatile uint8_t USART_tx_head = 0;
+static volatile uint8_t USART_tx_tail = 0;
+
+static volatile uint8_t USART_rx_ring[USART_RX_BUFFER_LENGTH];
+static volatile uint8_t USART_rx_head = 0;
+static volatile uint8_t USART_rx_tail = 0;
+
+static volatile USART_tx_mode USART_mode = USART_TX_BLOCK;
+static volatile USART_statistics USART_stats;
+
+// Set when a byte has been sent, so that USART_flush can wait for the transmit complete flag
+static volatile bool USART_tx_started = false;
+
+static bool USART_stream_open = false;
+
+/** Function for moving the next byte of the transmit ring to the USART, or disabling the data register empty interrupt if the ring is empty.
+ */
+static void USART_tx_next(void) {
+    if (USART_tx_head == USART_tx_tail) {
+        clear_bit(UCSR0B, UDRIE0);
+        return;
+    }
+
+    // Transmit complete is cleared by writing a one, the error flags must be written zero
+    UCSR0A = (UCSR0A & (1 << U2X0)) | (1 << TXC0);
+    USART_tx_started = true;
+
+    UDR0 = USART_tx_ring[USART_tx_tail % USART_TX_BUFFER_LENGTH];
+    USART_tx_tail++;
+}
+
+/** Function for moving a received byte to the receive ring. A byte is lost if the ring is full.
+ */
+static void USART_rx_next(void) {
+    // The overrun flag must be read before UDR0
+    bool overrun = test_bit(UCSR0A, DOR0);
+    uint8_t data = UDR0;
+
+    if (overrun) {
+        USART_stats.rx_overflows++;
+    }
+
+    if ((uint8_t)(USART_rx_head - USART_rx_tail) >= USART_RX_BUFFER_LENGTH) {
+        USART_stats.rx_overflows++;
+        return;
+    }
+
+    USART_rx_ring[USART_rx_head % USART_RX_BUFFER_LENGTH] = data;
+    USART_rx_head++;
+}
+
+/** Function for initializing USART. Bytes still in the transmit ring are sent first.
+ *  The baud rate is set with normal or double speed, whichever comes closest.
+ *  @param uint32_t baud - Baud rate, up to FOSC/8.
+ *  @return uint8_t - 0 on success, 1 if the baud rate is off by more than USART_BAUD_TOLERANCE_PERMILLE.
  */
-void USART_init (unsigned int bd) {
-    // Setting baud rate
-    int ubrr = 0.15*((long)FOSC/((long)(16*bd))-1);
+uint8_t USART_init (uint32_t baud) {
+    if (test_bit(UCSR0B, TXEN0)) {
+        USART_flush();
+    }
+
+    // Normal speed samples each bit 16 times and double speed 8 times. Normal speed is kept when both are as close
+    uint16_t ubrr = 0;
+    bool double_speed = false;
+    uint32_t best_error = UINT32_MAX;
+
+    for (uint8_t samples = 16; samples >= 8; samples /= 2) {
+        uint32_t divisor = (FOSC + (samples * baud) / 2) / (samples * baud);
+
+        if (divisor < 1) {
+            divisor = 1;
+        }
+        if (divisor > 4096) {
+            divisor = 4096;
+        }
+
+        uint32_t actual = FOSC / (samples * divisor);
+        uint32_t error = (((actual > baud) ? (actual - baud) : (baud - actual)) * 1000) / baud;
 
-    UBRR0H = (unsigned char) (ubrr >> 8);
-    UBRR0L = (unsigned char) (ubrr);
+        if (error < best_error) {
+            best_error = error;
+            ubrr = divisor - 1;
+            double_speed = (samples == 8);
+            USART_stats.baud = actual;
+        }
+    }
 
-    // Enabling transmitter/receiver
-    set_bit(UCSR0B, RXEN0);
-    set_bit(UCSR0B, TXEN0);
+    USART_stats.baud_error_permille = best_error;
 
-    fdevopen(USART_trans, USART_recv);
+    UBRR0H = (unsigned char) (ubrr>>8);
+    UBRR0L = (unsigned char) ubrr;
+
+    if (double_speed) {
+        set_bit(UCSR0A, U2X0);
+    }
+    else {
+        clear_bit(UCSR0A, U2X0);
+    }
+
+    UCSR0B = (1<<RXEN0) | (1<<TXEN0) | (1<<RXCIE0);
+
+    if (!USART_stream_open) {
+        fdevopen(USART_trans, USART_recv);
+        USART_stream_open = true;
+    }
+
+    return (best_error > USART_BAUD_TOLERANCE_PERMILLE) ? 1 : 0;
 }
 
-/** Function for recieving data from USART.
- *  @return UDR0 - Empty Handler, if register RXC0 (RX complete) is not set.
+/** Function for recieving data from USART. Waits until a byte is received.
+ *  @return unsigned char - The oldest received byte.
  */
 unsigned char USART_recv (void) {
-    // Wait for data to be received
-    loop_until_bit_is_set(UCSR0A, RXC0);
+    while (USART_rx_head == USART_rx_tail) {
+        // With interrupts disabled the receive ring is filled by polling
+        if (!test_bit(SREG, SREG_I) && test_bit(UCSR0A, RXC0)) {
+            USART_rx_next();
+        }
+    }
 
-    return UDRE0;
+    uint8_t data = USART_rx_ring[USART_rx_tail % USART_RX_BUFFER_LENGTH];
+    USART_rx_tail++;
+
+    return data;
 }
 
-/** Function for transferring data from USART.
- *  @param unsigned char letter - Letter to be transferred
+/** Function for transferring data from USART. The byte is put in the transmit ring, and sent by the USART interrupt.
+ *  When the ring is full it waits for room, or drops the byte in USART_TX_DROP mode.
+ *  @param unsigned char letter - Letter to be transferred.
  */
 void USART_trans (unsigned char letter) {
-    // Wait for empty transmit buffer
-    loop_until_bit_is_set(UCSR0A, UDRE0);
-    UDR0 = letter;
+    uint8_t sreg = SREG;
+    cli();
+
+    while ((uint8_t)(USART_tx_head - USART_tx_tail) >= USART_TX_BUFFER_LENGTH) {
+        if (USART_mode == USART_TX_DROP) {
+            USART_stats.tx_dropped++;
+            SREG = sreg;
+            return;
+        }
+
+        // Let the interrupt make room, or make room by polling if the caller has interrupts disabled
+        SREG = sreg;
+        if (!test_bit(SREG, SREG_I) && test_bit(UCSR0A, UDRE0)) {
+            USART_tx_next();
+        }
+        cli();
+    }
+
+    USART_tx_ring[USART_tx_head % USART_TX_BUFFER_LENGTH] = letter;
+    USART_tx_head++;
+
+    uint8_t depth = USART_tx_head - USART_tx_tail;
+    if (depth > USART_stats.tx_high_water) {
+        USART_stats.tx_high_water = depth;
+    }
+
+    set_bit(UCSR0B, UDRIE0);
+    SREG = sreg;
+}
+
+/** Function for choosing what USART_trans does when the transmit ring is full.
+ *  @param USART_tx_mode mode - USART_TX_BLOCK or USART_TX_DROP.
+ *  @return USART_tx_mode - The previous mode, to be restored after the timing critical code.
+ */
+USART_tx_mode USART_set_tx_mode (USART_tx_mode mode) {
+    USART_tx_mode previous = USART_mode;
+    USART_mode = mode;
+
+    return previous;
+}
+
+/** Function for returning the room in the transmit ring, so that a frame can be written whole or not at all.
+ *  @return uint8_t - Bytes that can be written without waiting.
+ */
+uint8_t USART_tx_space (void) {
+    return USART_TX_BUFFER_LENGTH - (uint8_t)(USART_tx_head - USART_tx_tail);
+}
+
+/** Function for waiting until every byte in the transmit ring is sent.
+ */
+void USART_flush (void) {
+    while (USART_tx_head != USART_tx_tail) {
+        if (!test_bit(SREG, SREG_I) && test_bit(UCSR0A, UDRE0)) {
+            USART_tx_next();
+        }
+    }
+
+    // Wait for the last byte to leave the shift register
+    if (USART_tx_started) {
+        loop_until_bit_is_set(UCSR0A, TXC0);
+    }
+}
+
+/** Function for returning the baud rate and the counters of the rings.
+ *  @return USART_statistics - Actual baud rate and error, dropped and lost bytes, and the largest transmit ring depth.
+ */
+USART_statistics USART_read_statistics (void) {
+    uint8_t sreg = SREG;
+    cli();
+    USART_statistics statistics = USART_stats;
+    SREG = sreg;
+
+    return statistics;
+}
+
+/** Test function for printing the baud rate and the counters of the rings.
+ */
+void test_USART_statistics (void) {
+    USART_statistics statistics = USART_read_statistics();
+
+    printf("Baud rate: %lu, error %u.%u %%\n\r", statistics.baud, statistics.baud_error_permille / 10, statistics.baud_error_permille % 10);
+    printf("Transmit: high water mark %u of %u, dropped %u\n\r", statistics.tx_high_water, USART_TX_BUFFER_LENGTH, statistics.tx_dropped);
+    printf("Receive: lost %u\n\r", statistics.rx_overflows);
+}
+
+/** Interrupt service routine executed when the USART data register is empty, sending the next byte of the transmit ring.
+ */
+ISR(USART0_UDRE_vect) {
+    USART_tx_next();
+}
+
+/** Interrupt service routine executed when a byte is received, moving it to the receive ring.
+ */
+ISR(USART0_RX_vect) {
+    USART_rx_next();
 }
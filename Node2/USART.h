@@ -1,10 +1,12 @@
 /** @file USART.h
  *  @brief Header-file for the USART driver - to initialize, recieve and transfer data.
+ *  Bytes are sent and received through ring buffers, emptied and filled by the USART interrupts.
  *  @author: Anastasia Lindbäck and Marie Skatvedt
  */
 #ifndef USART_H
 #define USART_H
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <avr/io.h>
 #include <avr/interrupt.h>
@@ -14,19 +16,76 @@
 
 #define FOSC 16000000
 
-/** Function for initializing USART.
- *  @param unsigned int ubrr - UBRR register, User Baud Rate Register
+// Bytes the transmit and receive rings hold, powers of two
+#define USART_TX_BUFFER_LENGTH 128
+#define USART_RX_BUFFER_LENGTH 16
+
+// Largest difference between the requested and the actual baud rate accepted by USART_init, in permille
+#define USART_BAUD_TOLERANCE_PERMILLE 20
+
+/** Enum USART_tx_mode representing what USART_trans does when the transmit ring is full.
  */
-void USART_init (unsigned int bd);
+typedef enum {
+    // Wait for room in the ring
+    USART_TX_BLOCK,
+    // Drop the byte and count it, for timing critical code
+    USART_TX_DROP
+} USART_tx_mode;
 
-/** Function for recieving data from USART.
- *  @return UDR0 - Empty Handler, if register RXC0 (RX complete) is not set.
+/** Struct USART_statistics representing the baud rate and the counters of the rings.
+ */
+typedef struct {
+    uint32_t baud;
+    uint16_t baud_error_permille;
+
+    // Bytes dropped in USART_TX_DROP mode, and received bytes lost because the receive ring was full or the hardware overran
+    uint16_t tx_dropped;
+    uint16_t rx_overflows;
+
+    // Largest number of bytes waiting in the transmit ring
+    uint8_t tx_high_water;
+} USART_statistics;
+
+/** Function for initializing USART. Bytes still in the transmit ring are sent first.
+ *  The baud rate is set with normal or double speed, whichever comes closest.
+ *  @param uint32_t baud - Baud rate, up to FOSC/8.
+ *  @return uint8_t - 0 on success, 1 if the baud rate is off by more than USART_BAUD_TOLERANCE_PERMILLE.
+ */
+uint8_t USART_init (uint32_t baud);
+
+/** Function for recieving data from USART. Waits until a byte is received.
+ *  @return unsigned char - The oldest received byte.
  */
 unsigned char USART_recv (void);
 
-/** Function for transferring data from USART.
- *  @param unsigned char letter - Letter to be transferred
+/** Function for transferring data from USART. The byte is put in the transmit ring, and sent by the USART interrupt.
+ *  When the ring is full it waits for room, or drops the byte in USART_TX_DROP mode.
+ *  @param unsigned char letter - Letter to be transferred.
  */
 void USART_trans (unsigned char letter);
 
+/** Function for choosing what USART_trans does when the transmit ring is full.
+ *  @param USART_tx_mode mode - USART_TX_BLOCK or USART_TX_DROP.
+ *  @return USART_tx_mode - The previous mode, to be restored after the timing critical code.
+ */
+USART_tx_mode USART_set_tx_mode (USART_tx_mode mode);
+
+/** Function for returning the room in the transmit ring, so that a frame can be written whole or not at all.
+ *  @return uint8_t - Bytes that can be written without waiting.
+ */
+uint8_t USART_tx_space (void);
+
+/** Function for waiting until every byte in the transmit ring is sent.
+ */
+void USART_flush (void);
+
+/** Function for returning the baud rate and the counters of the rings.
+ *  @return USART_statistics - Actual baud rate and error, dropped and lost bytes, and the largest transmit ring depth.
+ */
+USART_statistics USART_read_statistics (void);
+
+/** Test function for printing the baud rate and the counters of the rings.
+ */
+void test_USART_statistics (void);
+
 #endif
@@ -37,14 +37,14 @@ int16_t encoder_read(void) {
 
     // SEL low to select high byte
     clear_bit(PORTH, PH3);
-    _delay_us(100);
+    _delay_us(ENCODER_SETTLE_US);
 
     // Read high byte
     uint8_t high_byte = PINK;
 
     // SEL high to select low byte
     set_bit(PORTH, PH3);
-    _delay_us(100);
+    _delay_us(ENCODER_SETTLE_US);
 
     uint8_t low_byte = PINK;
 
@@ -14,6 +14,9 @@
 #include <avr/io.h>
 #include <util/delay.h>
 
+// Time the encoder output needs to settle after SEL or !OE changes, about 20 us in the motor box datasheet
+#define ENCODER_SETTLE_US 20
+
 /** Function for initializing the encoder.
  */
 void encoder_init(void);
@@ -4,14 +4,22 @@
  */
 
 #include "CAN.h"
+#include "CAN_health.h"
 #include "IR.h"
 #include "motor.h"
 #include "PID.h"
+#include "protocol.h"
 #include "PWM.h"
+#include "recorder.h"
+#include "scheduler.h"
 #include "solenoid.h"
 #include "SPI.h"
+#include "supervisor.h"
+#include "telemetry.h"
+#include "timer.h"
 #include "USART.h"
 
+#include <stdbool.h>
 #include <util/delay.h>
 #include <avr/interrupt.h>
 
@@ -19,88 +27,243 @@
 
 #define MAX_MISSES 3
 
+// Task periods. The servo is updated once per PWM period, the others are released by the system tick.
+#define CAN_PERIOD_MS 5
+#define LINK_PERIOD_MS 5
+#define IR_PERIOD_MS 10
+#define SOLENOID_PERIOD_MS 10
+#define SERVO_PERIOD_PWM 1
 
-void main() {
+// Time between the game over and not game over messages to Node 1
+#define GAME_OVER_MS 200
 
-    sei();
-    USART_init(9600);
-    CAN_init();
+// Set to 1 to record the controller frames in the first 0.93 s of each game (see RECORDER_BUFFER_LENGTH), and dump the log and a replay report over USART at game over. The dump blocks the tasks for a few seconds
+#define RECORD_GAMES 0
 
-    IR_init();
+// Time between control loop telemetry records in milliseconds, 0 for none. While it is on, USART runs at TELEMETRY_BAUD
+#define TELEMETRY_PERIOD_MS 0
 
-    PWM_init();
-    solenoid_init();
-    motor_init();
+// Latest controller state from Node 1, and the sequence state and error counters of its frames
+static controller_frame controller;
+static protocol_receiver controller_stream;
 
-    PID *pid;
-    PID_init(pid);
+// Controller state followed by the motor and servo. Equal to the latest controller state while the link is up, and ramped to the safe state when it is lost
+static controller_frame command;
 
-    uint8_t curr_number_of_misses = 0;
+// Link state at the last supervisor update, the command when the link was lost, and the motor position held in the safe state
+static supervisor_state link_state = SUPERVISOR_SAFE;
+static controller_frame ramp_start;
+static uint8_t safe_position = 0;
 
-    message msg = CAN_data_receive();
-    uint8_t game_state = msg.data[5];
-    uint8_t position = motor_position();
+static PID pid;
 
-    while (1) {
+// Servo duty cycle in 1/100 %, and misses in the game, for the telemetry
+static uint16_t servo_duty_cycle = 0;
+static uint8_t misses = 0;
 
-        message msg = CAN_data_receive();
+// Game state from Node 1, 1 while playing
+static uint8_t game_state = 0;
 
-        // Set PID parameters
-        PID_set_parameters(pid, msg.data[6]);
+// Set between sending game over and not game over to Node 1, and when game over was sent
+static bool game_over_pending = false;
+static uint16_t game_over_time = 0;
 
-        position = motor_position();
+/** Function returning whether the game is being played, and the motor, servo and solenoid should follow the controller.
+ *  @return bool - true while playing, and the controller link is up or being ramped down.
+ */
+static bool playing(void) {
+    return (game_state == 1) && !game_over_pending && (link_state != SUPERVISOR_SAFE);
+}
 
-        if (game_state == 1) {
-            // Check if ball miss
-            curr_number_of_misses = counting_goals();
+/** Function for running the motor PID controller.
+ */
+static void task_pid(void) {
+    if (playing()) {
+        // Control the motor based on the left slider movement.
+        PID_controller(&pid, command);
 
-            // Have you reached game over
-            if (curr_number_of_misses >= MAX_MISSES) {
-                game_state = 0;
+        telemetry_pid(&pid, servo_duty_cycle, misses);
+    }
+}
 
-                // Send game over to Node 1
-                CAN_transmit_game_info(1);
-                reset_goals();
+/** Function for setting the servo from the joystick, once every PWM period.
+ */
+static void task_servo(void) {
+    if (playing()) {
+        // Control servo based on joystick signal (x-axis)
+        double duty_cycle = PWM_joystick_to_duty_cycle(command);
+        PWM_set_duty_cycle(duty_cycle);
 
-                _delay_ms(200);
+        servo_duty_cycle = duty_cycle * 10000;
+    }
+}
 
-                // Send not game over to Node 1
-                CAN_transmit_game_info(0);
-            }
+/** Function for following the game state of a new controller message from Node 1. Corrupted, foreign-version and old frames are ignored.
+ *  @param message* frame - The received message.
+ */
+static void controller_received(message* frame) {
+    recorder_record(frame);
 
-            else {
-                // Control servo based on joystick signal (x-axis)
-                double duty_cycle = PWM_joystick_to_duty_cycle(msg);
-                PWM_set_duty_cycle(duty_cycle);
+    // Keep the latest controller state for the other tasks
+    if (protocol_receive_controller(&controller_stream, frame->data, frame->length, &controller) != PROTOCOL_OK) {
+        return;
+    }
 
-                // Control the motor based on the left slider movement.
-                PID_controller(pid, msg);
+    supervisor_frame_received();
 
-                // Punch solenoid when left button pressed.
-                solenoid_control(msg);
+    // Set PID parameters
+    PID_set_parameters(&pid, controller.difficulty);
 
-                // Update game state
-                game_state = msg.data[5];
-            }
+    // Node 1 is told about game over before its game state is followed again
+    if (game_over_pending) {
+        return;
+    }
+
+    if (game_state == 1) {
+        // Punch solenoid when left button pressed.
+        solenoid_control(controller);
+    }
+
+    // If game is ended
+    else if (game_state == 0) {
+        // Reset goals
+        reset_goals();
+
+        // Reset error variables in PID
+        PID_reset(&pid);
+    }
+
+    if (RECORD_GAMES && (game_state == 0) && controller.play_game) {
+        recorder_start(&controller_stream, &controller);
+    }
 
+    // Update game state
+    game_state = controller.play_game;
+}
+
+/** Function for following the controller while the link is up, and ramping the servo to the center and the motor to a stop when frames stop arriving.
+ */
+static void task_link(void) {
+    supervisor_state state = supervisor_update();
+
+    if (state == SUPERVISOR_LINK_OK) {
+        command = controller;
+    }
+    else {
+        if (link_state == SUPERVISOR_LINK_OK) {
+            // Hold the motor where it is instead of driving on towards the last reference
+            ramp_start = command;
+            safe_position = motor_position();
+            PID_reset(&pid);
+
+            // Node 1 may have been reset, and would start its sequence again
+            protocol_receiver_resync(&controller_stream);
         }
 
-        // If game is ended
-        else if (game_state == 0) {
-            // Reset goals
-            reset_goals();
+        command.x = supervisor_ramp(ramp_start.x, 0);
+        command.slider_left = supervisor_ramp(ramp_start.slider_left, safe_position);
+        command.button = false;
 
-            // Reset error variables in PID
-            PID_reset(pid);
+        if ((state == SUPERVISOR_SAFE) && (link_state == SUPERVISOR_RAMPING)) {
+            motor_move(0);
+        }
+    }
 
-            // Update game state
-            game_state = msg.data[5];
+    link_state = state;
+}
 
+/** Function for sending queued frames, and handling the frames received from Node 1.
+ */
+static void task_can(void) {
+    CAN_service_transmit();
+    CAN_rx_poll();
+    CAN_dispatch();
+}
+
+/** Function for counting misses with the IR photodiode, and telling Node 1 about game over.
+ */
+static void task_ir(void) {
+    if (game_over_pending) {
+        if (timer_elapsed_ms(game_over_time) >= GAME_OVER_MS) {
+            // Send not game over to Node 1
+            CAN_transmit_game_info(0);
+            game_over_pending = false;
         }
+    }
+
+    else if (game_state == 1) {
+        // Check if ball miss
+        uint8_t curr_number_of_misses = counting_goals();
+        misses = curr_number_of_misses;
+
+        // Have you reached game over
+        if (curr_number_of_misses >= MAX_MISSES) {
+            game_state = 0;
+
+            // Send game over to Node 1
+            CAN_transmit_game_info(1);
+            reset_goals();
+
+            game_over_pending = true;
+            game_over_time = timer_ms();
 
-        else {
-            // Update game state
-            game_state = msg.data[5];
+            if (RECORD_GAMES) {
+                recorder_stop();
+                recorder_dump();
+                recorder_replay();
+            }
         }
     }
 }
+
+/** Function for sampling the CAN error counters, and sending a status frame to Node 1 once per rate window.
+ */
+static void task_can_health(void) {
+    if (CAN_health_sample()) {
+        CAN_health_transmit_status(CAN_ID_NODE2_STATUS);
+    }
+}
+
+/** Function for ending solenoid punches.
+ */
+static void task_solenoid(void) {
+    solenoid_update();
+}
+
+// Tasks in priority order
+static task tasks[] = {
+    TASK("PID", task_pid, timer_ms, PID_PERIOD_MS),
+    TASK("SERVO", task_servo, PWM_periods, SERVO_PERIOD_PWM),
+    TASK("LINK", task_link, timer_ms, LINK_PERIOD_MS),
+    TASK("CAN", task_can, timer_ms, CAN_PERIOD_MS),
+    TASK("SOLENOID", task_solenoid, timer_ms, SOLENOID_PERIOD_MS),
+    TASK("IR", task_ir, timer_ms, IR_PERIOD_MS),
+    TASK("CAN HEALTH", task_can_health, timer_ms, CAN_HEALTH_PERIOD_MS),
+};
+
+void main() {
+
+    sei();
+    USART_init(9600);
+    timer_init();
+    CAN_init();
+    protocol_receiver_init(&controller_stream);
+    supervisor_init(SUPERVISOR_DEADLINE_MS);
+    CAN_register_handler(CAN_ID_CONTROLLER, false, controller_received);
+    CAN_health_register_peer(CAN_ID_NODE1_STATUS);
+    CAN_apply_filters();
+    CAN_health_init();
+
+    IR_init();
+
+    PWM_init();
+    solenoid_init();
+    motor_init();
+
+    PID_init(&pid);
+
+    // After the modules that set up USART for text
+    telemetry_init(TELEMETRY_PERIOD_MS);
+
+    scheduler_run(tasks, sizeof(tasks)/sizeof(tasks[0]));
+}
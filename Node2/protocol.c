@@ -0,0 +1,324 @@
+/** @file protocol.c
+ *  @brief C-file for the frame formats shared by Node 1 and Node 2. Packs the controller state into a versioned CAN frame with a sequence number and a CRC-8, and unpacks it again.
+ *  The file is the same on both nodes, tests/Makefile checks that the copies are equal.
+ *  @authors: Anastasia Lindbäck and Marie Skatvedt
+ */
+
+#include "protocol.h"
+
+// Joystick limits of the controller frame
+#define PROTOCOL_JOYSTICK_MIN -100
+#define PROTOCOL_JOYSTICK_MAX 100
+
+/** Function for limiting a joystick position to the range of the controller frame.
+ *  @param int8_t position - Joystick position.
+ *  @return int8_t - The position, limited to -100 - 100.
+ */
+static int8_t protocol_limit_joystick(int8_t position) {
+    if (position < PROTOCOL_JOYSTICK_MIN) {
+        return PROTOCOL_JOYSTICK_MIN;
+    }
+    if (position > PROTOCOL_JOYSTICK_MAX) {
+        return PROTOCOL_JOYSTICK_MAX;
+    }
+    return position;
+}
+
+/** Function for calculating the CRC-8 of a block of bytes.
+ *  @param const uint8_t* data - The bytes.
+ *  @param uint8_t length - Number of bytes.
+ *  @return uint8_t - The CRC.
+ */
+uint8_t protocol_crc8(const uint8_t* data, uint8_t length) {
+    uint8_t crc = 0;
+
+    for (uint8_t i = 0; i < length; i++) {
+        crc ^= data[i];
+
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            if (crc & 0x80) {
+                crc = (crc << 1) ^ PROTOCOL_CRC_POLYNOMIAL;
+            }
+            else {
+                crc <<= 1;
+            }
+        }
+    }
+
+    return crc;
+}
+
+/** Function for packing a controller frame.
+ *  @param const controller_frame* frame - The controller state. The joystick is limited to -100 - 100 and the difficulty to 2 bits.
+ *  @param uint8_t* data - Buffer for the PROTOCOL_CONTROLLER_LENGTH packed bytes.
+ *  @return uint8_t - Number of bytes packed, PROTOCOL_CONTROLLER_LENGTH.
+ */
+uint8_t protocol_encode_controller(const controller_frame* frame, uint8_t* data) {
+    uint8_t flags = PROTOCOL_VERSION << PROTOCOL_VERSION_SHIFT;
+    flags |= (frame->difficulty & PROTOCOL_DIFFICULTY_MASK) << PROTOCOL_DIFFICULTY_SHIFT;
+
+    if (frame->play_game) {
+        flags |= (1 << PROTOCOL_PLAY_GAME_BIT);
+    }
+    if (frame->button) {
+        flags |= (1 << PROTOCOL_BUTTON_BIT);
+    }
+
+    data[PROTOCOL_CONTROLLER_FLAGS] = flags;
+    data[PROTOCOL_CONTROLLER_SEQUENCE] = frame->sequence;
+    data[PROTOCOL_CONTROLLER_X] = (uint8_t)protocol_limit_joystick(frame->x);
+    data[PROTOCOL_CONTROLLER_Y] = (uint8_t)protocol_limit_joystick(frame->y);
+    data[PROTOCOL_CONTROLLER_SLIDER_LEFT] = frame->slider_left;
+    data[PROTOCOL_CONTROLLER_SLIDER_RIGHT] = frame->slider_right;
+    data[PROTOCOL_CONTROLLER_CRC] = protocol_crc8(data, PROTOCOL_CONTROLLER_CRC);
+
+    return PROTOCOL_CONTROLLER_LENGTH;
+}
+
+/** Function for unpacking a controller frame, checking its length, version and CRC.
+ *  @param const uint8_t* data - The packed bytes.
+ *  @param uint8_t length - Number of bytes received.
+ *  @param controller_frame* frame - The unpacked controller state, only written when the frame is valid.
+ *  @return protocol_status - PROTOCOL_OK, or the reason the frame was rejected.
+ */
+protocol_status protocol_decode_controller(const uint8_t* data, uint8_t length, controller_frame* frame) {
+    if (length != PROTOCOL_CONTROLLER_LENGTH) {
+        return PROTOCOL_ERROR_LENGTH;
+    }
+
+    // Checked before the version, so that a corrupted version nibble counts as a CRC error
+    if (protocol_crc8(data, PROTOCOL_CONTROLLER_CRC) != data[PROTOCOL_CONTROLLER_CRC]) {
+        return PROTOCOL_ERROR_CRC;
+    }
+
+    uint8_t flags = data[PROTOCOL_CONTROLLER_FLAGS];
+
+    if ((flags >> PROTOCOL_VERSION_SHIFT) != PROTOCOL_VERSION) {
+        return PROTOCOL_ERROR_VERSION;
+    }
+
+    frame->difficulty = (flags >> PROTOCOL_DIFFICULTY_SHIFT) & PROTOCOL_DIFFICULTY_MASK;
+    frame->play_game = (flags >> PROTOCOL_PLAY_GAME_BIT) & 1;
+    frame->button = (flags >> PROTOCOL_BUTTON_BIT) & 1;
+    frame->sequence = data[PROTOCOL_CONTROLLER_SEQUENCE];
+    frame->x = (int8_t)data[PROTOCOL_CONTROLLER_X];
+    frame->y = (int8_t)data[PROTOCOL_CONTROLLER_Y];
+    frame->slider_left = data[PROTOCOL_CONTROLLER_SLIDER_LEFT];
+    frame->slider_right = data[PROTOCOL_CONTROLLER_SLIDER_RIGHT];
+
+    return PROTOCOL_OK;
+}
+
+/** Function for clearing the sequence state and counters of a receiver.
+ *  @param protocol_receiver* receiver - The receiver.
+ */
+void protocol_receiver_init(protocol_receiver* receiver) {
+    receiver->synchronized = false;
+    receiver->sequence = 0;
+    receiver->stale_run = 0;
+
+    receiver->received = 0;
+    receiver->lost = 0;
+    receiver->stale = 0;
+    receiver->resyncs = 0;
+    receiver->length_errors = 0;
+    receiver->version_errors = 0;
+    receiver->crc_errors = 0;
+}
+
+/** Function for making a receiver accept the next valid frame whatever its sequence number, e.g. when the link has been lost and the sender may have restarted. The counters are kept.
+ *  @param protocol_receiver* receiver - The receiver.
+ */
+void protocol_receiver_resync(protocol_receiver* receiver) {
+    if (receiver->synchronized) {
+        receiver->synchronized = false;
+        receiver->resyncs++;
+    }
+    receiver->stale_run = 0;
+}
+
+/** Function for unpacking a received controller frame, rejecting invalid and old frames and counting the frames lost before it.
+ *  After PROTOCOL_RESYNC_STALE old frames in a row the sender is taken as restarted, and the frame is accepted.
+ *  @param protocol_receiver* receiver - Sequence state and counters of the stream.
+ *  @param const uint8_t* data - The packed bytes.
+ *  @param uint8_t length - Number of bytes received.
+ *  @param controller_frame* frame - The unpacked controller state, only written when the frame is accepted.
+ *  @return protocol_status - PROTOCOL_OK, or the reason the frame was rejected.
+ */
+protocol_status protocol_receive_controller(protocol_receiver* receiver, const uint8_t* data, uint8_t length, controller_frame* frame) {
+    controller_frame decoded;
+    protocol_status status = protocol_decode_controller(data, length, &decoded);
+
+    switch (status) {
+        case PROTOCOL_ERROR_LENGTH:
+            receiver->length_errors++;
+            return status;
+        case PROTOCOL_ERROR_VERSION:
+            receiver->version_errors++;
+            return status;
+        case PROTOCOL_ERROR_CRC:
+            receiver->crc_errors++;
+            return status;
+        default:
+            break;
+    }
+
+    if (receiver->synchronized) {
+        // Wraps, so that a frame just after the previous gives 1
+        uint8_t step = decoded.sequence - receiver->sequence;
+
+        if ((step == 0) || (step > PROTOCOL_SEQUENCE_WINDOW)) {
+            receiver->stale++;
+            receiver->stale_run++;
+
+            // A restarted sender counts from the start again, and would otherwise be rejected until it passes the old sequence
+            if (receiver->stale_run < PROTOCOL_RESYNC_STALE) {
+                return PROTOCOL_ERROR_STALE;
+            }
+
+            receiver->resyncs++;
+        }
+        else {
+            receiver->lost += step - 1;
+        }
+    }
+
+    receiver->synchronized = true;
+    receiver->stale_run = 0;
+    receiver->sequence = decoded.sequence;
+    receiver->received++;
+
+    *frame = decoded;
+    return PROTOCOL_OK;
+}
+
+/** Function for printing the counters of a receiver.
+ *  @param const protocol_receiver* receiver - The receiver.
+ */
+void protocol_print_receiver(const protocol_receiver* receiver) {
+    printf("Received: %u\n\r", receiver->received);
+    printf("Lost: %u\n\r", receiver->lost);
+    printf("Old: %u\n\r", receiver->stale);
+    printf("Resynchronized: %u\n\r", receiver->resyncs);
+    printf("Length errors: %u\n\r", receiver->length_errors);
+    printf("Version errors: %u\n\r", receiver->version_errors);
+    printf("CRC errors: %u\n\r", receiver->crc_errors);
+}
+
+/** Test function packing and unpacking controller frames, checking that every field survives the round trip and that corrupted, truncated, foreign-version and old frames are rejected.
+ *  Runs on the target, and on the PC with tests/Makefile.
+ *  @return uint16_t - Number of failed checks.
+ */
+uint16_t test_protocol_controller_frame(void) {
+    uint8_t data[PROTOCOL_CONTROLLER_LENGTH];
+    controller_frame sent;
+    controller_frame received;
+    uint16_t failures = 0;
+
+    // Round trip of every joystick position, with the other fields and flags changing along
+    for (int16_t position = PROTOCOL_JOYSTICK_MIN; position <= PROTOCOL_JOYSTICK_MAX; position++) {
+        sent.x = position;
+        sent.y = -position;
+        sent.slider_left = (uint8_t)(position * 3);
+        sent.slider_right = (uint8_t)(255 - position);
+        sent.button = position & 1;
+        sent.play_game = (position >> 1) & 1;
+        sent.difficulty = (uint8_t)position % 3;
+        sent.sequence = (uint8_t)position;
+
+        protocol_encode_controller(&sent, data);
+
+        if ((protocol_decode_controller(data, PROTOCOL_CONTROLLER_LENGTH, &received) != PROTOCOL_OK)
+            || (received.x != sent.x) || (received.y != sent.y)
+            || (received.slider_left != sent.slider_left) || (received.slider_right != sent.slider_right)
+            || (received.button != sent.button) || (received.play_game != sent.play_game)
+            || (received.difficulty != sent.difficulty) || (received.sequence != sent.sequence)) {
+            printf("Round trip failed at x = %d\n\r", position);
+            failures++;
+        }
+    }
+
+    // Every single bit error is detected
+    protocol_encode_controller(&sent, data);
+
+    for (uint8_t byte = 0; byte < PROTOCOL_CONTROLLER_LENGTH; byte++) {
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            data[byte] ^= (1 << bit);
+
+            if (protocol_decode_controller(data, PROTOCOL_CONTROLLER_LENGTH, &received) != PROTOCOL_ERROR_CRC) {
+                printf("Bit %u of byte %u not detected\n\r", bit, byte);
+                failures++;
+            }
+
+            data[byte] ^= (1 << bit);
+        }
+    }
+
+    if (protocol_decode_controller(data, PROTOCOL_CONTROLLER_LENGTH - 1, &received) != PROTOCOL_ERROR_LENGTH) {
+        printf("Short frame not rejected\n\r");
+        failures++;
+    }
+
+    // Another version with a valid CRC
+    data[PROTOCOL_CONTROLLER_FLAGS] ^= (1 << PROTOCOL_VERSION_SHIFT);
+    data[PROTOCOL_CONTROLLER_CRC] = protocol_crc8(data, PROTOCOL_CONTROLLER_CRC);
+
+    if (protocol_decode_controller(data, PROTOCOL_CONTROLLER_LENGTH, &received) != PROTOCOL_ERROR_VERSION) {
+        printf("Other version not rejected\n\r");
+        failures++;
+    }
+
+    // Sequence tracking: a repeated frame is old, a gap counts the lost frames
+    protocol_receiver receiver;
+    protocol_receiver_init(&receiver);
+
+    const uint8_t sequences[] = {254, 255, 255, 2, 1, 3};
+    const protocol_status expected[] = {PROTOCOL_OK, PROTOCOL_OK, PROTOCOL_ERROR_STALE, PROTOCOL_OK, PROTOCOL_ERROR_STALE, PROTOCOL_OK};
+
+    for (uint8_t i = 0; i < sizeof(sequences); i++) {
+        sent.sequence = sequences[i];
+        protocol_encode_controller(&sent, data);
+
+        if (protocol_receive_controller(&receiver, data, PROTOCOL_CONTROLLER_LENGTH, &received) != expected[i]) {
+            printf("Sequence %u not handled\n\r", sequences[i]);
+            failures++;
+        }
+    }
+
+    if ((receiver.received != 4) || (receiver.lost != 2) || (receiver.stale != 2)) {
+        printf("Sequence counters wrong\n\r");
+        failures++;
+    }
+
+    // A restarted sender is followed after PROTOCOL_RESYNC_STALE old frames, or at once after a resync
+    const uint8_t restarted[] = {1, 2, 3, 4};
+    const protocol_status restarted_expected[] = {PROTOCOL_ERROR_STALE, PROTOCOL_ERROR_STALE, PROTOCOL_OK, PROTOCOL_OK};
+
+    for (uint8_t i = 0; i < sizeof(restarted); i++) {
+        sent.sequence = restarted[i];
+        protocol_encode_controller(&sent, data);
+
+        if (protocol_receive_controller(&receiver, data, PROTOCOL_CONTROLLER_LENGTH, &received) != restarted_expected[i]) {
+            printf("Restarted sequence %u not handled\n\r", restarted[i]);
+            failures++;
+        }
+    }
+
+    protocol_receiver_resync(&receiver);
+    sent.sequence = 1;
+    protocol_encode_controller(&sent, data);
+
+    if (protocol_receive_controller(&receiver, data, PROTOCOL_CONTROLLER_LENGTH, &received) != PROTOCOL_OK) {
+        printf("Frame after resync not accepted\n\r");
+        failures++;
+    }
+
+    if ((receiver.received != 7) || (receiver.lost != 2) || (receiver.stale != 5) || (receiver.resyncs != 2)) {
+        printf("Resync counters wrong\n\r");
+        failures++;
+    }
+
+    printf("Controller frame test: %u failures\n\r", failures);
+
+    return failures;
+}
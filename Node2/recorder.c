@@ -0,0 +1,290 @@
+/** @file recorder.c
+ *  @brief C-file for the CAN traffic recorder. Records received frames with timestamps, dumps the log over USART, and replays it through the controller frame decoding, PID and servo calculations faster than real time.
+ *  The log is kept in RAM and only holds the first 0.93 s of a game, see RECORDER_BUFFER_LENGTH. The dump is parsed on the PC with tools/recorder_decode.py, and replayed on the PC with tests/test_recorder.c.
+ *  @authors: Anastasia Lindbäck and Marie Skatvedt
+ */
+
+#include "recorder.h"
+
+static uint8_t recorder_log[RECORDER_BUFFER_LENGTH];
+static recorder_statistics recorder_stats;
+
+// Time of the previous record
+static uint16_t recorder_last_time = 0;
+
+// Receiver and controller state of the game, followed while recording
+static const protocol_receiver* recorder_live;
+static const controller_frame* recorder_live_controller;
+
+// Game state when the recording started, and after the last recorded frame
+static protocol_receiver recorder_live_start;
+static protocol_receiver recorder_live_end;
+static controller_frame recorder_controller_start;
+static controller_frame recorder_controller_end;
+
+// Set when the log is full. Later frames are not in the log, so the game state is not followed any more
+static bool recorder_window_closed = false;
+
+/** Function for writing a 16 bit value to the log, least significant byte first.
+ *  @param uint8_t* bytes - Where to write.
+ *  @param uint16_t value - The value.
+ */
+static void recorder_write_16(uint8_t* bytes, uint16_t value) {
+    bytes[0] = value & 0xFF;
+    bytes[1] = value >> 8;
+}
+
+/** Function for reading a 16 bit value from the log, least significant byte first.
+ *  @param const uint8_t* bytes - Where to read.
+ *  @return uint16_t - The value.
+ */
+static uint16_t recorder_read_16(const uint8_t* bytes) {
+    return bytes[0] | ((uint16_t)bytes[1] << 8);
+}
+
+/** Function for keeping the game state at the end of the recorded window, to be compared with the replay.
+ */
+static void recorder_close_window(void) {
+    recorder_window_closed = true;
+    recorder_live_end = *recorder_live;
+    recorder_controller_end = *recorder_live_controller;
+}
+
+/** Function for clearing the log and starting to record. The game state is kept, the replay starts from it.
+ *  @param const protocol_receiver* live - Receiver of the controller frames in the game. Must stay valid while recording.
+ *  @param const controller_frame* controller - Latest controller state in the game. Must stay valid while recording.
+ */
+void recorder_start(const protocol_receiver* live, const controller_frame* controller) {
+    recorder_stats.recording = true;
+    recorder_stats.records = 0;
+    recorder_stats.bytes = 0;
+    recorder_stats.dropped = 0;
+    recorder_stats.duration_ms = 0;
+
+    recorder_live = live;
+    recorder_live_controller = controller;
+    recorder_live_start = *live;
+    recorder_controller_start = *controller;
+    recorder_window_closed = false;
+
+    recorder_last_time = timer_ms();
+}
+
+/** Function for adding a received frame to the log. Does nothing unless recording.
+ *  Must be called before the frame is given to the receiver, so that the game state of the first frame that does not fit is not in the recorded window.
+ *  @param const message* msg - The received frame.
+ */
+void recorder_record(const message* msg) {
+    if (!recorder_stats.recording) {
+        return;
+    }
+
+    uint8_t length = (msg->length > MCP_FRAME_MAX_DATA) ? MCP_FRAME_MAX_DATA : msg->length;
+
+    if (msg->extended) {
+        recorder_stats.dropped++;
+        return;
+    }
+
+    if (recorder_stats.bytes + RECORDER_RECORD_HEADER_LENGTH + length > RECORDER_BUFFER_LENGTH) {
+        if (!recorder_window_closed) {
+            recorder_close_window();
+        }
+        recorder_stats.dropped++;
+        return;
+    }
+
+    uint16_t now = timer_ms();
+    uint16_t delta = (recorder_stats.records == 0) ? 0 : (uint16_t)(now - recorder_last_time);
+    recorder_last_time = now;
+
+    uint8_t* record = &recorder_log[recorder_stats.bytes];
+    recorder_write_16(&record[0], delta);
+    recorder_write_16(&record[2], (msg->id & MCP_STANDARD_ID_MAX) | ((uint16_t)length << RECORDER_LENGTH_SHIFT));
+
+    for (uint8_t i = 0; i < length; i++) {
+        record[RECORDER_RECORD_HEADER_LENGTH + i] = msg->data[i];
+    }
+
+    recorder_stats.bytes += RECORDER_RECORD_HEADER_LENGTH + length;
+    recorder_stats.records++;
+    recorder_stats.duration_ms += delta;
+}
+
+/** Function for stopping the recording. The game state is kept to compare with the replay, unless the log was full before.
+ */
+void recorder_stop(void) {
+    if (!recorder_stats.recording) {
+        return;
+    }
+
+    recorder_stats.recording = false;
+    if (!recorder_window_closed) {
+        recorder_close_window();
+    }
+}
+
+/** Function for returning the recorder state.
+ *  @return recorder_statistics - Recording or not, records and bytes in the log, dropped frames and recorded time.
+ */
+recorder_statistics recorder_read_statistics(void) {
+    return recorder_stats;
+}
+
+/** Function for writing the log over USART in the binary log format. Blocks until it is sent.
+ */
+void recorder_dump(void) {
+    uint8_t header[RECORDER_HEADER_LENGTH] = RECORDER_MAGIC;
+    header[4] = RECORDER_VERSION;
+    recorder_write_16(&header[5], recorder_stats.records);
+    recorder_write_16(&header[7], recorder_stats.bytes);
+
+    for (uint8_t i = 0; i < RECORDER_HEADER_LENGTH; i++) {
+        USART_trans(header[i]);
+    }
+
+    for (uint16_t i = 0; i < recorder_stats.bytes; i++) {
+        USART_trans(recorder_log[i]);
+    }
+}
+
+/** Function for printing whether a replayed counter matches the recording.
+ *  @param const char* name - Name of the counter.
+ *  @param uint16_t recorded - Change of the counter in the game during the recording.
+ *  @param uint16_t replayed - The counter after the replay.
+ *  @return bool - true if they differ.
+ */
+static bool recorder_compare(const char* name, uint16_t recorded, uint16_t replayed) {
+    if (recorded == replayed) {
+        printf("    %s: %u\n\r", name, replayed);
+        return false;
+    }
+
+    printf("    %s: %u recorded, %u replayed\n\r", name, recorded, replayed);
+    return true;
+}
+
+/** Function for setting up a replay from the game state at the start of a recording.
+ *  @param recorder_replay_state* state - The replay.
+ *  @param const protocol_receiver* receiver - Receiver of the controller frames when the recording started.
+ *  @param const controller_frame* controller - Controller state when the recording started.
+ */
+void recorder_replay_init(recorder_replay_state* state, const protocol_receiver* receiver, const controller_frame* controller) {
+    state->receiver = *receiver;
+    state->controller = *controller;
+
+    PID_init(&state->pid);
+    PID_set_parameters(&state->pid, controller->difficulty);
+
+    state->duty_cycle = PWM_joystick_to_duty_cycle(*controller);
+
+    // The simulated motor starts in the middle
+    state->position = (int32_t)128 << 8;
+    state->control = 0;
+
+    state->frames = 0;
+    state->pid_steps = 0;
+    state->frame_ticks = 0;
+    state->frame_max_ticks = 0;
+    state->pid_ticks = 0;
+}
+
+/** Function for replaying records through the controller frame decoding, the PID with a simulated motor, and the servo calculation, as fast as possible.
+ *  The PID runs once for every millisecond between the records, towards the reference of the previous frame.
+ *  Does not use the hardware, so it also runs on the PC against a dumped log.
+ *  @param recorder_replay_state* state - The replay, set up by recorder_replay_init.
+ *  @param const uint8_t* log - The records, without the log header.
+ *  @param uint16_t bytes - Bytes of the records. A record cut short at the end is not replayed.
+ */
+void recorder_replay_log(recorder_replay_state* state, const uint8_t* log, uint16_t bytes) {
+    uint16_t offset = 0;
+
+    while (offset + RECORDER_RECORD_HEADER_LENGTH <= bytes) {
+        const uint8_t* record = &log[offset];
+        uint16_t delta = recorder_read_16(&record[0]);
+        uint16_t id_length = recorder_read_16(&record[2]);
+        uint8_t length = id_length >> RECORDER_LENGTH_SHIFT;
+
+        if (offset + RECORDER_RECORD_HEADER_LENGTH + length > bytes) {
+            return;
+        }
+        offset += RECORDER_RECORD_HEADER_LENGTH + length;
+
+        for (uint16_t step = 0; step < delta; step++) {
+            uint16_t start = timer_ticks();
+
+            uint8_t process = (state->position < 0) ? 0 : ((state->position >> 8) > 255) ? 255 : (state->position >> 8);
+            state->control = PID_calculate_control(state->controller.slider_left, process, &state->pid);
+            state->position += state->control >> RECORDER_PLANT_SHIFT;
+
+            state->pid_ticks += (uint16_t)(timer_ticks() - start);
+            state->pid_steps++;
+        }
+
+        if ((id_length & MCP_STANDARD_ID_MAX) != CAN_ID_CONTROLLER) {
+            continue;
+        }
+
+        uint16_t start = timer_ticks();
+
+        if (protocol_receive_controller(&state->receiver, &record[RECORDER_RECORD_HEADER_LENGTH], length, &state->controller) == PROTOCOL_OK) {
+            PID_set_parameters(&state->pid, state->controller.difficulty);
+            state->duty_cycle = PWM_joystick_to_duty_cycle(state->controller);
+        }
+
+        uint16_t ticks = timer_ticks() - start;
+        state->frame_ticks += ticks;
+        if (ticks > state->frame_max_ticks) {
+            state->frame_max_ticks = ticks;
+        }
+        state->frames++;
+    }
+}
+
+/** Function for replaying the log from the game state at the start of the recording, see recorder_replay_log.
+ *  Prints the processing time per frame and per PID step, and the differences between the replayed and the recorded game state.
+ *  Only the recorded window is compared, from the start of the recording to the last frame in the log.
+ *  A resynchronization of the game receiver in the window is not in the log, and shows as lost frames.
+ *  @return uint8_t - Number of differences.
+ */
+uint8_t recorder_replay(void) {
+    recorder_replay_state replay;
+    recorder_replay_init(&replay, &recorder_live_start, &recorder_controller_start);
+
+    uint16_t replay_start = timer_ms();
+    recorder_replay_log(&replay, recorder_log, recorder_stats.bytes);
+    uint16_t replay_ms = timer_elapsed_ms(replay_start);
+
+    printf("Replayed %u frames, %lu ms recorded, in %u ms\n\r", replay.frames, (unsigned long)recorder_stats.duration_ms, replay_ms);
+
+    if (replay.frames > 0) {
+        printf("Frame: %lu us average, %lu us max\n\r", (unsigned long)(TIMER_TICKS_TO_US(replay.frame_ticks) / replay.frames), (unsigned long)TIMER_TICKS_TO_US(replay.frame_max_ticks));
+    }
+    if (replay.pid_steps > 0) {
+        printf("PID step: %lu us average, %lu steps\n\r", (unsigned long)(TIMER_TICKS_TO_US(replay.pid_ticks) / replay.pid_steps), (unsigned long)replay.pid_steps);
+    }
+
+    uint8_t differences = 0;
+    printf("Receiver:\n\r");
+    differences += recorder_compare("Received", recorder_live_end.received - recorder_live_start.received, replay.receiver.received - recorder_live_start.received);
+    differences += recorder_compare("Lost", recorder_live_end.lost - recorder_live_start.lost, replay.receiver.lost - recorder_live_start.lost);
+    differences += recorder_compare("Old", recorder_live_end.stale - recorder_live_start.stale, replay.receiver.stale - recorder_live_start.stale);
+    differences += recorder_compare("CRC errors", recorder_live_end.crc_errors - recorder_live_start.crc_errors, replay.receiver.crc_errors - recorder_live_start.crc_errors);
+
+    printf("Controller state after the last recorded frame:\n\r");
+    differences += recorder_compare("Sequence", recorder_controller_end.sequence, replay.controller.sequence);
+    differences += recorder_compare("Slider", recorder_controller_end.slider_left, replay.controller.slider_left);
+    differences += recorder_compare("Difficulty", recorder_controller_end.difficulty, replay.controller.difficulty);
+    differences += recorder_compare("Play game", recorder_controller_end.play_game, replay.controller.play_game);
+
+    if ((recorder_controller_end.x != replay.controller.x) || (recorder_controller_end.y != replay.controller.y)) {
+        printf("    Joystick: (%d, %d) recorded, (%d, %d) replayed\n\r", recorder_controller_end.x, recorder_controller_end.y, replay.controller.x, replay.controller.y);
+        differences++;
+    }
+
+    printf("Final PID control %d, simulated position %ld, servo duty cycle %u.%02u %%\n\r", replay.control, (long)(replay.position >> 8),
+        (uint16_t)(replay.duty_cycle * 100), (uint16_t)(replay.duty_cycle * 10000) % 100);
+    printf("%u differences\n\r", differences);
+
+    return differences;
+}
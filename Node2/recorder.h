@@ -0,0 +1,126 @@
+/** @file recorder.h
+ *  @brief Header-file for the CAN traffic recorder. Records received frames with timestamps, dumps the log over USART, and replays it through the controller frame decoding, PID and servo calculations faster than real time.
+ *  The log is kept in RAM and only holds the first 0.93 s of a game, see RECORDER_BUFFER_LENGTH. The dump is parsed on the PC with tools/recorder_decode.py, and replayed on the PC with tests/test_recorder.c.
+ *  @authors: Anastasia Lindbäck and Marie Skatvedt
+ */
+
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "CAN.h"
+#include "PID.h"
+#include "protocol.h"
+#include "PWM.h"
+#include "timer.h"
+#include "USART.h"
+
+/* Bytes of the log. A controller frame takes 11 bytes, so the log holds 186 of them, which is 0.93 s of play with
+ * Node 1 sending every 5 ms. Later frames are not recorded and are counted as dropped, and the replay only covers the start of the game.
+ */
+#define RECORDER_BUFFER_LENGTH 2048
+
+/* Log format, little endian:
+ *  header - 'C', 'A', 'N', 'L', version, record count (2 bytes), record bytes (2 bytes)
+ *  record - milliseconds since the previous record (2 bytes, 0 for the first),
+ *           id in bits 0-10 and length in bits 12-15 (2 bytes), followed by the data bytes
+ *  Only standard ids are recorded.
+ */
+#define RECORDER_MAGIC "CANL"
+#define RECORDER_VERSION 1
+#define RECORDER_HEADER_LENGTH 9
+#define RECORDER_RECORD_HEADER_LENGTH 4
+#define RECORDER_LENGTH_SHIFT 12
+
+// Simulated motor of the replay. Each millisecond the position moves control/16 in 1/256 units, so full control crosses the 0-255 range in about 1 s
+#define RECORDER_PLANT_SHIFT 4
+
+/** Struct recorder_statistics representing the state of the recorder.
+ */
+typedef struct {
+    bool recording;
+
+    uint16_t records;
+    uint16_t bytes;
+
+    // Frames not recorded because the log was full or they had an extended id
+    uint16_t dropped;
+
+    // Recorded time in milliseconds
+    uint32_t duration_ms;
+} recorder_statistics;
+
+/** Struct recorder_replay_state representing the game state rebuilt by a replay, and the processing time of it.
+ */
+typedef struct {
+    protocol_receiver receiver;
+    controller_frame controller;
+    PID pid;
+    double duty_cycle;
+
+    // Simulated motor position with 8 fractional bits, and the last PID control
+    int32_t position;
+    int16_t control;
+
+    uint16_t frames;
+    uint32_t pid_steps;
+
+    // Processing time in timer ticks, 0 on the PC
+    uint32_t frame_ticks;
+    uint16_t frame_max_ticks;
+    uint32_t pid_ticks;
+} recorder_replay_state;
+
+/** Function for clearing the log and starting to record. The game state is kept, the replay starts from it.
+ *  @param const protocol_receiver* live - Receiver of the controller frames in the game. Must stay valid while recording.
+ *  @param const controller_frame* controller - Latest controller state in the game. Must stay valid while recording.
+ */
+void recorder_start(const protocol_receiver* live, const controller_frame* controller);
+
+/** Function for adding a received frame to the log. Does nothing unless recording.
+ *  Must be called before the frame is given to the receiver, so that the game state of the first frame that does not fit is not in the recorded window.
+ *  @param const message* msg - The received frame.
+ */
+void recorder_record(const message* msg);
+
+/** Function for stopping the recording. The game state is kept to compare with the replay, unless the log was full before.
+ */
+void recorder_stop(void);
+
+/** Function for returning the recorder state.
+ *  @return recorder_statistics - Recording or not, records and bytes in the log, dropped frames and recorded time.
+ */
+recorder_statistics recorder_read_statistics(void);
+
+/** Function for writing the log over USART in the binary log format. Blocks until it is sent.
+ */
+void recorder_dump(void);
+
+/** Function for setting up a replay from the game state at the start of a recording.
+ *  @param recorder_replay_state* state - The replay.
+ *  @param const protocol_receiver* receiver - Receiver of the controller frames when the recording started.
+ *  @param const controller_frame* controller - Controller state when the recording started.
+ */
+void recorder_replay_init(recorder_replay_state* state, const protocol_receiver* receiver, const controller_frame* controller);
+
+/** Function for replaying records through the controller frame decoding, the PID with a simulated motor, and the servo calculation, as fast as possible.
+ *  The PID runs once for every millisecond between the records, towards the reference of the previous frame.
+ *  Does not use the hardware, so it also runs on the PC against a dumped log.
+ *  @param recorder_replay_state* state - The replay, set up by recorder_replay_init.
+ *  @param const uint8_t* log - The records, without the log header.
+ *  @param uint16_t bytes - Bytes of the records. A record cut short at the end is not replayed.
+ */
+void recorder_replay_log(recorder_replay_state* state, const uint8_t* log, uint16_t bytes);
+
+/** Function for replaying the log from the game state at the start of the recording, see recorder_replay_log.
+ *  Prints the processing time per frame and per PID step, and the differences between the replayed and the recorded game state.
+ *  Only the recorded window is compared, from the start of the recording to the last frame in the log.
+ *  A resynchronization of the game receiver in the window is not in the log, and shows as lost frames.
+ *  @return uint8_t - Number of differences.
+ */
+uint8_t recorder_replay(void);
+
+#endif
@@ -0,0 +1,84 @@
+/** @file scheduler.c
+ *  @brief C-file for the fixed-rate task executive running the control loop. Each task is released by a clock, the system tick or the PWM period, and run to completion in priority order. The run time of each task is measured.
+ *  @authors: Anastasia Lindbäck and Marie Skatvedt
+ */
+
+#include "scheduler.h"
+
+/** Function for running the tasks that are released, once each. Tasks are checked in table order, so earlier tasks have higher priority.
+ *  @param task* tasks - Table of tasks.
+ *  @param uint8_t num_tasks - Number of tasks in the table.
+ */
+void scheduler_run_due(task* tasks, uint8_t num_tasks) {
+    for (uint8_t i = 0; i < num_tasks; i++) {
+        task* t = &tasks[i];
+        uint16_t now = t->clock();
+        uint16_t elapsed = now - t->last_release;
+
+        if (elapsed < t->period) {
+            continue;
+        }
+
+        // A whole release was missed, the task is released from now instead of catching up
+        if (elapsed >= 2 * t->period) {
+            t->late++;
+            t->last_release = now;
+        } else {
+            t->last_release += t->period;
+        }
+
+        uint16_t start = timer_ticks();
+        t->run();
+        uint16_t ticks = timer_ticks() - start;
+
+        t->runs++;
+        t->total_ticks += ticks;
+        if (ticks > t->max_ticks) {
+            t->max_ticks = ticks;
+        }
+
+        // Let a higher priority task that was released meanwhile run first
+        return;
+    }
+}
+
+/** Function for running the tasks forever. Does not return.
+ *  @param task* tasks - Table of tasks.
+ *  @param uint8_t num_tasks - Number of tasks in the table.
+ */
+void scheduler_run(task* tasks, uint8_t num_tasks) {
+    for (uint8_t i = 0; i < num_tasks; i++) {
+        tasks[i].last_release = tasks[i].clock();
+    }
+
+    while (1) {
+        scheduler_run_due(tasks, num_tasks);
+    }
+}
+
+/** Function for clearing the statistics of all tasks.
+ *  @param task* tasks - Table of tasks.
+ *  @param uint8_t num_tasks - Number of tasks in the table.
+ */
+void scheduler_reset_statistics(task* tasks, uint8_t num_tasks) {
+    for (uint8_t i = 0; i < num_tasks; i++) {
+        tasks[i].runs = 0;
+        tasks[i].late = 0;
+        tasks[i].max_ticks = 0;
+        tasks[i].total_ticks = 0;
+    }
+}
+
+/** Function for printing the runs, missed releases and run times of all tasks over USART.
+ *  @param task* tasks - Table of tasks.
+ *  @param uint8_t num_tasks - Number of tasks in the table.
+ */
+void scheduler_print_statistics(task* tasks, uint8_t num_tasks) {
+    for (uint8_t i = 0; i < num_tasks; i++) {
+        task* t = &tasks[i];
+        uint32_t average = t->runs ? (t->total_ticks / t->runs) : 0;
+
+        printf("%s: period %u, runs %u, late %u\n\r", t->name, t->period, t->runs, t->late);
+        printf("    Run time: average %lu us, max %lu us\n\r", TIMER_TICKS_TO_US(average), TIMER_TICKS_TO_US(t->max_ticks));
+    }
+}
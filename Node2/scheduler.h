@@ -0,0 +1,59 @@
+/** @file scheduler.h
+ *  @brief Header-file for the fixed-rate task executive running the control loop. Each task is released by a clock, the system tick or the PWM period, and run to completion in priority order. The run time of each task is measured.
+ *  @authors: Anastasia Lindbäck and Marie Skatvedt
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "timer.h"
+
+/** Struct task representing one periodic task and its timing statistics.
+ */
+typedef struct {
+    const char* name;
+    void (*run)(void);
+
+    // Clock releasing the task, e.g. timer_ms, and the number of clock counts between releases
+    uint16_t (*clock)(void);
+    uint16_t period;
+    uint16_t last_release;
+
+    // Statistics, times in TIMER3 ticks
+    uint16_t runs;
+    uint16_t late;
+    uint16_t max_ticks;
+    uint32_t total_ticks;
+} task;
+
+// Initializer for a task in a task table
+#define TASK(name, run, clock, period) {name, run, clock, period, 0, 0, 0, 0, 0}
+
+/** Function for running the tasks that are released, once each. Tasks are checked in table order, so earlier tasks have higher priority.
+ *  @param task* tasks - Table of tasks.
+ *  @param uint8_t num_tasks - Number of tasks in the table.
+ */
+void scheduler_run_due(task* tasks, uint8_t num_tasks);
+
+/** Function for running the tasks forever. Does not return.
+ *  @param task* tasks - Table of tasks.
+ *  @param uint8_t num_tasks - Number of tasks in the table.
+ */
+void scheduler_run(task* tasks, uint8_t num_tasks);
+
+/** Function for clearing the statistics of all tasks.
+ *  @param task* tasks - Table of tasks.
+ *  @param uint8_t num_tasks - Number of tasks in the table.
+ */
+void scheduler_reset_statistics(task* tasks, uint8_t num_tasks);
+
+/** Function for printing the runs, missed releases and run times of all tasks over USART.
+ *  @param task* tasks - Table of tasks.
+ *  @param uint8_t num_tasks - Number of tasks in the table.
+ */
+void scheduler_print_statistics(task* tasks, uint8_t num_tasks);
+
+#endif
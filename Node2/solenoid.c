@@ -5,6 +5,10 @@
 
 #include "solenoid.h"
 
+// Set while a punch is in progress, and when it started
+static bool solenoid_active = false;
+static uint16_t solenoid_start = 0;
+
 /** Function for initializing the solenoid by enabling pins.
  */
 void solenoid_init() {
@@ -12,18 +16,30 @@ void solenoid_init() {
     set_bit(PORTB, PB4);
 }
 
-/** Function for executing a solenoid punch if button is pressed.
+/** Function for starting a solenoid punch if button is pressed. Does not block, the punch is ended by solenoid_update.
+ *  @param controller_frame controller - Controller state from Node 1, including the touch button.
+ */
+void solenoid_control(controller_frame controller) {
+    if (controller.button && !solenoid_active) {
+        clear_bit(PORTB, PB4);
+        solenoid_active = true;
+        solenoid_start = timer_ms();
+    }
+}
+
+/** Function for ending the punch when it has lasted SOLENOID_PULSE_MS. Called periodically.
  */
-void solenoid_control(message msg) {
-    if (msg.data[2] == 1) {
-        solenoid_punch();
+void solenoid_update(void) {
+    if (solenoid_active && (timer_elapsed_ms(solenoid_start) >= SOLENOID_PULSE_MS)) {
+        set_bit(PORTB, PB4);
+        solenoid_active = false;
     }
 }
 
-/** Function for toggling the solenoid pins and executing a pulse-movement.
+/** Function for toggling the solenoid pins and executing a pulse-movement. Blocks for the length of the pulse.
  */
 void solenoid_punch(void){
     clear_bit(PORTB, PB4);
-    _delay_ms(300);
+    _delay_ms(SOLENOID_PULSE_MS);
     set_bit(PORTB, PB4);
 }
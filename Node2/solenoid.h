@@ -8,19 +8,28 @@
 
 #include "CAN.h"
 #include "bit_operations.h"
+#include "timer.h"
 
 #include <avr/io.h>
 #include <stdbool.h>
 
+// Length of a punch
+#define SOLENOID_PULSE_MS 300
+
 /** Function for initializing the solenoid by enabling pins.
  */
 void solenoid_init();
 
-/** Function for executing a solenoid punch if button is pressed.
+/** Function for starting a solenoid punch if button is pressed. Does not block, the punch is ended by solenoid_update.
+ *  @param controller_frame controller - Controller state from Node 1, including the touch button.
+ */
+void solenoid_control(controller_frame controller);
+
+/** Function for ending the punch when it has lasted SOLENOID_PULSE_MS. Called periodically.
  */
-void solenoid_control(message msg);
+void solenoid_update(void);
 
-/** Function for toggling the solenoid pins and executing a pulse-movement.
+/** Function for toggling the solenoid pins and executing a pulse-movement. Blocks for the length of the pulse.
  */
 void solenoid_punch(void);
 
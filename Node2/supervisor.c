@@ -0,0 +1,113 @@
+/** @file supervisor.c
+ *  @brief C-file for the controller link supervisor. Tracks the age of the last valid controller frame from Node 1, and ramps the motor and servo commands to a safe state when it passes the deadline.
+ *  @authors: Anastasia Lindbäck and Marie Skatvedt
+ */
+
+#include "supervisor.h"
+
+static supervisor_state supervisor_link = SUPERVISOR_SAFE;
+static supervisor_statistics supervisor_stats;
+
+// When the last valid frame arrived, and when the deadline passed
+static uint16_t supervisor_last_frame = 0;
+static uint16_t supervisor_timeout_time = 0;
+
+/** Function for starting the supervisor in the safe state, waiting for the first frame.
+ *  @param uint16_t deadline_ms - Age of the last frame when the link is taken as lost.
+ */
+void supervisor_init(uint16_t deadline_ms) {
+    supervisor_link = SUPERVISOR_SAFE;
+
+    supervisor_stats.deadline_ms = deadline_ms;
+    supervisor_stats.timeouts = 0;
+    supervisor_stats.max_age_ms = 0;
+}
+
+/** Function for changing the deadline.
+ *  @param uint16_t deadline_ms - Age of the last frame when the link is taken as lost.
+ */
+void supervisor_set_deadline(uint16_t deadline_ms) {
+    supervisor_stats.deadline_ms = deadline_ms;
+}
+
+/** Function for telling the supervisor that a valid controller frame was received.
+ */
+void supervisor_frame_received(void) {
+    if (supervisor_link == SUPERVISOR_LINK_OK) {
+        uint16_t age = timer_elapsed_ms(supervisor_last_frame);
+
+        if (age > supervisor_stats.max_age_ms) {
+            supervisor_stats.max_age_ms = age;
+        }
+    }
+
+    supervisor_last_frame = timer_ms();
+    supervisor_link = SUPERVISOR_LINK_OK;
+}
+
+/** Function for checking the age of the last frame against the deadline, counting timeouts. Called periodically.
+ *  @return supervisor_state - State of the link.
+ */
+supervisor_state supervisor_update(void) {
+    switch (supervisor_link) {
+        case SUPERVISOR_LINK_OK:
+            if (timer_elapsed_ms(supervisor_last_frame) >= supervisor_stats.deadline_ms) {
+                supervisor_link = SUPERVISOR_RAMPING;
+                supervisor_timeout_time = timer_ms();
+                supervisor_stats.timeouts++;
+            }
+            break;
+
+        case SUPERVISOR_RAMPING:
+            if (timer_elapsed_ms(supervisor_timeout_time) >= SUPERVISOR_RAMP_MS) {
+                supervisor_link = SUPERVISOR_SAFE;
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    return supervisor_link;
+}
+
+/** Function for moving a command from its last value towards its safe value, as far as the ramp has come.
+ *  @param int16_t from - Command when the link was lost.
+ *  @param int16_t to - Safe command.
+ *  @return int16_t - from while the link is up, to when the ramp is finished, and in between while ramping.
+ */
+int16_t supervisor_ramp(int16_t from, int16_t to) {
+    switch (supervisor_link) {
+        case SUPERVISOR_LINK_OK:
+            return from;
+
+        case SUPERVISOR_RAMPING: {
+            uint16_t elapsed = timer_elapsed_ms(supervisor_timeout_time);
+            if (elapsed > SUPERVISOR_RAMP_MS) {
+                elapsed = SUPERVISOR_RAMP_MS;
+            }
+            return from + ((int32_t)(to - from) * elapsed) / SUPERVISOR_RAMP_MS;
+        }
+
+        default:
+            return to;
+    }
+}
+
+/** Function for returning the supervisor counters.
+ *  @return supervisor_statistics - Deadline, timeouts and oldest frame age.
+ */
+supervisor_statistics supervisor_read_statistics(void) {
+    return supervisor_stats;
+}
+
+/** Test function for printing the supervisor counters.
+ */
+void test_supervisor_statistics(void) {
+    const char* states[] = {"OK", "RAMPING", "SAFE"};
+
+    printf("Link: %s\n\r", states[supervisor_link]);
+    printf("Deadline: %u ms\n\r", supervisor_stats.deadline_ms);
+    printf("Timeouts: %u\n\r", supervisor_stats.timeouts);
+    printf("Oldest frame: %u ms\n\r", supervisor_stats.max_age_ms);
+}
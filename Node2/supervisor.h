@@ -0,0 +1,79 @@
+/** @file supervisor.h
+ *  @brief Header-file for the controller link supervisor. Tracks the age of the last valid controller frame from Node 1, and ramps the motor and servo commands to a safe state when it passes the deadline.
+ *  @authors: Anastasia Lindbäck and Marie Skatvedt
+ */
+
+#ifndef SUPERVISOR_H
+#define SUPERVISOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "timer.h"
+
+// Default age of the last controller frame when the link is taken as lost. Node 1 sends at least every keep-alive interval (100 ms)
+#define SUPERVISOR_DEADLINE_MS 250
+
+// Time the commands take to ramp from the last controller state to the safe state
+#define SUPERVISOR_RAMP_MS 500
+
+/** Enum supervisor_state representing the state of the controller link.
+ */
+typedef enum {
+    // Frames arrive within the deadline
+    SUPERVISOR_LINK_OK,
+
+    // Deadline passed, the commands are ramped to the safe state
+    SUPERVISOR_RAMPING,
+
+    // Ramp finished, or no frame received since start
+    SUPERVISOR_SAFE
+} supervisor_state;
+
+/** Struct supervisor_statistics representing the link supervisor counters.
+ */
+typedef struct {
+    uint16_t deadline_ms;
+
+    // Times the deadline has passed, and the oldest frame age seen while the link was up
+    uint16_t timeouts;
+    uint16_t max_age_ms;
+} supervisor_statistics;
+
+/** Function for starting the supervisor in the safe state, waiting for the first frame.
+ *  @param uint16_t deadline_ms - Age of the last frame when the link is taken as lost.
+ */
+void supervisor_init(uint16_t deadline_ms);
+
+/** Function for changing the deadline.
+ *  @param uint16_t deadline_ms - Age of the last frame when the link is taken as lost.
+ */
+void supervisor_set_deadline(uint16_t deadline_ms);
+
+/** Function for telling the supervisor that a valid controller frame was received.
+ */
+void supervisor_frame_received(void);
+
+/** Function for checking the age of the last frame against the deadline, counting timeouts. Called periodically.
+ *  @return supervisor_state - State of the link.
+ */
+supervisor_state supervisor_update(void);
+
+/** Function for moving a command from its last value towards its safe value, as far as the ramp has come.
+ *  @param int16_t from - Command when the link was lost.
+ *  @param int16_t to - Safe command.
+ *  @return int16_t - from while the link is up, to when the ramp is finished, and in between while ramping.
+ */
+int16_t supervisor_ramp(int16_t from, int16_t to);
+
+/** Function for returning the supervisor counters.
+ *  @return supervisor_statistics - Deadline, timeouts and oldest frame age.
+ */
+supervisor_statistics supervisor_read_statistics(void);
+
+/** Test function for printing the supervisor counters.
+ */
+void test_supervisor_statistics(void);
+
+#endif
@@ -0,0 +1,147 @@
+/** @file telemetry.c
+ *  @brief C-file for the control loop telemetry. Sends typed binary records over USART at a configurable rate, framed with COBS and checked with a CRC-8, without blocking the control loop.
+ *  The stream is decoded to CSV on the PC with tools/telemetry_decode.py.
+ *  @authors: Anastasia Lindbäck and Marie Skatvedt
+ */
+
+#include "telemetry.h"
+
+static telemetry_statistics telemetry_stats;
+
+// Sequence number of the next record, and when the last record was sent
+static uint16_t telemetry_sequence = 0;
+static uint16_t telemetry_last_time = 0;
+
+/** Function for writing a 16 bit value to a record, least significant byte first.
+ *  @param uint8_t* bytes - Where to write.
+ *  @param uint16_t value - The value.
+ */
+static void telemetry_write_16(uint8_t* bytes, uint16_t value) {
+    bytes[0] = value & 0xFF;
+    bytes[1] = value >> 8;
+}
+
+/** Function for COBS encoding a record, so that it has no zero bytes. Each zero is replaced by the distance to the next one, and the first distance is put in front.
+ *  Records are shorter than 254 bytes, so no distance is longer than a byte can hold.
+ *  @param const uint8_t* data - The record.
+ *  @param uint8_t length - Bytes in the record.
+ *  @param uint8_t* encoded - Filled with the encoded record, length + 1 bytes.
+ *  @return uint8_t - Bytes in the encoded record.
+ */
+static uint8_t telemetry_cobs_encode(const uint8_t* data, uint8_t length, uint8_t* encoded) {
+    uint8_t code_index = 0;
+    uint8_t code = 1;
+    uint8_t out = 1;
+
+    for (uint8_t i = 0; i < length; i++) {
+        if (data[i] == 0) {
+            encoded[code_index] = code;
+            code_index = out++;
+            code = 1;
+        }
+        else {
+            encoded[out++] = data[i];
+            code++;
+        }
+    }
+    encoded[code_index] = code;
+
+    return out;
+}
+
+/** Function for completing a record with its header and CRC, and sending it framed if the transmit ring has room for the whole frame.
+ *  @param uint8_t type - Record type.
+ *  @param uint8_t* record - The record, with the payload filled in after the header and room for the CRC.
+ *  @param uint8_t payload_length - Bytes in the payload.
+ */
+static void telemetry_send(uint8_t type, uint8_t* record, uint8_t payload_length) {
+    uint8_t length = TELEMETRY_HEADER_LENGTH + payload_length;
+
+    record[0] = type;
+    telemetry_write_16(&record[1], telemetry_sequence);
+    telemetry_write_16(&record[3], timer_ms());
+    record[length] = protocol_crc8(record, length);
+    length++;
+
+    telemetry_sequence++;
+
+    uint8_t frame[TELEMETRY_MAX_FRAME_LENGTH];
+    frame[0] = 0x00;
+    uint8_t frame_length = 1 + telemetry_cobs_encode(record, length, &frame[1]);
+    frame[frame_length++] = 0x00;
+
+    // A frame cut short would only be thrown away by the decoder, so it is dropped whole
+    if (USART_tx_space() < frame_length) {
+        telemetry_stats.dropped++;
+        return;
+    }
+
+    for (uint8_t i = 0; i < frame_length; i++) {
+        USART_trans(frame[i]);
+    }
+    telemetry_stats.sent++;
+}
+
+/** Function for starting the telemetry. Sets USART to TELEMETRY_BAUD unless the telemetry is off.
+ *  @param uint16_t period_ms - Time between records in milliseconds, 0 for no telemetry.
+ */
+void telemetry_init(uint16_t period_ms) {
+    telemetry_stats.sent = 0;
+    telemetry_stats.dropped = 0;
+    telemetry_sequence = 0;
+
+    telemetry_set_period(period_ms);
+
+    if (period_ms > 0) {
+        if (USART_init(TELEMETRY_BAUD)) {
+            printf("No baud rate close to %lu\n\r", (uint32_t)TELEMETRY_BAUD);
+        }
+    }
+}
+
+/** Function for changing the time between records.
+ *  @param uint16_t period_ms - Time between records in milliseconds, 0 for no telemetry.
+ */
+void telemetry_set_period(uint16_t period_ms) {
+    telemetry_stats.period_ms = period_ms;
+    telemetry_last_time = timer_ms();
+}
+
+/** Function for sending a record of the last PID step, if a period has passed since the last record. Never waits for USART.
+ *  @param const PID* pid - PID controller, after the step.
+ *  @param uint16_t duty_cycle - Servo duty cycle in 1/100 %.
+ *  @param uint8_t misses - Misses counted in the game.
+ */
+void telemetry_pid(const PID* pid, uint16_t duty_cycle, uint8_t misses) {
+    if ((telemetry_stats.period_ms == 0) || (timer_elapsed_ms(telemetry_last_time) < telemetry_stats.period_ms)) {
+        return;
+    }
+    telemetry_last_time = timer_ms();
+
+    uint8_t record[TELEMETRY_MAX_RECORD_LENGTH];
+    uint8_t* payload = &record[TELEMETRY_HEADER_LENGTH];
+
+    payload[0] = pid->reference;
+    payload[1] = pid->process;
+    telemetry_write_16(&payload[2], pid->error);
+    telemetry_write_16(&payload[4], pid->control);
+    telemetry_write_16(&payload[6], duty_cycle);
+    payload[8] = misses;
+
+    telemetry_send(TELEMETRY_RECORD_PID, record, TELEMETRY_PID_PAYLOAD_LENGTH);
+}
+
+/** Function for returning the telemetry rate and counters.
+ *  @return telemetry_statistics - Period, records sent and records dropped.
+ */
+telemetry_statistics telemetry_read_statistics(void) {
+    return telemetry_stats;
+}
+
+/** Test function for printing the telemetry rate and counters.
+ */
+void test_telemetry_statistics(void) {
+    printf("Telemetry period: %u ms\n\r", telemetry_stats.period_ms);
+    printf("Records sent: %u\n\r", telemetry_stats.sent);
+    printf("Records dropped: %u\n\r", telemetry_stats.dropped);
+}
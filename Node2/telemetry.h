@@ -0,0 +1,75 @@
+/** @file telemetry.h
+ *  @brief Header-file for the control loop telemetry. Sends typed binary records over USART at a configurable rate, framed with COBS and checked with a CRC-8, without blocking the control loop.
+ *  The stream is decoded to CSV on the PC with tools/telemetry_decode.py.
+ *  @authors: Anastasia Lindbäck and Marie Skatvedt
+ */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "PID.h"
+#include "protocol.h"
+#include "timer.h"
+#include "USART.h"
+
+// Baud rate of USART while telemetry is sent. Text from printf shares the line, and is skipped by the decoder
+#define TELEMETRY_BAUD 500000
+
+/* Frame format:
+ *  frame  - 0x00, COBS encoded record, 0x00
+ *  record - type, sequence (2 bytes), time in ms (2 bytes), payload, CRC-8 of the bytes before it (protocol_crc8)
+ *  Values are little endian. The sequence counts every record, also those that are dropped, so the decoder finds the gaps.
+ */
+#define TELEMETRY_HEADER_LENGTH 5
+
+// PID record payload - reference, position, error (2 bytes), control (2 bytes), servo duty cycle in 1/100 % (2 bytes), misses
+#define TELEMETRY_RECORD_PID 1
+#define TELEMETRY_PID_PAYLOAD_LENGTH 9
+
+#define TELEMETRY_MAX_RECORD_LENGTH (TELEMETRY_HEADER_LENGTH + TELEMETRY_PID_PAYLOAD_LENGTH + 1)
+
+// COBS adds one byte to records shorter than 254 bytes, and the frame has two delimiters
+#define TELEMETRY_MAX_FRAME_LENGTH (TELEMETRY_MAX_RECORD_LENGTH + 3)
+
+/** Struct telemetry_statistics representing the rate and counters of the telemetry.
+ */
+typedef struct {
+    // Time between records in milliseconds, 0 when off
+    uint16_t period_ms;
+
+    // Records sent, and records dropped because the transmit ring had no room for them
+    uint16_t sent;
+    uint16_t dropped;
+} telemetry_statistics;
+
+/** Function for starting the telemetry. Sets USART to TELEMETRY_BAUD unless the telemetry is off.
+ *  @param uint16_t period_ms - Time between records in milliseconds, 0 for no telemetry.
+ */
+void telemetry_init(uint16_t period_ms);
+
+/** Function for changing the time between records.
+ *  @param uint16_t period_ms - Time between records in milliseconds, 0 for no telemetry.
+ */
+void telemetry_set_period(uint16_t period_ms);
+
+/** Function for sending a record of the last PID step, if a period has passed since the last record. Never waits for USART.
+ *  @param const PID* pid - PID controller, after the step.
+ *  @param uint16_t duty_cycle - Servo duty cycle in 1/100 %.
+ *  @param uint8_t misses - Misses counted in the game.
+ */
+void telemetry_pid(const PID* pid, uint16_t duty_cycle, uint8_t misses);
+
+/** Function for returning the telemetry rate and counters.
+ *  @return telemetry_statistics - Period, records sent and records dropped.
+ */
+telemetry_statistics telemetry_read_statistics(void);
+
+/** Test function for printing the telemetry rate and counters.
+ */
+void test_telemetry_statistics(void);
+
+#endif
@@ -0,0 +1,69 @@
+/** @file timer.c
+ *  @brief C-file for the system tick. TIMER3 in CTC mode gives a millisecond time base for the task executive, timeouts and intervals.
+ *  @authors: Anastasia Lindbäck and Marie Skatvedt
+ */
+
+#include "timer.h"
+
+// Milliseconds since timer_init
+static volatile uint16_t timer_milliseconds = 0;
+
+/** Function for initializing the system tick on TIMER3.
+ */
+void timer_init(void) {
+    timer_milliseconds = 0;
+
+    // CTC mode with OCR3A as top, prescaler 8
+    set_bit(TCCR3B, WGM32);
+    set_bit(TCCR3B, CS31);
+
+    OCR3A = TIMER_PERIOD_TICKS - 1;
+
+    // Enable compare match interrupt
+    set_bit(TIMSK3, OCIE3A);
+}
+
+/** Function for returning the time since timer_init in milliseconds. Wraps around after 65.5 s.
+ *  @return uint16_t ms - Milliseconds since start.
+ */
+uint16_t timer_ms(void) {
+    // The 16 bit counter is read with interrupts disabled, so that the ISR can not change it between the two bytes
+    uint8_t sreg = SREG;
+    cli();
+    uint16_t ms = timer_milliseconds;
+    SREG = sreg;
+
+    return ms;
+}
+
+/** Function for returning the time in TIMER3 ticks of 0.5 us, for measuring short durations. Wraps around after 32 ms.
+ *  @return uint16_t ticks - TIMER3 ticks since start.
+ */
+uint16_t timer_ticks(void) {
+    uint8_t sreg = SREG;
+    cli();
+    uint16_t ms = timer_milliseconds;
+    uint16_t count = TCNT3;
+
+    // A compare match that is not yet handled has restarted the counter without counting the millisecond
+    if (test_bit(TIFR3, OCF3A) && (count < TIMER_PERIOD_TICKS / 2)) {
+        ms++;
+    }
+    SREG = sreg;
+
+    return ms * TIMER_PERIOD_TICKS + count;
+}
+
+/** Function for returning the milliseconds elapsed since a time returned by timer_ms. Correct across wrap around.
+ *  @param uint16_t since - Earlier time from timer_ms.
+ *  @return uint16_t - Milliseconds elapsed.
+ */
+uint16_t timer_elapsed_ms(uint16_t since) {
+    return timer_ms() - since;
+}
+
+/** Interrupt service routine executed every millisecond, counting the system time.
+ */
+ISR(TIMER3_COMPA_vect) {
+    timer_milliseconds++;
+}
@@ -0,0 +1,41 @@
+/** @file timer.h
+ *  @brief Header-file for the system tick. TIMER3 in CTC mode gives a millisecond time base for the task executive, timeouts and intervals.
+ *  @authors: Anastasia Lindbäck and Marie Skatvedt
+ */
+
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdint.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "bit_operations.h"
+
+// TIMER3 prescaler 8 gives 16000000/8 = 2 MHz, 2000 ticks = 1 ms
+#define TIMER_PERIOD_TICKS 2000
+
+// Converts TIMER3 ticks to microseconds
+#define TIMER_TICKS_TO_US(ticks) ((uint32_t)(ticks) / 2)
+
+/** Function for initializing the system tick on TIMER3.
+ */
+void timer_init(void);
+
+/** Function for returning the time since timer_init in milliseconds. Wraps around after 65.5 s.
+ *  @return uint16_t ms - Milliseconds since start.
+ */
+uint16_t timer_ms(void);
+
+/** Function for returning the time in TIMER3 ticks of 0.5 us, for measuring short durations. Wraps around after 32 ms.
+ *  @return uint16_t ticks - TIMER3 ticks since start.
+ */
+uint16_t timer_ticks(void);
+
+/** Function for returning the milliseconds elapsed since a time returned by timer_ms. Correct across wrap around.
+ *  @param uint16_t since - Earlier time from timer_ms.
+ *  @return uint16_t - Milliseconds elapsed.
+ */
+uint16_t timer_elapsed_ms(uint16_t since);
+
+#endif
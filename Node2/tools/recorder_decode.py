@@ -0,0 +1,112 @@
+#!/usr/bin/env python3
+"""Parser for the CAN traffic log dumped by the recorder of Node 2.
+
+Reads a USART capture, from a file, a serial port or standard input, finds the
+'CANL' header of the log in it and writes one CSV line per record, see
+recorder.h for the format. Text from printf before and after the log is
+skipped. Controller frames are unpacked and their CRC-8 (polynomial 0x07)
+checked, see protocol.h.
+
+    python3 recorder_decode.py capture.bin -o game.csv
+"""
+
+import argparse
+import csv
+import struct
+import sys
+
+MAGIC = b"CANL"
+VERSION = 1
+HEADER = struct.Struct("<4sBHH")
+RECORD_HEADER = struct.Struct("<HH")
+LENGTH_SHIFT = 12
+STANDARD_ID_MAX = 0x7FF
+
+CAN_ID_CONTROLLER = 0
+CONTROLLER_LENGTH = 7
+PROTOCOL_VERSION = 1
+
+FIELDS = ["time_ms", "delta_ms", "id", "length", "data",
+          "sequence", "x", "y", "slider_left", "slider_right", "button", "play_game", "difficulty", "crc_ok"]
+
+
+def crc8(data):
+    crc = 0
+    for byte in data:
+        crc ^= byte
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x07) & 0xFF if crc & 0x80 else (crc << 1) & 0xFF
+    return crc
+
+
+def find_log(capture):
+    """Returns the record count and the record bytes of the first log in the capture with a known version."""
+    start = capture.find(MAGIC)
+    while start >= 0:
+        if start + HEADER.size <= len(capture):
+            _, version, records, length = HEADER.unpack_from(capture, start)
+            if version == VERSION:
+                body = capture[start + HEADER.size:start + HEADER.size + length]
+                if len(body) < length:
+                    print("Log cut short, %d of %d bytes" % (len(body), length), file=sys.stderr)
+                return records, body
+        start = capture.find(MAGIC, start + 1)
+    return None
+
+
+def controller_fields(data):
+    """Returns the unpacked controller frame, as in protocol_decode_controller, with a CRC check."""
+    if len(data) != CONTROLLER_LENGTH:
+        return [""] * 9
+    flags, sequence, x, y, slider_left, slider_right, crc = struct.unpack("<BBbbBBB", data)
+    crc_ok = crc8(data[:-1]) == crc and (flags >> 4) == PROTOCOL_VERSION
+    return [sequence, x, y, slider_left, slider_right, flags & 1, (flags >> 1) & 1, (flags >> 2) & 0x03, int(crc_ok)]
+
+
+def records(body):
+    """Yields delta, id and data of each record."""
+    offset = 0
+    while offset + RECORD_HEADER.size <= len(body):
+        delta, id_length = RECORD_HEADER.unpack_from(body, offset)
+        length = id_length >> LENGTH_SHIFT
+        offset += RECORD_HEADER.size
+        if offset + length > len(body):
+            print("Last record cut short", file=sys.stderr)
+            return
+        yield delta, id_length & STANDARD_ID_MAX, body[offset:offset + length]
+        offset += length
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Parse the Node 2 recorder log to CSV.")
+    parser.add_argument("input", nargs="?", default="-", help="capture file or serial port, - for standard input")
+    parser.add_argument("-o", "--output", help="CSV file, standard output if not given")
+    args = parser.parse_args()
+
+    source = sys.stdin.buffer if args.input == "-" else open(args.input, "rb")
+    capture = source.read()
+
+    log = find_log(capture)
+    if log is None:
+        sys.exit("No '%s' log of version %d found" % (MAGIC.decode(), VERSION))
+    expected, body = log
+
+    output = open(args.output, "w", newline="") if args.output else sys.stdout
+    writer = csv.writer(output)
+    writer.writerow(FIELDS)
+
+    time_ms = 0
+    count = 0
+    for delta, can_id, data in records(body):
+        time_ms += delta
+        row = [time_ms, delta, can_id, len(data), data.hex()]
+        row += controller_fields(data) if can_id == CAN_ID_CONTROLLER else [""] * 9
+        writer.writerow(row)
+        count += 1
+
+    output.flush()
+    print("%d of %d records, %d ms" % (count, expected, time_ms), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
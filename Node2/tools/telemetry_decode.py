@@ -0,0 +1,123 @@
+#!/usr/bin/env python3
+"""Decoder for the control loop telemetry of Node 2.
+
+Reads the USART stream, from a file, a serial port set to TELEMETRY_BAUD or
+standard input, and writes one CSV line per record. Frames are COBS encoded
+between zero bytes and end with a CRC-8 (polynomial 0x07), see telemetry.h.
+Text from printf between the frames is skipped. Gaps in the sequence numbers
+are reported as dropped records.
+
+    python3 telemetry_decode.py /dev/ttyS0 > pid.csv
+    python3 telemetry_decode.py capture.bin -o pid.csv
+"""
+
+import argparse
+import csv
+import struct
+import sys
+
+RECORD_PID = 1
+HEADER = struct.Struct("<BHH")
+PID_PAYLOAD = struct.Struct("<BBhhHB")
+
+PID_FIELDS = ["sequence", "time_ms", "reference", "position", "error", "control", "duty_cycle_percent", "misses"]
+
+
+def crc8(data):
+    crc = 0
+    for byte in data:
+        crc ^= byte
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x07) & 0xFF if crc & 0x80 else (crc << 1) & 0xFF
+    return crc
+
+
+def cobs_decode(data):
+    """Returns the decoded bytes, or None if the frame is not valid COBS."""
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data):
+            return None
+        out += data[i + 1:i + code]
+        i += code
+        if code < 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def frames(stream):
+    """Yields the bytes between zero delimiters."""
+    frame = bytearray()
+    while True:
+        chunk = stream.read(4096)
+        if not chunk:
+            break
+        for byte in chunk:
+            if byte == 0:
+                if frame:
+                    yield bytes(frame)
+                    frame.clear()
+            else:
+                frame.append(byte)
+
+
+class Decoder:
+    def __init__(self, writer):
+        self.writer = writer
+        self.records = 0
+        self.dropped = 0
+        self.bad_frames = 0
+        self.unknown = 0
+        self.sequence = None
+
+    def frame(self, frame):
+        record = cobs_decode(frame)
+        if record is None or len(record) < HEADER.size + 1 or crc8(record[:-1]) != record[-1]:
+            # Text from printf, or a damaged record
+            self.bad_frames += 1
+            return
+
+        record_type, sequence, time_ms = HEADER.unpack_from(record)
+
+        # Node 2 starts again from 0 when it is reset
+        if self.sequence is not None and sequence != 0:
+            self.dropped += (sequence - self.sequence - 1) & 0xFFFF
+        self.sequence = sequence
+
+        payload = record[HEADER.size:-1]
+        if record_type != RECORD_PID or len(payload) != PID_PAYLOAD.size:
+            self.unknown += 1
+            return
+
+        reference, position, error, control, duty_cycle, misses = PID_PAYLOAD.unpack(payload)
+        self.writer.writerow([sequence, time_ms, reference, position, error, control, "%.2f" % (duty_cycle / 100), misses])
+        self.records += 1
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode the Node 2 telemetry stream to CSV.")
+    parser.add_argument("input", nargs="?", default="-", help="capture file or serial port, - for standard input")
+    parser.add_argument("-o", "--output", help="CSV file, standard output if not given")
+    args = parser.parse_args()
+
+    source = sys.stdin.buffer if args.input == "-" else open(args.input, "rb", buffering=0)
+    output = open(args.output, "w", newline="") if args.output else sys.stdout
+
+    writer = csv.writer(output)
+    writer.writerow(PID_FIELDS)
+    decoder = Decoder(writer)
+
+    try:
+        for frame in frames(source):
+            decoder.frame(frame)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        output.flush()
+        print("%d records, %d dropped, %d unknown, %d frames skipped" % (decoder.records, decoder.dropped, decoder.unknown, decoder.bad_frames), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,14 @@
+/** @file interrupt.h
+ *  @brief Stand-in for avr/interrupt.h in the host tests. Interrupt service routines become plain functions, and the tests call them directly.
+ *  @authors: Anastasia Lindbäck and Marie Skatvedt
+ */
+
+#ifndef STUB_AVR_INTERRUPT_H
+#define STUB_AVR_INTERRUPT_H
+
+#define ISR(vector) void vector(void)
+
+#define cli()
+#define sei()
+
+#endif
@@ -0,0 +1,45 @@
+/** @file io.h
+ *  @brief Stand-in for avr/io.h in the host tests. The registers used by the modules under test are plain variables, defined in avr_stub.c.
+ *  @authors: Anastasia Lindbäck and Marie Skatvedt
+ */
+
+#ifndef STUB_AVR_IO_H
+#define STUB_AVR_IO_H
+
+#include <stdint.h>
+
+extern volatile uint8_t SREG;
+
+// TIMER0, driving the ADC scan
+extern volatile uint8_t TCCR0;
+extern volatile uint8_t TCNT0;
+extern volatile uint8_t OCR0;
+extern volatile uint8_t TIMSK;
+extern volatile uint8_t TIFR;
+
+#define WGM01 3
+#define CS01 1
+#define CS00 0
+#define OCIE0 1
+#define OCF0 1
+
+// TIMER1, driving the servo PWM of Node 2
+extern volatile uint8_t TCCR1A;
+extern volatile uint8_t TCCR1B;
+extern volatile uint16_t ICR1;
+extern volatile uint16_t OCR1A;
+extern volatile uint8_t TIMSK1;
+extern volatile uint8_t DDRB;
+
+#define WGM11 1
+#define WGM12 3
+#define WGM13 4
+#define COM1A1 7
+#define CS11 1
+#define TOIE1 0
+#define PB5 5
+
+// Simulated external ADC. Writing selects the channel to convert, reading gives the result. Used as adc_addr
+extern volatile char adc_sim_register[1];
+
+#endif
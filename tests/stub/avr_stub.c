@@ -0,0 +1,23 @@
+/** @file avr_stub.c
+ *  @brief Registers declared by the stand-in AVR headers of the host tests.
+ *  @authors: Anastasia Lindbäck and Marie Skatvedt
+ */
+
+#include <avr/io.h>
+
+volatile uint8_t SREG;
+
+volatile uint8_t TCCR0;
+volatile uint8_t TCNT0;
+volatile uint8_t OCR0;
+volatile uint8_t TIMSK;
+volatile uint8_t TIFR;
+
+volatile uint8_t TCCR1A;
+volatile uint8_t TCCR1B;
+volatile uint16_t ICR1;
+volatile uint16_t OCR1A;
+volatile uint8_t TIMSK1;
+volatile uint8_t DDRB;
+
+volatile char adc_sim_register[1];
@@ -0,0 +1,55 @@
+/** @file node2_stub.c
+ *  @brief Stand-ins for the Node 2 hardware modules the recorder, PID and PWM are linked against in the host tests.
+ *  The timer only moves when a test advances stub_time_ms, and its ticks stay 0, so the processing times of a replay are 0.
+ *  @authors: Anastasia Lindbäck and Marie Skatvedt
+ */
+
+#include <stdio.h>
+
+#include "node2_stub.h"
+#include "CAN.h"
+#include "motor.h"
+#include "timer.h"
+#include "USART.h"
+
+uint16_t stub_time_ms = 0;
+
+uint16_t timer_ms(void) {
+    return stub_time_ms;
+}
+
+uint16_t timer_ticks(void) {
+    return 0;
+}
+
+uint16_t timer_elapsed_ms(uint16_t since) {
+    return stub_time_ms - since;
+}
+
+uint8_t USART_init(uint32_t baud) {
+    (void)baud;
+    return 0;
+}
+
+void USART_trans(unsigned char letter) {
+    putchar(letter);
+}
+
+int CAN_init(void) {
+    return 0;
+}
+
+message* CAN_rx_peek(void) {
+    return NULL;
+}
+
+void CAN_rx_release(void) {
+}
+
+void motor_move(int16_t speed) {
+    (void)speed;
+}
+
+uint8_t motor_position(void) {
+    return 0;
+}
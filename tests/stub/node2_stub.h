@@ -0,0 +1,14 @@
+/** @file node2_stub.h
+ *  @brief Stand-ins for the Node 2 hardware modules the recorder, PID and PWM are linked against in the host tests.
+ *  @authors: Anastasia Lindbäck and Marie Skatvedt
+ */
+
+#ifndef NODE2_STUB_H
+#define NODE2_STUB_H
+
+#include <stdint.h>
+
+// Returned by timer_ms, advanced by the tests
+extern uint16_t stub_time_ms;
+
+#endif
@@ -0,0 +1,12 @@
+/** @file delay.h
+ *  @brief Stand-in for util/delay.h in the host tests. The delays return at once.
+ *  @authors: Anastasia Lindbäck and Marie Skatvedt
+ */
+
+#ifndef STUB_UTIL_DELAY_H
+#define STUB_UTIL_DELAY_H
+
+#define _delay_ms(ms) ((void)(ms))
+#define _delay_us(us) ((void)(us))
+
+#endif
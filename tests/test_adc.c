@@ -0,0 +1,115 @@
+/** @file test_adc.c
+ *  @brief Host test of the background ADC scan in Node1/ADC.c, run against a simulated external ADC.
+ *  Checks that every channel ends up in the snapshot and that the scans are counted, and measures the scan rate given by the TIMER0 settings and the CPU time of a scan on the PC for each filter setting.
+ *  @authors: Anastasia Lindbäck and Marie Skatvedt
+ */
+
+// clock_gettime
+#define _POSIX_C_SOURCE 199309L
+
+#include <time.h>
+
+#include "ADC.h"
+
+// Scans run for each measurement
+#define TEST_SCANS 20000
+
+// Noise added to the simulated samples, drawn before the measurements so that rand is not timed
+#define TEST_NOISE_LENGTH 256
+static uint8_t noise[TEST_NOISE_LENGTH];
+
+/** Function for returning a simulated sample of a channel, a slow ramp with noise that differs between the channels.
+ *  @param uint8_t channel - ADC channel (4-7).
+ *  @param uint32_t n - Number of the step.
+ *  @return uint8_t - The sample.
+ */
+static uint8_t simulated_sample(uint8_t channel, uint32_t n) {
+    return (uint8_t)(channel * 40 + ((n / 64) % 32) + noise[n % TEST_NOISE_LENGTH]);
+}
+
+/** Function for running steps of the scan against the simulated ADC. The channel written by the last step is the one converted now.
+ *  @param uint32_t steps - Number of steps.
+ *  @param bool constant - Give each channel a constant sample, channel * 40, instead of the noisy ramp.
+ */
+static void run_steps(uint32_t steps, bool constant) {
+    for (uint32_t n = 0; n < steps; n++) {
+        uint8_t channel = adc_sim_register[0];
+        adc_sim_register[0] = constant ? (char)(channel * 40) : (char)simulated_sample(channel, n);
+
+        ADC_scan_step();
+    }
+}
+
+/** Function for checking that constant samples reach the snapshot of the right channel, and that each complete scan is counted once.
+ *  @return uint16_t - Number of failed checks.
+ */
+static uint16_t test_scan(void) {
+    uint16_t failures = 0;
+
+    ADC_init();
+    uint16_t start = ADC_read_snapshot().scan;
+
+    run_steps(100 * ADC_NUM_CHANNELS, true);
+
+    ADC_snapshot snapshot = ADC_read_snapshot();
+
+    if ((uint16_t)(snapshot.scan - start) != 100) {
+        printf("%u scans counted, expected 100\n", (uint16_t)(snapshot.scan - start));
+        failures++;
+    }
+
+    for (uint8_t i = 0; i < ADC_NUM_CHANNELS; i++) {
+        uint8_t expected = (ADC_FIRST_CHANNEL + i) * 40;
+
+        if (snapshot.channel[i] != expected) {
+            printf("Channel %u is %u, expected %u\n", ADC_FIRST_CHANNEL + i, snapshot.channel[i], expected);
+            failures++;
+        }
+    }
+
+    return failures;
+}
+
+/** Function for printing the scan rate of the target, and the CPU time per scan on the PC for a filter setting.
+ *  @param filter_settings settings - Filter of every channel.
+ */
+static void measure(filter_settings settings) {
+    ADC_init();
+    for (uint8_t channel = ADC_FIRST_CHANNEL; channel < ADC_FIRST_CHANNEL + ADC_NUM_CHANNELS; channel++) {
+        ADC_set_filter(channel, settings);
+    }
+
+    struct timespec start;
+    struct timespec end;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &start);
+
+    run_steps((uint32_t)TEST_SCANS * ADC_NUM_CHANNELS, false);
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &end);
+
+    double ns = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+
+    printf("Oversampling: %u, IIR: %u, Median: %u - %.0f ns per scan on the PC\n",
+        settings.oversampling_shift, settings.iir_shift, settings.median, ns / TEST_SCANS);
+}
+
+int main(void) {
+    for (uint16_t i = 0; i < TEST_NOISE_LENGTH; i++) {
+        noise[i] = rand() % 5;
+    }
+
+    uint16_t failures = test_scan();
+
+    // One channel is converted every ADC_CHANNEL_PERIOD_TICKS of TIMER0
+    double scan_rate = (double)F_CPU / ADC_TIMER_PRESCALER / ADC_CHANNEL_PERIOD_TICKS / ADC_NUM_CHANNELS;
+    printf("Target: %.1f scans per second, %.0f samples per second\n", scan_rate, scan_rate * ADC_NUM_CHANNELS);
+
+    measure((filter_settings){0, 0, false});
+    measure(ADC_DEFAULT_FILTER);
+    measure((filter_settings){2, 2, true});
+    measure((filter_settings){3, 3, true});
+
+    printf("%u failures\n", failures);
+
+    return (failures == 0) ? 0 : 1;
+}
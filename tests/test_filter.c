@@ -0,0 +1,48 @@
+/** @file test_filter.c
+ *  @brief Host test of the ADC input filters in Node1/filter.c. Prints the group delay and noise reduction of test_filter_settings, and checks that a constant input passes through every setting unchanged, also at the ends of the range.
+ *  @authors: Anastasia Lindbäck and Marie Skatvedt
+ */
+
+#include "filter.h"
+
+// Samples fed before the output is checked, enough for the slowest IIR to settle
+#define TEST_SETTLE 4096
+
+/** Function for checking that the filter output settles at a constant input for every setting.
+ *  @return uint16_t - Number of failed checks.
+ */
+static uint16_t test_constant_input(void) {
+    const uint8_t inputs[] = {0, 1, 128, 254, 255};
+    uint16_t failures = 0;
+    filter f;
+
+    for (uint8_t oversampling = 0; oversampling <= FILTER_MAX_OVERSAMPLING_SHIFT; oversampling++) {
+        for (uint8_t iir = 0; iir <= FILTER_MAX_IIR_SHIFT; iir++) {
+            for (uint8_t i = 0; i < sizeof(inputs); i++) {
+                filter_settings settings = {oversampling, iir, (iir & 1) != 0};
+                filter_init(&f, settings);
+
+                for (uint16_t n = 0; n < TEST_SETTLE; n++) {
+                    filter_sample(&f, inputs[i]);
+                }
+
+                if (filter_output(&f) != inputs[i]) {
+                    printf("Oversampling %u, IIR %u: %u in, %u out\n", oversampling, iir, inputs[i], filter_output(&f));
+                    failures++;
+                }
+            }
+        }
+    }
+
+    return failures;
+}
+
+int main(void) {
+    test_filter_settings();
+
+    uint16_t failures = test_constant_input();
+
+    printf("%u failures\n", failures);
+
+    return (failures == 0) ? 0 : 1;
+}
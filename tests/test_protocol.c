@@ -0,0 +1,116 @@
+/** @file test_protocol.c
+ *  @brief Host test of the controller frame format in protocol.c. Runs the on-target test, and checks the CRC against its reference value and the sequence handling around the wrap.
+ *  @authors: Anastasia Lindbäck and Marie Skatvedt
+ */
+
+#include <string.h>
+
+#include "protocol.h"
+
+/** Function for encoding a controller frame with a given sequence number, and handing it to a receiver.
+ *  @param protocol_receiver* receiver - The receiver.
+ *  @param uint8_t sequence - Sequence number of the frame.
+ *  @return protocol_status - Result of protocol_receive_controller.
+ */
+static protocol_status receive_sequence(protocol_receiver* receiver, uint8_t sequence) {
+    controller_frame sent = {0};
+    controller_frame received;
+    uint8_t data[PROTOCOL_CONTROLLER_LENGTH];
+
+    sent.sequence = sequence;
+    protocol_encode_controller(&sent, data);
+
+    return protocol_receive_controller(receiver, data, PROTOCOL_CONTROLLER_LENGTH, &received);
+}
+
+/** Function for checking the CRC-8 against the reference value of the polynomial, which the PC decoders in Node2/tools also use.
+ *  @return uint16_t - Number of failed checks.
+ */
+static uint16_t test_crc(void) {
+    const char* check = "123456789";
+
+    if (protocol_crc8((const uint8_t*)check, strlen(check)) != 0xF4) {
+        printf("CRC-8 of \"%s\" is not 0xF4\n", check);
+        return 1;
+    }
+    return 0;
+}
+
+/** Function for checking that the sequence wraps from 255 to 0 without lost frames, and that frames half the window behind are old.
+ *  @return uint16_t - Number of failed checks.
+ */
+static uint16_t test_sequence_wrap(void) {
+    uint16_t failures = 0;
+    protocol_receiver receiver;
+    protocol_receiver_init(&receiver);
+
+    for (uint16_t i = 0; i < 600; i++) {
+        if (receive_sequence(&receiver, (uint8_t)(200 + i)) != PROTOCOL_OK) {
+            printf("Sequence %u not accepted\n", (uint8_t)(200 + i));
+            failures++;
+        }
+    }
+
+    if ((receiver.received != 600) || (receiver.lost != 0) || (receiver.stale != 0)) {
+        printf("Counters wrong after the wrap\n");
+        failures++;
+    }
+
+    // The last sequence was 31. 31 - PROTOCOL_SEQUENCE_WINDOW is the oldest frame still taken as old
+    if (receive_sequence(&receiver, (uint8_t)(31 - PROTOCOL_SEQUENCE_WINDOW)) != PROTOCOL_ERROR_STALE) {
+        printf("Frame a window behind not old\n");
+        failures++;
+    }
+
+    return failures;
+}
+
+/** Function for checking that a restarted sender is only followed after PROTOCOL_RESYNC_STALE old frames in a row, and that a valid frame in between starts the count again.
+ *  @return uint16_t - Number of failed checks.
+ */
+static uint16_t test_stale_resync(void) {
+    uint16_t failures = 0;
+    protocol_receiver receiver;
+    protocol_receiver_init(&receiver);
+
+    receive_sequence(&receiver, 100);
+
+    // Two old frames, then the stream goes on
+    receive_sequence(&receiver, 10);
+    receive_sequence(&receiver, 11);
+    if (receive_sequence(&receiver, 101) != PROTOCOL_OK) {
+        printf("Frame after old frames not accepted\n");
+        failures++;
+    }
+
+    // The run of old frames starts again from 0
+    for (uint8_t i = 0; i < PROTOCOL_RESYNC_STALE; i++) {
+        protocol_status status = receive_sequence(&receiver, 20 + i);
+        protocol_status expected = (i + 1 < PROTOCOL_RESYNC_STALE) ? PROTOCOL_ERROR_STALE : PROTOCOL_OK;
+
+        if (status != expected) {
+            printf("Old frame %u of the run not handled\n", i + 1);
+            failures++;
+        }
+    }
+
+    if (receiver.resyncs != 1) {
+        printf("Resyncs %u, expected 1\n", receiver.resyncs);
+        failures++;
+    }
+
+    return failures;
+}
+
+int main(void) {
+    uint16_t failures = 0;
+
+    failures += test_protocol_controller_frame();
+    failures += test_crc();
+    failures += test_sequence_wrap();
+    failures += test_stale_resync();
+
+    printf("%u failures\n", failures);
+
+    return (failures == 0) ? 0 : 1;
+}
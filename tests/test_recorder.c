@@ -0,0 +1,239 @@
+/** @file test_recorder.c
+ *  @brief Host test of the recorder and the replay of Node 2, and replay of a log dumped by Node 2 on the PC.
+ *  Without arguments the tests are run. With a capture file of the USART, the log in it is replayed:
+ *      ./build/test_recorder capture.bin
+ *  @authors: Anastasia Lindbäck and Marie Skatvedt
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "node2_stub.h"
+#include "recorder.h"
+
+// Node 1 sends a controller frame every 5 ms
+#define FRAME_PERIOD_MS 5
+
+// Frames of the simulated game, about 1.6 times what the log holds
+#define GAME_FRAMES 300
+
+/** Function for making the controller frame Node 1 would send as frame i of the simulated game.
+ *  @param uint16_t i - Frame number.
+ *  @param message* msg - The frame.
+ */
+static void game_frame(uint16_t i, message* msg) {
+    controller_frame frame = {0};
+    frame.sequence = (uint8_t)(50 + i);
+    frame.x = (int8_t)((i % 200) - 100);
+    frame.slider_left = (uint8_t)(i * 3);
+    frame.play_game = true;
+    frame.difficulty = (i / 100) % 3;
+
+    msg->id = CAN_ID_CONTROLLER;
+    msg->extended = false;
+    msg->length = protocol_encode_controller(&frame, msg->data);
+}
+
+/** Function for checking that the replay of a recorded game matches the game over the recorded window, also when the game goes on
+ *  with lost, old and corrupted frames after the log is full, and when the game receiver was synchronized before the recording.
+ *  @return uint16_t - Number of failed checks.
+ */
+static uint16_t test_recorded_window(void) {
+    uint16_t failures = 0;
+
+    protocol_receiver live;
+    protocol_receiver_init(&live);
+    controller_frame controller = {0};
+
+    for (uint16_t i = 0; i < GAME_FRAMES; i++) {
+        message msg;
+        game_frame(i, &msg);
+
+        // Lost frames before and inside the window, old and corrupted frames in both
+        if ((i == 5) || (i == 40) || (i == 250)) {
+            continue;
+        }
+        if ((i == 60) || (i == 260)) {
+            msg.data[0] ^= 0x01;
+        }
+        if ((i == 80) || (i == 270)) {
+            game_frame(i - 3, &msg);
+        }
+
+        stub_time_ms += FRAME_PERIOD_MS;
+
+        // As in controller_received
+        recorder_record(&msg);
+        protocol_receive_controller(&live, msg.data, msg.length, &controller);
+
+        if (i == 20) {
+            recorder_start(&live, &controller);
+        }
+    }
+
+    recorder_stop();
+
+    recorder_statistics stats = recorder_read_statistics();
+    if (stats.dropped == 0) {
+        printf("The simulated game did not fill the log\n");
+        failures++;
+    }
+
+    if (recorder_replay() != 0) {
+        printf("Replay differs from the recorded window\n");
+        failures++;
+    }
+
+    return failures;
+}
+
+/** Function for checking the replay of a hand written log: a frame of another id, a controller frame, and one second more of the PID
+ *  with the simulated motor moving from the middle towards the slider.
+ *  @return uint16_t - Number of failed checks.
+ */
+static uint16_t test_replay_log(void) {
+    uint16_t failures = 0;
+
+    controller_frame frame = {0};
+    frame.sequence = 7;
+    frame.slider_left = 200;
+    frame.x = 100;
+
+    uint8_t log[64];
+    uint16_t bytes = 0;
+
+    // Another id is skipped: delta 0, id 0x123, 1 byte
+    const uint8_t other[] = {0x00, 0x00, 0x23, 0x11, 0xAA};
+    memcpy(&log[bytes], other, sizeof(other));
+    bytes += sizeof(other);
+
+    // Controller frame 10 ms later
+    log[bytes++] = 10;
+    log[bytes++] = 0;
+    log[bytes++] = CAN_ID_CONTROLLER;
+    log[bytes++] = PROTOCOL_CONTROLLER_LENGTH << (RECORDER_LENGTH_SHIFT - 8);
+    bytes += protocol_encode_controller(&frame, &log[bytes]);
+
+    // Only time passes, 1 s later
+    const uint8_t later[] = {0xE8, 0x03, 0x23, 0x01};
+    memcpy(&log[bytes], later, sizeof(later));
+    bytes += sizeof(later);
+
+    protocol_receiver receiver;
+    protocol_receiver_init(&receiver);
+    controller_frame start = {0};
+
+    recorder_replay_state replay;
+    recorder_replay_init(&replay, &receiver, &start);
+
+    // The last byte is cut off, so the record is not replayed
+    recorder_replay_log(&replay, log, bytes - 1);
+    if (replay.pid_steps != 10) {
+        printf("Cut record replayed, %u PID steps\n", (unsigned)replay.pid_steps);
+        failures++;
+    }
+
+    recorder_replay_init(&replay, &receiver, &start);
+    recorder_replay_log(&replay, log, bytes);
+
+    if ((replay.frames != 1) || (replay.receiver.received != 1) || (replay.pid_steps != 1010)) {
+        printf("Replayed %u frames, %u received, %u PID steps\n", replay.frames, replay.receiver.received, (unsigned)replay.pid_steps);
+        failures++;
+    }
+
+    if ((replay.controller.sequence != 7) || (replay.controller.slider_left != 200) || (replay.controller.x != 100)) {
+        printf("Controller state not replayed\n");
+        failures++;
+    }
+
+    // Full right is a 2 ms pulse
+    if ((replay.duty_cycle < 2.0 / PWM_T - 0.0001) || (replay.duty_cycle > 2.0 / PWM_T + 0.0001)) {
+        printf("Servo duty cycle %f\n", replay.duty_cycle);
+        failures++;
+    }
+
+    int32_t position = replay.position >> 8;
+    if ((position <= 128) || (position > 200)) {
+        printf("Simulated motor at %d, slider at 200\n", (int)position);
+        failures++;
+    }
+
+    return failures;
+}
+
+/** Function for replaying the first log in a capture of the USART of Node 2, from a receiver that is not synchronized.
+ *  @param const char* path - The capture file.
+ *  @return int - 0 if a log was found and replayed.
+ */
+static int replay_capture(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        perror(path);
+        return 1;
+    }
+
+    static uint8_t capture[1 << 20];
+    size_t length = fread(capture, 1, sizeof(capture), file);
+    fclose(file);
+
+    // Text from printf may come before the log, the header is found by its magic and version
+    size_t start = 0;
+    while ((start + RECORDER_HEADER_LENGTH <= length) &&
+        ((memcmp(&capture[start], RECORDER_MAGIC, 4) != 0) || (capture[start + 4] != RECORDER_VERSION))) {
+        start++;
+    }
+    if (start + RECORDER_HEADER_LENGTH > length) {
+        printf("No log of version %u found\n", RECORDER_VERSION);
+        return 1;
+    }
+
+    uint16_t records = capture[start + 5] | (capture[start + 6] << 8);
+    size_t bytes = capture[start + 7] | (capture[start + 8] << 8);
+    start += RECORDER_HEADER_LENGTH;
+
+    if (start + bytes > length) {
+        printf("Log cut short, %u of %u bytes\n", (unsigned)(length - start), (unsigned)bytes);
+        bytes = length - start;
+    }
+
+    protocol_receiver receiver;
+    protocol_receiver_init(&receiver);
+    controller_frame controller = {0};
+
+    recorder_replay_state replay;
+    recorder_replay_init(&replay, &receiver, &controller);
+
+    struct timespec begin, end;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &begin);
+    recorder_replay_log(&replay, &capture[start], bytes);
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &end);
+
+    long ns = (end.tv_sec - begin.tv_sec) * 1000000000L + (end.tv_nsec - begin.tv_nsec);
+
+    printf("Replayed %u controller frames of %u records, %u PID steps, in %ld us\n", replay.frames, records, (unsigned)replay.pid_steps, ns / 1000);
+    printf("Received %u, lost %u, old %u, CRC errors %u\n", replay.receiver.received, replay.receiver.lost, replay.receiver.stale, replay.receiver.crc_errors);
+    printf("Final controller: sequence %u, joystick (%d, %d), slider %u, difficulty %u, play game %u\n", replay.controller.sequence,
+        replay.controller.x, replay.controller.y, replay.controller.slider_left, replay.controller.difficulty, replay.controller.play_game);
+    printf("Final PID control %d, simulated position %ld, servo duty cycle %.4f\n", replay.control, (long)(replay.position >> 8), replay.duty_cycle);
+
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1) {
+        return replay_capture(argv[1]);
+    }
+
+    uint16_t failures = 0;
+
+    failures += test_recorded_window();
+    failures += test_replay_log();
+
+    printf("%u failures\n", failures);
+
+    return (failures == 0) ? 0 : 1;
+}